@@ -72,11 +72,36 @@ static void set_channel_intensity(const lor_unit unit,
   // send the encoded data in `b` to the device...
 }
 
+/// @brief Ramps every channel of two 16 channel units toward full brightness,
+///        sending only the channels which changed since the previous step.
+static void ramp_frame(void) {
+  lor_intensity storage[2 * 2 * 16];// previous and current state
+  lor_frame_s frame;
+  lor_frame_init(&frame, storage, 1, 2, 16);// units 1-2, 16 channels each
+
+  for (int step = 0; step <= 0xFF; step += 0x33) {
+    for (lor_channel c = 0; c < 16; c++) {
+      lor_frame_set(&frame, 1, c, step);
+      lor_frame_set(&frame, 2, c, c < 8 ? step : 0);// half of unit 2 is off
+    }
+
+    lor_req_s reqs[2 * 16];// worst case of one request per channel
+    size_t n = lor_frame_diff(&frame, reqs, 2 * 16);
+
+    unsigned char b[2 * 16 * 8] = {0};// write buffer for encoded data
+    size_t written = lor_write(b, sizeof(b), reqs, n);
+    assert(written <= sizeof(b));// basic check for encoding success
+
+    // send the encoded data in `b` to the device...
+  }
+}
+
 int main(void) {
   fade_to_black(1, 1);              // fade unit 1, channel 1 to black
   twinkle_alternating_channels(2);  // twinkle unit 2 on alternating channels
   turn_off_unit(3);                 // turn off all channels on unit 3
   set_channel_intensity(1, 4, 0x80);// set unit 1, channel 4 to 50% brightness
+  ramp_frame();                     // ramp units 1-2 using a frame diff
 
   return 0;
 }
@@ -122,7 +122,7 @@ static int lor_encode_effect(unsigned char* const b, const lor_effect e,
     case LOR_FADE:
       b[w++] = d->fade.start_intensity;
       b[w++] = d->fade.end_intensity;
-      w += lor_encode_decis(b, d->fade.deciseconds);
+      w += lor_encode_decis(&b[w], d->fade.deciseconds);
       break;
     case LOR_PULSE:
       b[w++] = d->pulse.deciseconds;
@@ -136,28 +136,1892 @@ static int lor_encode_effect(unsigned char* const b, const lor_effect e,
   return w;
 }
 
+/// @brief Returns the number of bytes used by the arguments of an effect.
+/// @param e The effect to measure.
+/// @return The encoded size of the effect arguments in bytes.
+static int lor_effect_size(const lor_effect e) {
+  switch (e) {
+    case LOR_SET_INTENSITY:
+    case LOR_PULSE:
+    case LOR_SET_DMX_INTENSITY:
+      return 1;
+    case LOR_FADE:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+size_t lor_req_size(const lor_req_s* const req) {
+  // header (0, unit, effect|format), offset byte, and trailing 0
+  return 5 + lor_effect_size(req->effect) + !!(req->cset.cbits & 0xFF) +
+         !!(req->cset.cbits >> 8);
+}
+
+size_t lor_write_size(const lor_req_s* r, const size_t rs) {
+  size_t n = 0;
+  for (size_t i = 0; i < rs; i++) n += lor_req_size(&r[i]);
+  return n;
+}
+
+#ifdef TINYLOR_STATS
+/// @brief The statistics collected since the last lor_stats_reset.
+static lor_stats_s lor_stats;
+/// @brief The optional hook called for each encoded request.
+static lor_stats_fn lor_stats_hook_fn;
+/// @brief The context passed to \p lor_stats_hook_fn.
+static void* lor_stats_hook_ctx;
+
+void lor_stats_get(lor_stats_s* s) { *s = lor_stats; }
+
+void lor_stats_reset(void) { lor_stats = (lor_stats_s){0}; }
+
+void lor_stats_hook(const lor_stats_fn fn, void* ctx) {
+  lor_stats_hook_fn = fn;
+  lor_stats_hook_ctx = ctx;
+}
+
+/// @brief Records an encoded request and calls the hook, if any.
+/// @param req The encoded request.
+/// @param fmt The channel set format used to encode the request.
+/// @param w The encoded size of the request.
+static void lor_stats_encode(const lor_req_s* const req,
+                             const lor_channel_format fmt, const int w) {
+  lor_stats.requests++;
+  lor_stats.bytes += w;
+  if (req->effect < sizeof(lor_stats.effects) / sizeof(lor_stats.effects[0]))
+    lor_stats.effects[req->effect]++;
+  lor_stats.formats[fmt >> 4]++;
+  if (lor_stats_hook_fn != NULL)
+    lor_stats_hook_fn(req, (size_t) w, lor_stats_hook_ctx);
+}
+
+#ifdef TINYLOR_STATS_CLOCK
+#define LOR_STATS_START()                                                      \
+  const unsigned long long stats_start = TINYLOR_STATS_CLOCK()
+#define LOR_STATS_BATCH()                                                      \
+  lor_stats.batch_ns += TINYLOR_STATS_CLOCK() - stats_start
+#else
+#define LOR_STATS_START() (void) 0
+#define LOR_STATS_BATCH() (void) 0
+#endif
+#define LOR_STATS_ENCODE(req, fmt, w) lor_stats_encode(req, fmt, w)
+#define LOR_STATS_OVERFLOW(n) (lor_stats.overflows += (n), lor_stats.batches++)
+#define LOR_STATS_WRITE() lor_stats.batches++
+#else
+#define LOR_STATS_START() (void) 0
+#define LOR_STATS_BATCH() (void) 0
+#define LOR_STATS_ENCODE(req, fmt, w) (void) 0
+#define LOR_STATS_OVERFLOW(n) (void) 0
+#define LOR_STATS_WRITE() (void) 0
+#endif// TINYLOR_STATS
+
+/// @brief Encodes a request into a buffer.
+/// @param b The buffer to write the request to.
+/// @param req The request to encode.
+/// @return The number of bytes written to the buffer.
+/// @note Caller is responsible for ensuring buffer is at least
+///       lor_req_size(req) bytes in size.
+static int lor_encode_req(unsigned char* const b, const lor_req_s* const req) {
+  int w = 0;
+  const lor_channel_format fmt = lor_get_cset_format(&req->cset);
+  b[w++] = 0;
+  b[w++] = req->unit;
+  b[w++] = req->effect | fmt;
+  w += lor_encode_effect(&b[w], req->effect, &req->args);
+  w += lor_encode_cset(&b[w], &req->cset);
+  b[w++] = 0;
+  LOR_STATS_ENCODE(req, fmt, w);
+  return w;
+}
+
 size_t lor_write(unsigned char* b, const size_t bs, const lor_req_s* r,
                  const size_t rs) {
+  LOR_STATS_START();
   size_t h = 0;
   for (size_t i = 0; i < rs; i++) {
-    size_t w = 0;
-    unsigned char t[16] = {0};
-    const lor_req_s* const req = &r[i];
-    t[w++] = 0;
-    t[w++] = req->unit;
-    t[w++] = req->effect | lor_get_cset_format(&req->cset);
-    w += lor_encode_effect(&t[w], req->effect, &req->args);
-    w += lor_encode_cset(&t[w], &req->cset);
-    t[w++] = 0;
-    if (w > bs) return w;
-    __builtin_memcpy(&b[h], t, w);
+    const size_t w = lor_req_size(&r[i]);
+    if (w > bs - h) {
+      LOR_STATS_BATCH();
+      LOR_STATS_OVERFLOW(rs - i);
+      return w;
+    }
+    h += lor_encode_req(&b[h], &r[i]);
+  }
+  LOR_STATS_BATCH();
+  LOR_STATS_WRITE();
+  return h;
+}
+
+void lor_encoder_init(lor_encoder_s* enc, const lor_req_s* r,
+                      const size_t rs) {
+  *enc = (lor_encoder_s){.r = r, .rs = rs};
+  enc->pending = lor_write_size(r, rs);
+}
+
+size_t lor_encoder_write(lor_encoder_s* enc, unsigned char* b,
+                         const size_t bs) {
+  size_t h = 0;
+  while (h < bs && enc->pending) {
+    if (!enc->partial_size) {
+      const lor_req_s* const req = &enc->r[enc->consumed];
+      if (lor_req_size(req) <= bs - h) {
+        const size_t w = lor_encode_req(&b[h], req);
+        h += w;
+        enc->produced += w;
+        enc->pending -= w;
+        enc->consumed++;
+        continue;
+      }
+      // split the request, writing the remainder on the following calls
+      enc->partial_size = lor_encode_req(enc->partial, req);
+      enc->partial_off = 0;
+    }
+    size_t w = enc->partial_size - enc->partial_off;
+    if (w > bs - h) w = bs - h;
+    __builtin_memcpy(&b[h], &enc->partial[enc->partial_off], w);
+    h += w;
+    enc->produced += w;
+    enc->pending -= w;
+    enc->partial_off += w;
+    if (enc->partial_off == enc->partial_size) {
+      enc->partial_size = 0;
+      enc->consumed++;
+    }
+  }
+  return h;
+}
+
+void lor_chunk_split(lor_chunk_s* c, const size_t cs, const size_t rs) {
+  size_t first = 0;
+  for (size_t i = 0; i < cs; i++) {
+    // spread the remainder over the first chunks
+    const size_t count = rs / cs + (i < rs % cs);
+    c[i] = (lor_chunk_s){.first = first, .count = count};
+    first += count;
+  }
+}
+
+void lor_chunk_measure(lor_chunk_s* c, const lor_req_s* r) {
+  c->size = lor_write_size(&r[c->first], c->count);
+}
+
+size_t lor_chunk_offsets(lor_chunk_s* c, const size_t cs) {
+  size_t h = 0;
+  for (size_t i = 0; i < cs; i++) {
+    c[i].offset = h;
+    h += c[i].size;
+  }
+  return h;
+}
+
+size_t lor_chunk_write(unsigned char* b, const lor_chunk_s* c,
+                       const lor_req_s* r) {
+  return lor_write(&b[c->offset], c->size, &r[c->first], c->count);
+}
+
+void lor_batch_init(lor_req_batch_s* batch, lor_unit* unit,
+                    unsigned char* effect, unsigned char* offset,
+                    unsigned short* cbits, unsigned char* args,
+                    const size_t cap) {
+  *batch = (lor_req_batch_s){unit, effect, offset, cbits, args, 0, cap};
+}
+
+int lor_batch_add(lor_req_batch_s* batch, const lor_req_s* req) {
+  if (batch->n >= batch->cap || (unsigned) req->effect > 0x0F) return -1;
+  const size_t i = batch->n++;
+  batch->unit[i] = req->unit;
+  batch->effect[i] = (unsigned char) req->effect;
+  batch->offset[i] = req->cset.offset;
+  batch->cbits[i] = req->cset.cbits;
+  unsigned char* const args = &batch->args[i * 4];
+  __builtin_memset(args, 0, 4);
+  lor_encode_effect(args, req->effect, &req->args);
+  return 0;
+}
+
+/// @brief The encoded argument size of each effect, indexed by lor_effect.
+static const unsigned char lor_effect_sizes[16] = {
+        [LOR_SET_INTENSITY] = 1,
+        [LOR_FADE] = 4,
+        [LOR_PULSE] = 1,
+        [LOR_SET_DMX_INTENSITY] = 1,
+};
+
+/// @brief The lor_channel_format of an unaligned channel set, indexed by
+///        (more than one bit set) << 2 | (high byte set) << 1 | (low byte set).
+static const unsigned char lor_cset_formats[8] = {
+        LOR_FMT_UNIT,   LOR_FMT_SINGLE, LOR_FMT_SINGLE, LOR_FMT_16,
+        LOR_FMT_UNIT,   LOR_FMT_8L,     LOR_FMT_8H,     LOR_FMT_16,
+};
+
+/// @brief The multi-part channel set options, indexed by
+///        (high byte set) << 1 | (low byte set).
+static const unsigned char lor_cset_opts[4] = {0x40, 0x80, 0x40, 0};
+
+/// @brief Returns the encoded size of request \p i of a batch.
+static size_t lor_batch_req_size(const lor_req_batch_s* const batch,
+                                 const size_t i) {
+  const unsigned short cbits = batch->cbits[i];
+  return 5 + lor_effect_sizes[batch->effect[i]] + ((cbits & 0xFF) != 0) +
+         ((cbits >> 8) != 0);
+}
+
+size_t lor_batch_size(const lor_req_batch_s* batch) {
+  size_t n = 0;
+  for (size_t i = 0; i < batch->n; i++) n += lor_batch_req_size(batch, i);
+  return n;
+}
+
+/// @brief Encodes request \p i of a batch into a buffer.
+/// @return The number of bytes written to the buffer.
+/// @note Caller is responsible for ensuring the buffer is at least
+///       LOR_REQ_MAX_SIZE bytes in size, trailing bytes may be overwritten.
+static size_t lor_batch_encode_req(unsigned char* const b,
+                                   const lor_req_batch_s* const batch,
+                                   const size_t i) {
+  const unsigned char off = batch->offset[i];
+  const unsigned short cbits = batch->cbits[i];
+  const unsigned char low = cbits & 0xFF;
+  const unsigned char high = cbits >> 8;
+  const int lh = (high != 0) << 1 | (low != 0);
+  const int many = (cbits & (cbits - 1)) != 0;
+  const unsigned char fmt =
+          off ? LOR_FMT_MULTIPART : lor_cset_formats[many << 2 | lh];
+  size_t w = 3 + lor_effect_sizes[batch->effect[i]];
+  b[0] = 0;
+  b[1] = batch->unit[i];
+  b[2] = batch->effect[i] | fmt;
+  __builtin_memcpy(&b[3], &batch->args[i * 4], 4);
+  b[w++] = off | (off ? lor_cset_opts[lh] : 0);
+  b[w] = low;
+  w += low != 0;
+  b[w] = high;
+  w += high != 0;
+  b[w++] = 0;
+  return w;
+}
+
+size_t lor_batch_write(unsigned char* b, const size_t bs,
+                       const lor_req_batch_s* batch) {
+  size_t h = 0, i = 0;
+  // encode directly into the buffer while a full-size request always fits
+  for (; i < batch->n && bs - h >= LOR_REQ_MAX_SIZE; i++)
+    h += lor_batch_encode_req(&b[h], batch, i);
+  for (; i < batch->n; i++) {
+    const size_t w = lor_batch_req_size(batch, i);
+    if (w > bs - h) return w;
+    unsigned char tmp[LOR_REQ_MAX_SIZE];
+    lor_batch_encode_req(tmp, batch, i);
+    __builtin_memcpy(&b[h], tmp, w);
+    h += w;
+  }
+  return h;
+}
+
+/// @brief Decodes a 2-byte decisecond value encoded by lor_encode_decis.
+/// @param b The buffer to read the decisecond value from.
+/// @return The decoded decisecond value.
+static lor_decisec lor_decode_decis(const unsigned char* const b) {
+  if (b[0] & 0x80) return b[1];
+  if (b[0] & 0x40) return (lor_decisec) ((b[0] & 0x3F) << 8);
+  return (lor_decisec) (b[0] << 8 | b[1]);
+}
+
+/// @brief Decodes a single request from a buffer.
+/// @param b The buffer to read the request from, starting with the 0 header.
+/// @param bs The size of the buffer.
+/// @param req The request to decode into.
+/// @return The number of bytes consumed, 0 if the buffer ends before the
+///         request does, or -1 if the bytes are not a valid request.
+static int lor_decode_req(const unsigned char* const b, const size_t bs,
+                          lor_req_s* const req) {
+  if (bs < 3) return 0;
+  const int e = b[2] & 0x0F;
+  const int fmt = b[2] & 0xF0;
+  if (e < LOR_SET_LIGHTS || e > LOR_SET_DMX_INTENSITY) return -1;
+  if (fmt > LOR_FMT_MULTIPART) return -1;
+  size_t w = 3 + lor_effect_size((lor_effect) e);
+  if (bs < w + 1) return 0;
+  const unsigned char* const d = &b[3];
+  lor_effect_args_u args = {0};
+  switch (e) {
+    case LOR_SET_INTENSITY:
+      args.set_intensity.intensity = d[0];
+      break;
+    case LOR_FADE:
+      args.fade.start_intensity = d[0];
+      args.fade.end_intensity = d[1];
+      args.fade.deciseconds = lor_decode_decis(&d[2]);
+      break;
+    case LOR_PULSE:
+      args.pulse.deciseconds = d[0];
+      break;
+    case LOR_SET_DMX_INTENSITY:
+      args.set_dmx_intensity.output = d[0];
+      break;
+    default:
+      break;
+  }
+  // determine which halves of the bitset follow the offset byte
+  const unsigned char off = b[w++];
+  int low = 0, high = 0;
+  switch (fmt) {
+    case LOR_FMT_SINGLE:
+    case LOR_FMT_8L:
+      low = 1;
+      break;
+    case LOR_FMT_16:
+      low = high = 1;
+      break;
+    case LOR_FMT_8H:
+      high = 1;
+      break;
+    case LOR_FMT_MULTIPART:
+      if ((off & 0xC0) == 0xC0) return -1;
+      low = !(off & 0x40);
+      high = !(off & 0x80);
+      break;
+    default:
+      break;
+  }
+  if (fmt != LOR_FMT_MULTIPART && off) return -1;
+  if (fmt == LOR_FMT_MULTIPART && high && !low) {
+    // an empty multipart set is written as an 8H offset byte alone, and a
+    // high byte is never zero, so a zero byte is the terminator
+    if (bs < w + 1) return 0;
+    if (!b[w]) high = 0;
+  }
+  if (bs < w + low + high + 1) return 0;
+  unsigned short cbits = 0;
+  if (low) cbits = b[w++];
+  if (high) cbits |= b[w++] << 8;
+  if (low && !(cbits & 0xFF)) return -1;
+  if (high && !(cbits >> 8)) return -1;
+  if (fmt == LOR_FMT_SINGLE && (cbits & (cbits - 1))) return -1;
+  if (b[w++]) return -1;
+  lor_set_unit(req, b[1]);
+  lor_set_effect(req, (lor_effect) e, &args);
+  req->cset = (lor_channel_set){(unsigned char) (off & 0x3F), cbits};
+  return (int) w;
+}
+
+size_t lor_read(const unsigned char* b, const size_t bs, lor_req_s* r,
+                const size_t rs, size_t* n) {
+  size_t h = 0, i = 0;
+  while (h < bs && i < rs) {
+    if (b[h]) {
+      h++;// resync to the next possible request header
+      continue;
+    }
+    const size_t len = bs - h;
+    const size_t hb = len < LOR_HEARTBEAT_SIZE ? len : LOR_HEARTBEAT_SIZE;
+    if (!__builtin_memcmp(&b[h], LOR_HEARTBEAT_BYTES, hb)) {
+      if (len < LOR_HEARTBEAT_SIZE) break;
+      h += LOR_HEARTBEAT_SIZE;
+      continue;
+    }
+    const int w = lor_decode_req(&b[h], len, &r[i]);
+    if (!w) break;
+    if (w < 0) {
+      h++;
+      continue;
+    }
     h += w;
+    i++;
   }
+  if (n != NULL) *n = i;
   return h;
 }
 
+/// @brief Compares the effect and any effect arguments used by two requests.
+/// @param a The first request to compare.
+/// @param b The second request to compare.
+/// @return Non-zero if the requests apply the same effect, otherwise zero.
+static int lor_effect_equal(const lor_req_s* const a,
+                            const lor_req_s* const b) {
+  if (a->effect != b->effect) return 0;
+  switch (a->effect) {
+    case LOR_SET_INTENSITY:
+      return a->args.set_intensity.intensity == b->args.set_intensity.intensity;
+    case LOR_FADE:
+      return a->args.fade.start_intensity == b->args.fade.start_intensity &&
+             a->args.fade.end_intensity == b->args.fade.end_intensity &&
+             a->args.fade.deciseconds == b->args.fade.deciseconds;
+    case LOR_PULSE:
+      return a->args.pulse.deciseconds == b->args.pulse.deciseconds;
+    case LOR_SET_DMX_INTENSITY:
+      return a->args.set_dmx_intensity.output ==
+             b->args.set_dmx_intensity.output;
+    default:
+      return 1;
+  }
+}
+
+/// @brief Determines whether two requests may apply to any of the same
+///        channels, including via broadcast units and unit-wide channel sets.
+/// @param a The first request to compare.
+/// @param b The second request to compare.
+/// @return Non-zero if the requests overlap, otherwise zero.
+static int lor_req_overlaps(const lor_req_s* const a,
+                            const lor_req_s* const b) {
+  if (a->unit != b->unit && a->unit != 0xFF && b->unit != 0xFF) return 0;
+  if (!a->cset.cbits || !b->cset.cbits) return 1;
+  return a->cset.offset == b->cset.offset && (a->cset.cbits & b->cset.cbits);
+}
+
+size_t lor_coalesce(lor_req_s* r, const size_t rs) {
+  size_t n = 0;
+  for (size_t i = 0; i < rs; i++) {
+    const lor_req_s* const req = &r[i];
+    int merged = 0;
+    for (size_t k = n; req->cset.cbits && k > 0; k--) {
+      lor_req_s* const prior = &r[k - 1];
+      if (prior->unit == req->unit && prior->cset.offset == req->cset.offset &&
+          prior->cset.cbits && lor_effect_equal(prior, req)) {
+        prior->cset.cbits |= req->cset.cbits;
+        merged = 1;
+        break;
+      }
+      if (lor_req_overlaps(prior, req)) break;
+    }
+    if (!merged) r[n++] = *req;
+  }
+  return n;
+}
+
+// Tags of the scratch indices used by lor_fold_broadcast.
+#define LOR_FOLD_MEMBER ((size_t) 1 << (sizeof(size_t) * 8 - 1))
+#define LOR_FOLD_MAJOR (LOR_FOLD_MEMBER >> 1)
+#define LOR_FOLD_FIRST (LOR_FOLD_MEMBER >> 2)
+#define LOR_FOLD_INDEX (LOR_FOLD_FIRST - 1)
+
+/// @brief Returns non-zero if request \p a orders before request \p b, by
+///        channel set then index.
+static int lor_fold_less(const lor_req_s* const r, const size_t a,
+                         const size_t b) {
+  const lor_channel_set* const x = &r[a].cset;
+  const lor_channel_set* const y = &r[b].cset;
+  if (x->offset != y->offset) return x->offset < y->offset;
+  if (x->cbits != y->cbits) return x->cbits < y->cbits;
+  return a < b;
+}
+
+/// @brief Restores the max-heap property of the subtree rooted at \p i.
+static void lor_fold_sift(const lor_req_s* const r, size_t* const idx,
+                          size_t i, const size_t n) {
+  for (size_t c; (c = 2 * i + 1) < n; i = c) {
+    if (c + 1 < n && lor_fold_less(r, idx[c], idx[c + 1])) c++;
+    if (!lor_fold_less(r, idx[i], idx[c])) return;
+    const size_t t = idx[i];
+    idx[i] = idx[c];
+    idx[c] = t;
+  }
+}
+
+/// @brief Determines whether a request may apply to a unit of the network.
+static int lor_fold_reaches(const lor_req_s* const o,
+                            const unsigned char* const mask) {
+  return o->unit == 0xFF || (mask[o->unit / 8] & 1 << o->unit % 8);
+}
+
+/// @brief Checks whether the bucket of requests sharing a channel set, the
+///        sorted indices [a, b), may be folded into a broadcast request and
+///        if so, tags its members.
+/// @param r The requests.
+/// @param idx The sorted request indices.
+/// @param a The first sorted index of the bucket.
+/// @param b The end of the bucket.
+/// @param mask The 256-bit set of units on the network.
+/// @param us The number of units on the network.
+/// @param reach The number of requests per offset and bit which may apply to
+///              a unit of the network.
+/// @param wide The number of unit-wide requests which may apply to a unit of
+///             the network.
+/// @param total The number of requests which may apply to a unit of the
+///              network.
+static void lor_fold_bucket(const lor_req_s* const r, size_t* const idx,
+                            const size_t a, const size_t b,
+                            const unsigned char* const mask, const size_t us,
+                            size_t reach[64][16], const size_t wide,
+                            const size_t total) {
+  // every unit of the network has exactly one request for the channel set
+  unsigned char seen[32] = {0};
+  size_t count = 0;
+  for (size_t p = a; p < b; p++) {
+    const lor_req_s* const o = &r[idx[p]];
+    if (!lor_fold_reaches(o, mask)) continue;
+    if (o->unit == 0xFF || (seen[o->unit / 8] & 1 << o->unit % 8)) return;
+    seen[o->unit / 8] |= 1 << o->unit % 8;
+    count++;
+  }
+  if (count != us) return;
+  // and no other request to the same channels prevents reordering
+  const lor_channel_set* const cset = &r[idx[a]].cset;
+  if (!cset->cbits) {
+    if (total != count) return;
+  } else {
+    if (wide) return;
+    for (int i = 0; i < 16; i++)
+      if ((cset->cbits & 1 << i) && reach[cset->offset % 64][i] != count)
+        return;
+  }
+  // the first request of the most common effect, which must be shared,
+  // counted per distinct effect (at most one per unit) in order of appearance
+  size_t rep[256], reps = 0, major = 0, best = 0;
+  unsigned char votes[256];
+  for (size_t p = a; p < b; p++) {
+    if (!lor_fold_reaches(&r[idx[p]], mask)) continue;
+    size_t k = 0;
+    while (k < reps && !lor_effect_equal(&r[rep[k]], &r[idx[p]])) k++;
+    if (k == reps) rep[reps++] = idx[p], votes[k] = 0;
+    votes[k]++;
+  }
+  for (size_t k = 0; k < reps; k++)
+    if (votes[k] > best) best = votes[k], major = rep[k];
+  if (best < 2) return;
+  int first = 1;
+  for (size_t p = a; p < b; p++) {
+    if (!lor_fold_reaches(&r[idx[p]], mask)) continue;
+    if (lor_effect_equal(&r[idx[p]], &r[major])) idx[p] |= LOR_FOLD_MAJOR;
+    if (first) idx[p] |= LOR_FOLD_FIRST, first = 0;
+    idx[p] |= LOR_FOLD_MEMBER;
+  }
+}
+
+size_t lor_fold_broadcast(const lor_req_s* r, const size_t rs,
+                          const lor_unit* units, const size_t us, size_t* tmp,
+                          lor_req_s* out) {
+  unsigned char mask[32] = {0};
+  size_t unique = 0;
+  for (size_t i = 0; i < us; i++) {
+    if (units[i] == 0xFF || (mask[units[i] / 8] & 1 << units[i] % 8)) continue;
+    mask[units[i] / 8] |= 1 << units[i] % 8;
+    unique++;
+  }
+  // count the requests reaching the network per channel, to detect overlaps
+  size_t reach[64][16] = {{0}};
+  size_t wide = 0, total = 0;
+  for (size_t i = 0; i < rs; i++) {
+    tmp[i] = i;
+    if (!lor_fold_reaches(&r[i], mask)) continue;
+    total++;
+    if (!r[i].cset.cbits) wide++;
+    for (int b = 0; b < 16; b++)
+      if (r[i].cset.cbits & 1 << b) reach[r[i].cset.offset % 64][b]++;
+  }
+  // bucket the requests by channel set with a heapsort, then check each once
+  for (size_t i = rs / 2; i-- > 0;) lor_fold_sift(r, tmp, i, rs);
+  for (size_t i = rs; i-- > 1;) {
+    const size_t t = tmp[0];
+    tmp[0] = tmp[i];
+    tmp[i] = t;
+    lor_fold_sift(r, tmp, 0, i);
+  }
+  for (size_t a = 0, b; a < rs; a = b) {
+    const lor_channel_set* const cset = &r[tmp[a]].cset;
+    for (b = a + 1; b < rs && r[tmp[b]].cset.offset == cset->offset &&
+                    r[tmp[b]].cset.cbits == cset->cbits;
+         b++)
+      continue;
+    lor_fold_bucket(r, tmp, a, b, mask, unique, reach, wide, total);
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < rs; i++) {
+    // find the sorted position of the request
+    size_t lo = 0, hi = rs;
+    while (hi - lo > 1) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (lor_fold_less(r, i, tmp[mid] & LOR_FOLD_INDEX)) hi = mid;
+      else lo = mid;
+    }
+    const size_t t = tmp[lo];
+    if (!(t & LOR_FOLD_MEMBER)) {
+      out[n++] = r[i];
+      continue;
+    }
+    if (!(t & LOR_FOLD_FIRST)) continue;// written with the first request
+    size_t p = lo;
+    while (!(tmp[p] & LOR_FOLD_MAJOR)) p++;
+    out[n] = r[tmp[p] & LOR_FOLD_INDEX];
+    out[n++].unit = 0xFF;
+    // followed by the members of the bucket using a different effect
+    for (p = lo; p < rs; p++) {
+      const lor_req_s* const o = &r[tmp[p] & LOR_FOLD_INDEX];
+      if (o->cset.offset != r[i].cset.offset ||
+          o->cset.cbits != r[i].cset.cbits)
+        break;
+      if ((tmp[p] & LOR_FOLD_MEMBER) && !(tmp[p] & LOR_FOLD_MAJOR))
+        out[n++] = *o;
+    }
+  }
+  return n;
+}
+
+// The intensity tables below are pre-computed from the following formulas,
+// mapping b in (0,255) to the LOR intensity range of (1,240):
+//   linear:  240 - (lor_intensity) ((1.0f - ((float) b / 255.0f)) * 239)
+//   gamma:   1 + round(239 * pow(b / 255.0, 2.2))
+//   CIE:     1 + round(239 * Y), where L* = b / 255.0 * 100 and
+//            Y = L* > 8 ? pow((L* + 16) / 116, 3) : L* / 903.3
+
+/// @brief Linear intensity conversion table used by lor_get_intensity.
+static const lor_intensity lor_intensity_linear[256] = {
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+        13, 14, 15, 16, 16, 17, 18, 19, 20, 21, 22, 23,
+        24, 25, 26, 27, 28, 29, 30, 31, 31, 32, 33, 34,
+        35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+        46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57,
+        58, 59, 60, 61, 61, 62, 63, 64, 65, 66, 67, 68,
+        69, 70, 71, 72, 73, 74, 75, 76, 76, 77, 78, 79,
+        80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91,
+        91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102,
+        103, 104, 105, 106, 106, 107, 108, 109, 110, 111, 112, 113,
+        114, 115, 116, 117, 118, 119, 120, 121, 121, 122, 123, 124,
+        125, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136,
+        136, 137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147,
+        148, 149, 150, 151, 151, 152, 153, 154, 155, 156, 157, 158,
+        159, 160, 161, 162, 163, 164, 165, 166, 166, 167, 168, 169,
+        170, 171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181,
+        181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192,
+        193, 194, 195, 196, 196, 197, 198, 199, 200, 201, 202, 203,
+        204, 205, 206, 207, 208, 209, 210, 211, 211, 212, 213, 214,
+        215, 216, 217, 218, 219, 220, 221, 222, 223, 224, 225, 226,
+        226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237,
+        238, 239, 240, 240};
+
+/// @brief Gamma 2.2 intensity conversion table used by
+///        lor_get_intensity_gamma.
+static const lor_intensity lor_intensity_gamma[256] = {
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4,
+        4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7,
+        7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 10, 11,
+        11, 11, 12, 12, 12, 13, 13, 14, 14, 14, 15, 15,
+        16, 16, 17, 17, 18, 18, 19, 19, 20, 20, 21, 21,
+        22, 22, 23, 23, 24, 25, 25, 26, 26, 27, 28, 28,
+        29, 30, 30, 31, 31, 32, 33, 34, 34, 35, 36, 36,
+        37, 38, 39, 39, 40, 41, 42, 42, 43, 44, 45, 46,
+        47, 47, 48, 49, 50, 51, 52, 53, 53, 54, 55, 56,
+        57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
+        69, 70, 71, 72, 73, 74, 75, 76, 78, 79, 80, 81,
+        82, 83, 84, 86, 87, 88, 89, 90, 92, 93, 94, 95,
+        96, 98, 99, 100, 102, 103, 104, 105, 107, 108, 109, 111,
+        112, 113, 115, 116, 118, 119, 120, 122, 123, 125, 126, 128,
+        129, 130, 132, 133, 135, 136, 138, 140, 141, 143, 144, 146,
+        147, 149, 150, 152, 154, 155, 157, 159, 160, 162, 164, 165,
+        167, 169, 170, 172, 174, 175, 177, 179, 181, 182, 184, 186,
+        188, 190, 191, 193, 195, 197, 199, 201, 203, 204, 206, 208,
+        210, 212, 214, 216, 218, 220, 222, 224, 226, 228, 230, 232,
+        234, 236, 238, 240};
+
+/// @brief CIE 1931 lightness intensity conversion table used by
+///        lor_get_intensity_cie.
+static const lor_intensity lor_intensity_cie[256] = {
+        1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5,
+        5, 5, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7,
+        7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10,
+        10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14,
+        14, 15, 15, 15, 16, 16, 16, 17, 17, 18, 18, 19,
+        19, 19, 20, 20, 21, 21, 22, 22, 23, 23, 24, 24,
+        25, 25, 26, 26, 27, 27, 28, 28, 29, 30, 30, 31,
+        31, 32, 33, 33, 34, 35, 35, 36, 37, 37, 38, 39,
+        39, 40, 41, 42, 42, 43, 44, 45, 45, 46, 47, 48,
+        49, 49, 50, 51, 52, 53, 54, 55, 56, 56, 57, 58,
+        59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70,
+        71, 72, 74, 75, 76, 77, 78, 79, 80, 81, 83, 84,
+        85, 86, 87, 89, 90, 91, 93, 94, 95, 96, 98, 99,
+        100, 102, 103, 105, 106, 107, 109, 110, 112, 113, 115, 116,
+        118, 119, 121, 122, 124, 125, 127, 128, 130, 132, 133, 135,
+        136, 138, 140, 142, 143, 145, 147, 148, 150, 152, 154, 156,
+        157, 159, 161, 163, 165, 167, 169, 171, 172, 174, 176, 178,
+        180, 182, 184, 186, 188, 191, 193, 195, 197, 199, 201, 203,
+        205, 208, 210, 212, 214, 217, 219, 221, 223, 226, 228, 230,
+        233, 235, 238, 240};
+
 lor_intensity lor_get_intensity(const unsigned char b) {
-  // scale b from (0,255) to (240,1) which is the LOR intensity range
-  static const lor_intensity ceiling = 240;
-  return ceiling - (lor_intensity) ((1.0f - ((float) b / 255.0f)) * 239);
+  return lor_intensity_linear[b];
+}
+
+lor_intensity lor_get_intensity_gamma(const unsigned char b) {
+  return lor_intensity_gamma[b];
+}
+
+lor_intensity lor_get_intensity_cie(const unsigned char b) {
+  return lor_intensity_cie[b];
+}
+
+void lor_get_intensities(lor_intensity* dst, const unsigned char* src,
+                         const size_t n, const lor_intensity_fn fn) {
+  const lor_intensity* t = NULL;
+  lor_intensity custom[256];
+  if (fn == NULL || fn == lor_get_intensity) {
+    t = lor_intensity_linear;
+  } else if (fn == lor_get_intensity_gamma) {
+    t = lor_intensity_gamma;
+  } else if (fn == lor_get_intensity_cie) {
+    t = lor_intensity_cie;
+  } else if (n > 256) {
+    // amortize custom conversion functions by tabulating every input value
+    for (int i = 0; i < 256; i++) custom[i] = fn((unsigned char) i);
+    t = custom;
+  } else {
+    for (size_t i = 0; i < n; i++) dst[i] = fn(src[i]);
+    return;
+  }
+  for (size_t i = 0; i < n; i++) dst[i] = t[src[i]];
+}
+
+void lor_dirty_init(lor_dirty_s* d) { __builtin_memset(d, 0, sizeof(*d)); }
+
+void lor_dirty_mark(lor_dirty_s* d, const lor_unit u, const lor_channel c) {
+  if (c >= 1024) return;
+  d->cbits[u][c / 16] |= 1 << (c % 16);
+  d->banks[u] |= 1ULL << (c / 16);
+  d->units[u / 64] |= 1ULL << (u % 64);
+}
+
+void lor_dirty_mark_set(lor_dirty_s* d, const lor_unit u,
+                        const lor_channel_set* cset) {
+  if (!cset->cbits || cset->offset >= 64) return;
+  d->cbits[u][cset->offset] |= cset->cbits;
+  d->banks[u] |= 1ULL << cset->offset;
+  d->units[u / 64] |= 1ULL << (u % 64);
+}
+
+int lor_dirty_next(lor_dirty_s* d, lor_unit* u, lor_channel_set* cset) {
+  for (int w = 0; w < 4; w++) {
+    if (!d->units[w]) continue;
+    const int unit = w * 64 + __builtin_ctzll(d->units[w]);
+    const int bank = __builtin_ctzll(d->banks[unit]);
+    *u = (lor_unit) unit;
+    *cset = (lor_channel_set){(unsigned char) bank, d->cbits[unit][bank]};
+    d->cbits[unit][bank] = 0;
+    d->banks[unit] &= d->banks[unit] - 1;
+    if (!d->banks[unit]) d->units[w] &= d->units[w] - 1;
+    return 1;
+  }
+  return 0;
+}
+
+int lor_frame_init(lor_frame_s* f, lor_intensity* b, const lor_unit first,
+                   const lor_unit units, const lor_channel channels) {
+  if (b == NULL || !units || !channels || channels > 1024) return -1;
+  const size_t n = (size_t) units * channels;
+  __builtin_memset(b, 0, n * 2);
+  f->cur = b;
+  f->prev = &b[n];
+  f->fn = lor_get_intensity;
+  f->channels = channels;
+  f->first = first;
+  f->units = units;
+  f->dirty = NULL;
+  return 0;
+}
+
+void lor_frame_track(lor_frame_s* f, lor_dirty_s* d) {
+  f->dirty = d;
+  if (d == NULL) return;
+  for (int u = 0; u < f->units; u++) {
+    for (int c = 0; c < f->channels; c += 16) {
+      const int len = f->channels - c < 16 ? f->channels - c : 16;
+      const lor_channel_set cset = {(unsigned char) (c / 16),
+                                    (unsigned short) ((1UL << len) - 1)};
+      lor_dirty_mark_set(d, (lor_unit) (f->first + u), &cset);
+    }
+  }
+}
+
+int lor_frame_set(lor_frame_s* f, const lor_unit u, const lor_channel c,
+                  const unsigned char b) {
+  if (u < f->first || u - f->first >= f->units || c >= f->channels) return -1;
+  const size_t i = (size_t) (u - f->first) * f->channels + c;
+  f->cur[i] = f->fn(b);
+  if (f->dirty != NULL && f->cur[i] != f->prev[i])
+    lor_dirty_mark(f->dirty, u, c);
+  return 0;
+}
+
+/// @brief Writes the requests applying the changes of one bank of 16 channels.
+/// @param f The frame to compare.
+/// @param u The unit index of the bank, relative to the first unit.
+/// @param c The first channel of the bank.
+/// @param r The request buffer to write to.
+/// @param rs The maximum number of requests to write.
+/// @param n The number of requests already written, updated.
+/// @return The changed channels of the bank not written due to lack of space.
+static unsigned short lor_frame_diff_bank(lor_frame_s* f, const int u,
+                                          const int c, lor_req_s* r,
+                                          const size_t rs, size_t* n) {
+  const size_t base = (size_t) u * f->channels;
+  const lor_intensity* const cur = &f->cur[base + c];
+  lor_intensity* const prev = &f->prev[base + c];
+  const int len = f->channels - c < 16 ? f->channels - c : 16;
+  unsigned short changed = 0;
+  for (int i = 0; i < len; i++)
+    if (cur[i] != prev[i]) changed |= 1 << i;
+  while (changed) {
+    if (*n == rs) return changed;
+    // group all changed channels in the bank sharing the same intensity
+    const lor_intensity v = cur[__builtin_ctz(changed)];
+    unsigned short cbits = 0;
+    for (int i = __builtin_ctz(changed); i < len; i++) {
+      if (!(changed & (1 << i)) || cur[i] != v) continue;
+      cbits |= 1 << i;
+      prev[i] = v;
+    }
+    changed &= ~cbits;
+    lor_req_s* const req = &r[(*n)++];
+    lor_set_unit(req, (lor_unit) (f->first + u));
+    req->cset = (lor_channel_set){(unsigned char) (c / 16), cbits};
+    lor_set_intensity(req, v);
+  }
+  return 0;
+}
+
+size_t lor_frame_diff(lor_frame_s* f, lor_req_s* r, const size_t rs) {
+  size_t n = 0;
+  if (f->dirty != NULL) {
+    lor_unit u;
+    lor_channel_set cset;
+    while (lor_dirty_next(f->dirty, &u, &cset)) {
+      const int c = cset.offset * 16;
+      if (u < f->first || u - f->first >= f->units || c >= f->channels)
+        continue;
+      cset.cbits = lor_frame_diff_bank(f, u - f->first, c, r, rs, &n);
+      if (cset.cbits) {
+        // leave the unwritten changes pending for the next call
+        lor_dirty_mark_set(f->dirty, u, &cset);
+        return n;
+      }
+    }
+    return n;
+  }
+  for (int u = 0; u < f->units; u++)
+    for (int c = 0; c < f->channels; c += 16)
+      if (lor_frame_diff_bank(f, u, c, r, rs, &n)) return n;
+  return n;
+}
+
+/// @brief Returns the duration of a ramp of \p d frames rounded to the nearest
+///        decisecond, the duration of the fade replacing it.
+static long long lor_fit_decis(const long long d,
+                               const unsigned short period_ms) {
+  return (d * period_ms + 50) / 100;
+}
+
+/// @brief Finds the furthest frame a linear ramp starting at frame \p i may
+///        end at, such that the fade replacing it, whose duration is rounded
+///        to the nearest decisecond, is within \p tol of every intensity it
+///        covers.
+/// @param t The intensity of the channel at each frame.
+/// @param n The number of frames in \p t.
+/// @param i The starting frame of the ramp.
+/// @param period_ms The period of each frame in milliseconds.
+/// @param tol The maximum difference allowed between an intensity and a ramp.
+/// @return The last frame of the ramp, or \p i if no ramp is possible.
+static size_t lor_fit_ramp(const lor_intensity* const t, const size_t n,
+                           const size_t i, const unsigned short period_ms,
+                           const int tol) {
+  // slopes (in intensity per frame) allowed by every frame so far, kept as
+  // fractions to avoid rounding: lo_n / lo_d <= slope <= hi_n / hi_d
+  long long lo_n = -1000, lo_d = 1, hi_n = 1000, hi_d = 1;
+  size_t end = i;
+  for (size_t k = i + 1; k < n; k++) {
+    const long long d = (long long) (k - i);
+    const long long dv = t[k] - t[i];
+    if ((dv - tol) * lo_d > lo_n * d) lo_n = dv - tol, lo_d = d;
+    if ((dv + tol) * hi_d < hi_n * d) hi_n = dv + tol, hi_d = d;
+    if (lo_n * hi_d > hi_n * lo_d) break;
+    const long long ds = lor_fit_decis(d, period_ms);
+    if (d < 2 || !dv || !ds || ds > 0xFFFF) continue;
+    // the ramp may end at k if the slope of the rounded fade, dv * period_ms
+    // per ds * 100 ms, satisfies every frame up to k
+    const long long sn = dv * period_ms, sd = ds * 100;
+    if (sn * lo_d < lo_n * sd || sn * hi_d > hi_n * sd) continue;
+    // a fade rounded down finishes early and holds t[k] for the last frames
+    int held = 1;
+    for (long long j = d; held && j * period_ms > sd; j--) {
+      const long long err = t[i + (size_t) j] - t[k];
+      held = err <= tol && -err <= tol;
+    }
+    if (held) end = k;
+  }
+  return end;
+}
+
+size_t lor_fit_fades(const lor_intensity* t, const size_t n,
+                     const unsigned short period_ms, const unsigned char tol,
+                     const lor_req_s* target, lor_event_s* e,
+                     const size_t es) {
+  size_t w = 0;
+  int state = -1;// the intensity of the channel once the last event is sent
+  for (size_t i = 0; i < n && w < es;) {
+    lor_event_s* const ev = &e[w];
+    ev->frame = i;
+    ev->req = *target;
+    const size_t end = period_ms ? lor_fit_ramp(t, n, i, period_ms, tol) : i;
+    if (end > i) {
+      const lor_decisec ds =
+              (lor_decisec) lor_fit_decis((long long) (end - i), period_ms);
+      lor_set_fade(&ev->req, t[i], t[end], ds);
+      w++;
+      state = t[end];
+      i = end;
+      continue;
+    }
+    if (t[i] != state) {
+      lor_set_intensity(&ev->req, t[i]);
+      w++;
+      state = t[i];
+    }
+    i++;
+  }
+  return w;
+}
+
+void lor_dmx_init(lor_dmx_s* d, const lor_dmx_map_s* map, lor_frame_s* f) {
+  d->map = map;
+  d->frame = f;
+  d->primed = 0;
+}
+
+size_t lor_dmx_update(lor_dmx_s* d, const unsigned char* u, size_t n) {
+  if (n > LOR_DMX_SLOTS) n = LOR_DMX_SLOTS;
+  size_t w = 0;
+  for (size_t i = 0; i < n; i++) {
+    // skip unchanged runs of 8 slots with a single comparison
+    if (d->primed && !(i % 8) && n - i >= 8 &&
+        !__builtin_memcmp(&u[i], &d->prev[i], 8)) {
+      i += 7;
+      continue;
+    }
+    if (d->primed && u[i] == d->prev[i]) continue;
+    d->prev[i] = u[i];
+    const lor_dmx_map_s* const m = &d->map[i];
+    if (m->unit && !lor_frame_set(d->frame, m->unit, m->channel, u[i])) w++;
+  }
+  d->primed = 1;
+  return w;
+}
+
+/// @brief Returns non-zero if patch entry \p a orders before \p b.
+static int lor_patch_less(const lor_patch_entry_s* const a,
+                          const lor_patch_entry_s* const b) {
+  if (a->addr.unit != b->addr.unit) return a->addr.unit < b->addr.unit;
+  if (a->addr.channel != b->addr.channel)
+    return a->addr.channel < b->addr.channel;
+  return a->logical < b->logical;
 }
+
+/// @brief Restores the max-heap property of the subtree rooted at \p i.
+static void lor_patch_sift(lor_patch_entry_s* const e, size_t i,
+                           const size_t n) {
+  for (size_t c; (c = 2 * i + 1) < n; i = c) {
+    if (c + 1 < n && lor_patch_less(&e[c], &e[c + 1])) c++;
+    if (!lor_patch_less(&e[i], &e[c])) return;
+    const lor_patch_entry_s t = e[i];
+    e[i] = e[c];
+    e[c] = t;
+  }
+}
+
+int lor_patch_init(lor_patch_s* p, lor_addr_s* index, const size_t n,
+                   lor_patch_bank_s* banks, lor_patch_entry_s* e,
+                   const size_t es) {
+  __builtin_memset(index, 0, n * sizeof(*index));
+  for (size_t i = 0; i < es; i++) {
+    const lor_patch_entry_s* const pe = &e[i];
+    if (pe->logical >= n || !pe->addr.unit || pe->addr.channel >= 1024 ||
+        index[pe->logical].unit)
+      return -1;
+    index[pe->logical] = pe->addr;
+  }
+  // heapsort, to order the entries without allocating
+  for (size_t i = es / 2; i-- > 0;) lor_patch_sift(e, i, es);
+  for (size_t i = es; i-- > 1;) {
+    const lor_patch_entry_s t = e[0];
+    e[0] = e[i];
+    e[i] = t;
+    lor_patch_sift(e, 0, i);
+  }
+  size_t bs = 0;
+  for (size_t i = 0; i < es; i++) {
+    const lor_addr_s* const a = &e[i].addr;
+    const unsigned char off = (unsigned char) (a->channel / 16);
+    lor_patch_bank_s* b = bs ? &banks[bs - 1] : NULL;
+    if (b == NULL || b->unit != a->unit || b->cset.offset != off) {
+      b = &banks[bs++];
+      *b = (lor_patch_bank_s){a->unit, {off, 0}, i, 0};
+    }
+    b->cset.cbits |= 1 << (a->channel % 16);
+    b->count++;
+  }
+  *p = (lor_patch_s){index, n, e, es, banks, bs};
+  return 0;
+}
+
+const lor_addr_s* lor_patch_get(const lor_patch_s* p,
+                                const unsigned long logical) {
+  if (logical >= p->n || !p->index[logical].unit) return NULL;
+  return &p->index[logical];
+}
+
+size_t lor_patch_update(const lor_patch_s* p, lor_frame_s* f,
+                        const unsigned char* v) {
+  size_t w = 0;
+  for (size_t i = 0; i < p->es; i++) {
+    const lor_patch_entry_s* const pe = &p->e[i];
+    if (!lor_frame_set(f, pe->addr.unit, pe->addr.channel, v[pe->logical]))
+      w++;
+  }
+  return w;
+}
+
+/// @brief Reads a 16-bit big endian (network order) value.
+/// @param b The buffer to read the value from.
+/// @return The value read.
+static unsigned short lor_get_u16be(const unsigned char* const b) {
+  return (unsigned short) (b[0] << 8 | b[1]);
+}
+
+int lor_e131_parse(lor_e131_s* p, const unsigned char* b, const size_t bs) {
+  static const unsigned char acn_id[12] = "ASC-E1.17\0\0";
+  // root layer, framing layer and DMP layer headers up to the start code
+  if (bs < 126 || bs > 638) return -1;
+  if (lor_get_u16be(b) != 0x0010 || __builtin_memcmp(&b[4], acn_id, 12))
+    return -1;
+  if (lor_get_u16be(&b[18]) || lor_get_u16be(&b[20]) != 0x0004) return -1;
+  if (lor_get_u16be(&b[40]) || lor_get_u16be(&b[42]) != 0x0002) return -1;
+  if (b[117] != 0x02 || b[118] != 0xA1) return -1;
+  const unsigned short count = lor_get_u16be(&b[123]);
+  if (!count || 125 + (size_t) count > bs) return -1;
+  p->slots = &b[126];
+  p->n = count - 1;
+  p->universe = lor_get_u16be(&b[113]);
+  p->priority = b[108];
+  p->sequence = b[111];
+  p->options = b[112];
+  p->start_code = b[125];
+  return 0;
+}
+
+/// @brief Writes a 16-bit big endian (network order) value.
+/// @param b The buffer to write the value to.
+/// @param v The value to write.
+static void lor_put_u16be(unsigned char* const b, const size_t v) {
+  b[0] = (unsigned char) (v >> 8);
+  b[1] = (unsigned char) v;
+}
+
+size_t lor_e131_build(unsigned char* b, const size_t bs,
+                      const unsigned short universe, const unsigned char seq,
+                      const unsigned char* slots, const size_t n) {
+  const size_t size = 126 + n;
+  if (n > LOR_DMX_SLOTS || size > bs) return 0;
+  __builtin_memset(b, 0, 126);
+  // root layer: preamble, ACN packet identifier, flags and length, vector
+  b[1] = 0x10;
+  __builtin_memcpy(&b[4], "ASC-E1.17", 9);
+  lor_put_u16be(&b[16], 0x7000 | (size - 16));
+  b[21] = 0x04;
+  // framing layer: flags and length, vector, source name, priority, sequence
+  lor_put_u16be(&b[38], 0x7000 | (size - 38));
+  b[43] = 0x02;
+  __builtin_memcpy(&b[44], "tinylor", 7);
+  b[108] = 100;
+  b[111] = seq;
+  lor_put_u16be(&b[113], universe);
+  // DMP layer: flags and length, vector, address types, count, start code
+  lor_put_u16be(&b[115], 0x7000 | (size - 115));
+  b[117] = 0x02;
+  b[118] = 0xA1;
+  b[122] = 0x01;
+  lor_put_u16be(&b[123], n + 1);
+  __builtin_memcpy(&b[126], slots, n);
+  return size;
+}
+
+int lor_e131_sequence_ok(const unsigned char last, const unsigned char seq) {
+  const int d = (signed char) (unsigned char) (seq - last);
+  return d > 0 || d <= -20;
+}
+
+size_t lor_wire_bytes(const unsigned long baud, const unsigned long ms) {
+  return (size_t) ((unsigned long long) baud * ms / 10000);
+}
+
+unsigned long lor_wire_us(const unsigned long baud, const size_t n) {
+  if (!baud) return 0;
+  const unsigned long long bits = (unsigned long long) n * 10 * 1000000;
+  return (unsigned long) ((bits + baud - 1) / baud);
+}
+
+int lor_sched_init(lor_sched_s* s, lor_sched_entry_s* e, const size_t es,
+                   const unsigned long baud, const unsigned long ms) {
+  if (e == NULL || !es) return -1;
+  *s = (lor_sched_s){.e = e, .es = es, .budget = lor_wire_bytes(baud, ms)};
+  return 0;
+}
+
+int lor_sched_add(lor_sched_s* s, const lor_req_s* req,
+                  const unsigned char priority) {
+  if (s->n == s->es) return -1;
+  s->e[s->n++] = (lor_sched_entry_s){*req, priority};
+  return 0;
+}
+
+size_t lor_sched_next(lor_sched_s* s, lor_req_s* r, const size_t rs) {
+  // find the lowest priority whose requests (and all above it) fit entirely
+  size_t sizes[256] = {0};
+  for (size_t i = 0; i < s->n; i++)
+    sizes[s->e[i].priority] += lor_req_size(&s->e[i].req);
+  size_t used = s->reserved < s->budget ? s->reserved : s->budget;
+  s->reserved = 0;
+  int p = 255;
+  for (; p >= 0 && used + sizes[p] <= s->budget; p--) used += sizes[p];
+
+  // admit those priorities, plus what fits of priority p in original order
+  size_t n = 0, k = 0;
+  for (size_t i = 0; i < s->n; i++) {
+    lor_sched_entry_s* const e = &s->e[i];
+    if (n < rs && e->priority >= p) {
+      const size_t w = lor_req_size(&e->req);
+      if (e->priority > p) {
+        r[n++] = e->req;
+        continue;
+      }
+      if (w <= s->budget - used) {
+        r[n++] = e->req;
+        used += w;
+        continue;
+      }
+    }
+    if (e->priority < 255) e->priority++;
+    s->e[k++] = *e;
+  }
+  s->n = k;
+  return n;
+}
+
+int lor_queue_init(lor_queue_s* q, lor_queue_entry_s* e, const size_t es,
+                   size_t* slots, const size_t ss) {
+  if (e == NULL || !es || (es & (es - 1))) return -1;
+  if (slots == NULL || !ss || (ss & (ss - 1))) return -1;
+  *q = (lor_queue_s){.e = e, .es = es, .slots = slots, .ss = ss};
+  return 0;
+}
+
+int lor_queue_push(lor_queue_s* q, const lor_req_s* req) {
+  const unsigned long long key =
+          req->unit | (unsigned long long) req->cset.offset << 8 |
+          (unsigned long long) req->cset.cbits << 16 |
+          (unsigned long long) (req->effect == LOR_SET_DMX_INTENSITY) << 32;
+  size_t* const slot = &q->slots[((key * 0x9E3779B97F4A7C15ULL) >> 32) &
+                                 (q->ss - 1)];
+  const size_t seq = *slot;
+  lor_queue_entry_s* old = NULL;
+  if (seq - q->head < q->tail - q->head) {
+    old = &q->e[seq & (q->es - 1)];
+    if (!old->live || old->key != key) old = NULL;
+  }
+  if (old != NULL) {
+    // replace in place unless a later request overlaps the same channels,
+    // a linear scan of the requests queued after the match
+    size_t i = seq + 1;
+    for (; i != q->tail; i++) {
+      const lor_queue_entry_s* const e = &q->e[i & (q->es - 1)];
+      if (e->live && lor_req_overlaps(&e->req, req)) break;
+    }
+    if (i == q->tail) {
+      old->req = *req;
+      q->superseded++;
+      return 0;
+    }
+  }
+  if (q->tail - q->head == q->es) {
+    q->rejected++;
+    return -1;
+  }
+  if (old != NULL) {
+    old->live = 0;
+    q->depth--;
+    q->superseded++;
+  }
+  *slot = q->tail;
+  q->e[q->tail++ & (q->es - 1)] = (lor_queue_entry_s){*req, key, 1};
+  q->depth++;
+  return 0;
+}
+
+size_t lor_queue_write(lor_queue_s* q, unsigned char* b, const size_t bs) {
+  size_t h = 0;
+  for (; q->head != q->tail; q->head++) {
+    const lor_queue_entry_s* const e = &q->e[q->head & (q->es - 1)];
+    if (!e->live) continue;
+    if (lor_req_size(&e->req) > bs - h) break;
+    h += lor_encode_req(&b[h], &e->req);
+    q->depth--;
+  }
+  return h;
+}
+
+void lor_stream_init(lor_stream_s* s, const unsigned long baud) {
+  *s = (lor_stream_s){.baud = baud};
+}
+
+size_t lor_stream_heartbeat_size(const lor_stream_s* s,
+                                 const unsigned long long now,
+                                 const unsigned long ms) {
+  const unsigned long long end = now + ms * 1000000ULL;
+  size_t n = 0;
+  // overdue heartbeats are sent once, not once per missed period
+  unsigned long long t = s->next_heartbeat > now ? s->next_heartbeat : now;
+  for (; t < end; t += LOR_HEARTBEAT_DELAY_NS) n += LOR_HEARTBEAT_SIZE;
+  return n;
+}
+
+size_t lor_stream_write(lor_stream_s* s, const unsigned long long now,
+                        unsigned char* b, const size_t bs, const lor_req_s* r,
+                        const size_t rs, size_t* n) {
+  const unsigned long long start = s->busy_until > now ? s->busy_until : now;
+  size_t h = 0, i = 0;
+  for (;;) {
+    // estimated time the next byte written will be sent
+    const unsigned long long t = start + lor_wire_us(s->baud, h) * 1000ULL;
+    if (t >= s->next_heartbeat) {
+      if (LOR_HEARTBEAT_SIZE > bs - h) break;
+      __builtin_memcpy(&b[h], LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE);
+      h += LOR_HEARTBEAT_SIZE;
+      s->next_heartbeat = t + LOR_HEARTBEAT_DELAY_NS;
+      continue;
+    }
+    if (i == rs || lor_req_size(&r[i]) > bs - h) break;
+    h += lor_encode_req(&b[h], &r[i++]);
+  }
+  s->busy_until = start + lor_wire_us(s->baud, h) * 1000ULL;
+  if (n != NULL) *n = i;
+  return h;
+}
+
+/// @brief Writes a 32-bit little endian value into a 4-byte buffer.
+/// @param b The buffer to write the value to.
+/// @param v The value to write.
+static void lor_put_u32(unsigned char* const b, const unsigned long v) {
+  b[0] = v & 0xFF;
+  b[1] = v >> 8 & 0xFF;
+  b[2] = v >> 16 & 0xFF;
+  b[3] = v >> 24 & 0xFF;
+}
+
+/// @brief Reads a 32-bit little endian value from a 4-byte buffer.
+/// @param b The buffer to read the value from.
+/// @return The value read.
+static unsigned long lor_get_u32(const unsigned char* const b) {
+  return (unsigned long) b[0] | (unsigned long) b[1] << 8 |
+         (unsigned long) b[2] << 16 | (unsigned long) b[3] << 24;
+}
+
+size_t lor_show_compile(unsigned char* b, const size_t bs, const lor_req_s* r,
+                        const size_t* rc, const unsigned long frames,
+                        const unsigned short period_ms) {
+  const size_t index = LOR_SHOW_HEADER_SIZE + ((size_t) frames + 1) * 4;
+  size_t data = 0, k = 0;
+  for (unsigned long i = 0; i < frames; k += rc[i++])
+    data += lor_write_size(&r[k], rc[i]);
+  if (index + data > bs) return index + data;
+
+  __builtin_memcpy(b, "LORS", 4);
+  b[4] = 1;// version
+  b[5] = 0;
+  b[6] = period_ms & 0xFF;
+  b[7] = period_ms >> 8;
+  lor_put_u32(&b[8], frames);
+  size_t h = 0;
+  k = 0;
+  for (unsigned long i = 0; i < frames; k += rc[i++]) {
+    lor_put_u32(&b[LOR_SHOW_HEADER_SIZE + i * 4], h);
+    h += lor_write(&b[index + h], data - h, &r[k], rc[i]);
+  }
+  lor_put_u32(&b[LOR_SHOW_HEADER_SIZE + frames * 4], h);
+  return index + data;
+}
+
+int lor_show_open(lor_show_s* s, const unsigned char* b, const size_t bs) {
+  if (bs < LOR_SHOW_HEADER_SIZE || __builtin_memcmp(b, "LORS", 4) || b[4] != 1)
+    return -1;
+  const unsigned long frames = lor_get_u32(&b[8]);
+  if ((bs - LOR_SHOW_HEADER_SIZE) / 4 <= frames) return -1;
+  const size_t index = LOR_SHOW_HEADER_SIZE + ((size_t) frames + 1) * 4;
+  // offsets must be ordered and within the data to be safe to play back
+  unsigned long prev = 0;
+  for (unsigned long i = 0; i <= frames; i++) {
+    const unsigned long off = lor_get_u32(&b[LOR_SHOW_HEADER_SIZE + i * 4]);
+    if (off < prev || off > bs - index) return -1;
+    prev = off;
+  }
+  *s = (lor_show_s){.b = b, .bs = bs, .frames = frames};
+  s->period_ms = (unsigned short) (b[6] | b[7] << 8);
+  return 0;
+}
+
+const unsigned char* lor_show_frame(const lor_show_s* s, const unsigned long i,
+                                    size_t* n) {
+  const unsigned char* const index = &s->b[LOR_SHOW_HEADER_SIZE + i * 4];
+  const unsigned long off = lor_get_u32(index);
+  *n = lor_get_u32(&index[4]) - off;
+  return &s->b[LOR_SHOW_HEADER_SIZE + ((size_t) s->frames + 1) * 4 + off];
+}
+
+int lor_cache_init(lor_cache_s* c, lor_cache_entry_s* e, const size_t es) {
+  if (e == NULL || !es || (es & (es - 1))) return -1;
+  __builtin_memset(e, 0, es * sizeof(*e));
+  *c = (lor_cache_s){.e = e, .es = es};
+  return 0;
+}
+
+/// @brief Packs the effect arguments used by a request into a single value.
+/// @param req The request to pack.
+/// @return The packed effect arguments, zero if the effect has none.
+static unsigned long lor_pack_args(const lor_req_s* const req) {
+  const lor_effect_args_u* const d = &req->args;
+  switch (req->effect) {
+    case LOR_SET_INTENSITY:
+      return d->set_intensity.intensity;
+    case LOR_FADE:
+      return d->fade.start_intensity |
+             (unsigned long) d->fade.end_intensity << 8 |
+             (unsigned long) d->fade.deciseconds << 16;
+    case LOR_PULSE:
+      return d->pulse.deciseconds;
+    case LOR_SET_DMX_INTENSITY:
+      return d->set_dmx_intensity.output;
+    default:
+      return 0;
+  }
+}
+
+size_t lor_cache_write(lor_cache_s* c, unsigned char* b, const size_t bs,
+                       const lor_req_s* r, const size_t rs) {
+  size_t h = 0;
+  for (size_t i = 0; i < rs; i++) {
+    const lor_req_s* const req = &r[i];
+    const unsigned long long key =
+            req->unit | (unsigned long long) req->effect << 8 |
+            (unsigned long long) req->cset.offset << 16 |
+            (unsigned long long) req->cset.cbits << 24;
+    const unsigned long args = lor_pack_args(req);
+    // Fibonacci hashing of the combined key
+    const unsigned long long hash =
+            (key ^ (unsigned long long) args << 40 ^ args) *
+            0x9E3779B97F4A7C15ULL;
+    lor_cache_entry_s* const e = &c->e[(hash >> 32) & (c->es - 1)];
+    if (e->size && e->key == key && e->args == args) {
+      if (e->size > bs - h) return e->size;
+      __builtin_memcpy(&b[h], e->b, e->size);
+      h += e->size;
+      c->hits++;
+      continue;
+    }
+    const size_t w = lor_req_size(req);
+    if (w > bs - h) return w;
+    if (e->size) c->evictions++;
+    c->misses++;
+    e->key = key;
+    e->args = args;
+    e->size = (unsigned char) lor_encode_req(e->b, req);
+    __builtin_memcpy(&b[h], e->b, w);
+    h += w;
+  }
+  return h;
+}
+
+int lor_ring_init(lor_ring_s* ring, unsigned char* b, const size_t bs) {
+  if (b == NULL || !bs || (bs & (bs - 1))) return -1;
+  *ring = (lor_ring_s){.b = b, .bs = bs};
+  return 0;
+}
+
+size_t lor_ring_write(lor_ring_s* ring, const lor_req_s* r, const size_t rs) {
+  const size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  size_t head = ring->head;// only modified by this thread
+  size_t i = 0;
+  for (; i < rs; i++) {
+    const size_t w = lor_req_size(&r[i]);
+    if (w > ring->bs - (head - tail)) break;
+    const size_t off = head & (ring->bs - 1);
+    if (w <= ring->bs - off) {
+      lor_encode_req(&ring->b[off], &r[i]);
+    } else {
+      // wrap the request around the end of the ring storage
+      unsigned char t[LOR_REQ_MAX_SIZE];
+      lor_encode_req(t, &r[i]);
+      __builtin_memcpy(&ring->b[off], t, ring->bs - off);
+      __builtin_memcpy(ring->b, &t[ring->bs - off], w - (ring->bs - off));
+    }
+    head += w;
+  }
+  __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+  return i;
+}
+
+const unsigned char* lor_ring_read(lor_ring_s* ring, size_t* n) {
+  const size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  const size_t off = ring->tail & (ring->bs - 1);
+  const size_t avail = head - ring->tail;
+  *n = avail < ring->bs - off ? avail : ring->bs - off;
+  return &ring->b[off];
+}
+
+void lor_ring_release(lor_ring_s* ring, const size_t n) {
+  __atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+}
+
+size_t lor_shard(const lor_req_s* r, const size_t rs, const unsigned char* net,
+                 const size_t ns, lor_req_s* out, const size_t os,
+                 size_t* first) {
+  // count the requests of each network, then place them by counting sort
+  __builtin_memset(first, 0, (ns + 1) * sizeof(*first));
+  for (size_t i = 0; i < rs; i++) {
+    if (r[i].unit == 0xFF)
+      for (size_t k = 0; k < ns; k++) first[k + 1]++;
+    else if (net[r[i].unit] < ns)
+      first[net[r[i].unit] + 1]++;
+  }
+  for (size_t k = 0; k < ns; k++) first[k + 1] += first[k];
+  const size_t n = first[ns];
+  if (n > os) return n;
+  for (size_t i = 0; i < rs; i++) {
+    if (r[i].unit == 0xFF)
+      for (size_t k = 0; k < ns; k++) out[first[k]++] = r[i];
+    else if (net[r[i].unit] < ns)
+      out[first[net[r[i].unit]]++] = r[i];
+  }
+  // each network's count was advanced past its end, shift them back
+  for (size_t k = ns; k > 0; k--) first[k] = first[k - 1];
+  first[0] = 0;
+  return n;
+}
+
+#define LOR_HIST_SUB (1 << LOR_HIST_SUB_BITS)
+
+void lor_hist_add(lor_hist_s* h, const unsigned long long ns) {
+  int i = (int) ns;
+  if (ns >= LOR_HIST_SUB) {
+    // the power of two range selects the bucket group, the bits following
+    // the leading one select the linear sub-bucket within it
+    const int e = 63 - __builtin_clzll(ns);
+    i = (e - LOR_HIST_SUB_BITS + 1) * LOR_HIST_SUB +
+        (int) (ns >> (e - LOR_HIST_SUB_BITS) & (LOR_HIST_SUB - 1));
+    if (i >= LOR_HIST_BUCKETS) i = LOR_HIST_BUCKETS - 1;
+  }
+  h->count[i]++;
+  h->n++;
+  if (ns > h->max) h->max = ns;
+}
+
+/// @brief Returns the last duration counted by a histogram bucket.
+/// @param i The bucket index.
+/// @return The duration in nanoseconds.
+static unsigned long long lor_hist_end(const int i) {
+  if (i < LOR_HIST_SUB) return (unsigned long long) i;
+  // the start of the next bucket, shifted into the bucket's power of two
+  const unsigned long long next = LOR_HIST_SUB + i % LOR_HIST_SUB + 1;
+  return (next << (i / LOR_HIST_SUB - 1)) - 1;
+}
+
+unsigned long long lor_hist_percentile(const lor_hist_s* h,
+                                       const unsigned pct) {
+  if (!h->n) return 0;
+  // the number of durations at or below the percentile, rounded up
+  const unsigned long long k =
+          ((unsigned long long) h->n * (pct < 100 ? pct : 100) + 99) / 100;
+  unsigned long long seen = 0;
+  for (int i = 0; i < LOR_HIST_BUCKETS - 1; i++) {
+    seen += h->count[i];
+    if (seen >= k) {
+      const unsigned long long end = lor_hist_end(i);
+      return end < h->max ? end : h->max;
+    }
+  }
+  return h->max;
+}
+
+int lor_clock_init(lor_clock_s* c, const unsigned long long now,
+                   const unsigned long long period) {
+  if (!period) return -1;
+  *c = (lor_clock_s){.period = period, .next = now, .start = now};
+  return 0;
+}
+
+long lor_clock_tick(lor_clock_s* c, const unsigned long long now) {
+  if (now < c->next) return -1;
+  const unsigned long long late = now - c->next;
+  const unsigned long long skipped = late / c->period;
+  lor_hist_add(&c->jitter, late);
+  c->next += (skipped + 1) * c->period;
+  c->start = now;
+  c->ticks++;
+  c->missed += (unsigned long) skipped;
+  return (long) skipped;
+}
+
+void lor_clock_done(lor_clock_s* c, const unsigned long long now) {
+  lor_hist_add(&c->encode, now > c->start ? now - c->start : 0);
+}
+
+#ifdef TINYLOR_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#endif
+
+/// @brief Converts a baud rate to its termios speed constant.
+/// @param baud The baud rate.
+/// @param speed Set to the termios speed constant.
+/// @return 0 on success, -1 if the baud rate is not supported.
+static int lor_serial_speed(const unsigned long baud, speed_t* const speed) {
+  switch (baud) {
+    case 9600:
+      *speed = B9600;
+      return 0;
+    case 19200:
+      *speed = B19200;
+      return 0;
+    case 38400:
+      *speed = B38400;
+      return 0;
+    case 57600:
+      *speed = B57600;
+      return 0;
+    case 115200:
+      *speed = B115200;
+      return 0;
+#ifdef B230400
+    case 230400:
+      *speed = B230400;
+      return 0;
+#endif
+#ifdef B460800
+    case 460800:
+      *speed = B460800;
+      return 0;
+#endif
+#ifdef B500000
+    case 500000:
+      *speed = B500000;
+      return 0;
+#endif
+    default:
+      return -1;
+  }
+}
+
+int lor_serial_configure(const int fd, const unsigned long baud) {
+  speed_t speed;
+  if (lor_serial_speed(baud, &speed)) {
+    errno = EINVAL;
+    return -1;
+  }
+  struct termios t;
+  if (tcgetattr(fd, &t)) return -1;
+  t.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL |
+                 IXON | IXOFF | IXANY);
+  t.c_oflag &= ~OPOST;
+  t.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  t.c_cflag &= ~(CSIZE | PARENB | CSTOPB);
+  t.c_cflag |= CS8 | CLOCAL | CREAD;
+  // hardware flow control would block writes to adapters without RTS/CTS
+#ifdef CRTSCTS
+  t.c_cflag &= ~CRTSCTS;
+#endif
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  if (cfsetispeed(&t, speed) || cfsetospeed(&t, speed)) return -1;
+  if (tcsetattr(fd, TCSANOW, &t)) return -1;
+  const int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK)) return -1;
+#ifdef __linux__
+  // best effort, not all drivers (or pseudo terminals) support low latency
+  struct serial_struct ss;
+  if (!ioctl(fd, TIOCGSERIAL, &ss)) {
+    ss.flags |= ASYNC_LOW_LATENCY;
+    ioctl(fd, TIOCSSERIAL, &ss);
+  }
+#endif
+  return 0;
+}
+
+int lor_serial_open(const char* path, const unsigned long baud) {
+  const int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) return -1;
+  if (lor_serial_configure(fd, baud)) {
+    const int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+long lor_serial_send(const int fd, struct iovec* iov, int iovcnt,
+                     const int timeout_ms) {
+  long h = 0;
+  for (;;) {
+    while (iovcnt > 0 && !iov->iov_len) iov++, iovcnt--;
+    if (!iovcnt) return h;
+    const ssize_t w = writev(fd, iov, iovcnt);
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+      // wait for the port to drain before retrying
+      struct pollfd p = {.fd = fd, .events = POLLOUT};
+      const int ready = poll(&p, 1, timeout_ms);
+      if (ready < 0 && errno != EINTR) return -1;
+      if (!ready) return h;
+      continue;
+    }
+    h += w;
+    for (size_t n = (size_t) w; n > 0; iov++, iovcnt--) {
+      if (n < iov->iov_len) {
+        iov->iov_base = (unsigned char*) iov->iov_base + n;
+        iov->iov_len -= n;
+        break;
+      }
+      n -= iov->iov_len;
+      iov->iov_len = 0;
+    }
+  }
+}
+
+long lor_serial_write(const int fd, unsigned char* b, const size_t bs,
+                      const lor_req_s* r, const size_t rs,
+                      const int timeout_ms) {
+  const size_t n = lor_write_size(r, rs);
+  if (n > bs) {
+    errno = ENOBUFS;
+    return -1;
+  }
+  struct iovec iov = {.iov_base = b, .iov_len = lor_write(b, bs, r, rs)};
+  return lor_serial_send(fd, &iov, 1, timeout_ms);
+}
+
+unsigned long long lor_clock_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL +
+         (unsigned long long) ts.tv_nsec;
+}
+
+long lor_clock_wait(lor_clock_s* c) {
+  const struct timespec ts = {(time_t) (c->next / 1000000000ULL),
+                              (long) (c->next % 1000000000ULL)};
+  int err;
+  while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) ==
+         EINTR)
+    continue;
+  if (err) return -1;
+  return lor_clock_tick(c, lor_clock_now());
+}
+
+int lor_show_map(lor_show_s* s, const char* path) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  struct stat st;
+  void* m = MAP_FAILED;
+  if (!fstat(fd, &st)) {
+    if (st.st_size > 0)
+      m = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    else
+      errno = EINVAL;
+  }
+  close(fd);
+  if (m == MAP_FAILED) return -1;
+  if (lor_show_open(s, m, (size_t) st.st_size)) {
+    munmap(m, (size_t) st.st_size);
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+void lor_show_unmap(lor_show_s* s) {
+  munmap((void*) s->b, s->bs);
+}
+
+long lor_show_play(const int fd, const lor_show_s* s, unsigned long i) {
+  lor_clock_s c;
+  const unsigned long long now = lor_clock_now();
+  if (lor_clock_init(&c, now, s->period_ms * 1000000ULL)) {
+    errno = EINVAL;
+    return -1;
+  }
+  unsigned char* const heartbeat = LOR_HEARTBEAT_BYTES;
+  unsigned long long next_heartbeat = now;
+  long skipped = 0;
+  while (i < s->frames) {
+    const long k = lor_clock_wait(&c);
+    if (k < 0) return -1;
+    skipped += k;
+    if ((i += (unsigned long) k) >= s->frames) break;
+    struct iovec iov[2];
+    int iovcnt = 0;
+    if (c.start >= next_heartbeat) {
+      iov[iovcnt++] = (struct iovec){heartbeat, LOR_HEARTBEAT_SIZE};
+      next_heartbeat = c.start + LOR_HEARTBEAT_DELAY_NS;
+    }
+    size_t n;
+    const unsigned char* const f = lor_show_frame(s, i++, &n);
+    if (n) iov[iovcnt++] = (struct iovec){(void*) f, n};
+    if (iovcnt && lor_serial_send(fd, iov, iovcnt, -1) < 0) return -1;
+    lor_clock_done(&c, lor_clock_now());
+  }
+  return skipped;
+}
+
+#ifdef TINYLOR_THREADS
+/// @brief Wakes every thread waiting on a network.
+static void lor_net_signal(lor_net_s* n) {
+  pthread_mutex_lock(&n->lock);
+  pthread_cond_broadcast(&n->cond);
+  pthread_mutex_unlock(&n->lock);
+}
+
+/// @brief Encodes each submitted frame into the ring of a network, waiting for
+///        the writer to release space whenever the ring is full.
+/// @param arg The network.
+/// @return NULL.
+static void* lor_net_encoder(void* arg) {
+  lor_net_s* const n = arg;
+  pthread_mutex_lock(&n->lock);
+  for (;;) {
+    while (!n->pending && !n->stop) pthread_cond_wait(&n->cond, &n->lock);
+    if (!n->pending) break;
+    pthread_mutex_unlock(&n->lock);
+    for (size_t i = 0; i < n->rs;) {
+      const size_t tail = __atomic_load_n(&n->ring.tail, __ATOMIC_ACQUIRE);
+      const size_t w = lor_ring_write(&n->ring, &n->r[i], n->rs - i);
+      i += w;
+      pthread_mutex_lock(&n->lock);
+      if (w) pthread_cond_broadcast(&n->cond);
+      // the ring is full, wait for the writer to release bytes
+      else
+        while (__atomic_load_n(&n->ring.tail, __ATOMIC_ACQUIRE) == tail)
+          pthread_cond_wait(&n->cond, &n->lock);
+      pthread_mutex_unlock(&n->lock);
+    }
+    pthread_mutex_lock(&n->lock);
+    n->pending = 0;
+    pthread_cond_broadcast(&n->cond);
+  }
+  pthread_mutex_unlock(&n->lock);
+  return NULL;
+}
+
+/// @brief Writes the bytes published to the ring of a network to its port
+///        until stopped. After a failed write, bytes are released unwritten so
+///        the encoder never blocks.
+/// @param arg The network.
+/// @return NULL.
+static void* lor_net_writer(void* arg) {
+  lor_net_s* const n = arg;
+  for (;;) {
+    const unsigned char* p;
+    size_t len;
+    int err;
+    pthread_mutex_lock(&n->lock);
+    // stop is set once every frame is published, so it is read first
+    for (;;) {
+      const int stop = n->stop;
+      p = lor_ring_read(&n->ring, &len);
+      if (len || stop) break;
+      pthread_cond_wait(&n->cond, &n->lock);
+    }
+    err = n->err;
+    pthread_mutex_unlock(&n->lock);
+    if (!len) break;
+    struct iovec iov = {.iov_base = (void*) p, .iov_len = len};
+    if (!err && lor_serial_send(n->fd, &iov, 1, -1) < 0) {
+      pthread_mutex_lock(&n->lock);
+      n->err = errno;
+      pthread_mutex_unlock(&n->lock);
+    }
+    lor_ring_release(&n->ring, len);
+    lor_net_signal(n);
+  }
+  return NULL;
+}
+
+int lor_net_start(lor_net_s* n, const int fd, unsigned char* b,
+                  const size_t bs) {
+  if (bs < LOR_REQ_MAX_SIZE || lor_ring_init(&n->ring, b, bs)) return -1;
+  n->fd = fd;
+  n->r = NULL;
+  n->rs = 0;
+  n->pending = n->stop = n->err = 0;
+  if (pthread_mutex_init(&n->lock, NULL)) return -1;
+  if (!pthread_cond_init(&n->cond, NULL)) {
+    if (!pthread_create(&n->encoder, NULL, lor_net_encoder, n)) {
+      if (!pthread_create(&n->writer, NULL, lor_net_writer, n)) return 0;
+      // stop the encoder, which is waiting for a frame
+      pthread_mutex_lock(&n->lock);
+      n->stop = 1;
+      pthread_cond_broadcast(&n->cond);
+      pthread_mutex_unlock(&n->lock);
+      pthread_join(n->encoder, NULL);
+    }
+    pthread_cond_destroy(&n->cond);
+  }
+  pthread_mutex_destroy(&n->lock);
+  return -1;
+}
+
+int lor_net_submit(lor_net_s* n, const lor_req_s* r, const size_t rs) {
+  pthread_mutex_lock(&n->lock);
+  while (n->pending) pthread_cond_wait(&n->cond, &n->lock);
+  const int err = n->err;
+  if (!err) {
+    n->r = r;
+    n->rs = rs;
+    n->pending = 1;
+    pthread_cond_broadcast(&n->cond);
+  }
+  pthread_mutex_unlock(&n->lock);
+  return err ? -1 : 0;
+}
+
+void lor_net_sync(lor_net_s* n) {
+  pthread_mutex_lock(&n->lock);
+  while (n->pending) pthread_cond_wait(&n->cond, &n->lock);
+  pthread_mutex_unlock(&n->lock);
+}
+
+int lor_net_stop(lor_net_s* n) {
+  pthread_mutex_lock(&n->lock);
+  while (n->pending) pthread_cond_wait(&n->cond, &n->lock);
+  n->stop = 1;
+  pthread_cond_broadcast(&n->cond);
+  pthread_mutex_unlock(&n->lock);
+  pthread_join(n->encoder, NULL);
+  pthread_join(n->writer, NULL);
+  pthread_cond_destroy(&n->cond);
+  pthread_mutex_destroy(&n->lock);
+  if (!n->err) return 0;
+  errno = n->err;
+  return -1;
+}
+#endif// TINYLOR_THREADS
+
+#endif// TINYLOR_POSIX
@@ -5,6 +5,13 @@
 
 #include <stddef.h>
 
+#ifdef TINYLOR_POSIX
+#include <sys/uio.h>
+#ifdef TINYLOR_THREADS
+#include <pthread.h>
+#endif
+#endif
+
 /// @typedef lor_channel
 /// @brief Represents a channel number, which is a unique identifier for a
 ///        specific light or group of lights. Channels are typically in the
@@ -123,6 +130,135 @@ typedef union lor_effect_data {
 /// @brief The intended delay in nanoseconds between sending LOR heartbeats.
 #define LOR_HEARTBEAT_DELAY_NS 500000000
 
+/// @def LOR_REQ_MAX_SIZE
+/// @brief The maximum number of bytes a single request encodes to.
+#define LOR_REQ_MAX_SIZE 11
+
+/// @def LOR_CSET_FORMAT
+/// @brief Constant expression equivalent of the channel set format selected
+///        when encoding a channel set of offset \p off and bitset \p cbits.
+#define LOR_CSET_FORMAT(off, cbits)                                            \
+  ((off)                               ? LOR_FMT_MULTIPART                     \
+   : !(cbits)                          ? LOR_FMT_UNIT                          \
+   : !((cbits) & ((cbits) - 1))        ? LOR_FMT_SINGLE                        \
+   : ((cbits) & 0xFF) && (cbits) >> 8  ? LOR_FMT_16                            \
+   : ((cbits) & 0xFF)                  ? LOR_FMT_8L                            \
+                                       : LOR_FMT_8H)
+
+/// @def LOR_BYTES_CHECK_
+/// @brief Evaluates to zero if \p cond is true, otherwise fails to compile.
+#define LOR_BYTES_CHECK_(cond) (0 * sizeof(char[(cond) ? 1 : -1]))
+
+/// @def LOR_BYTES_HEAD
+/// @brief Compile-time encoding of a request header. Compile-time encoded
+///        requests are written as the concatenation of LOR_BYTES_HEAD, the
+///        effect arguments (if any, e.g. LOR_BYTES_FADE), the channel set
+///        (one of the LOR_BYTES_CSET_* macros) and LOR_BYTES_END, producing
+///        the same bytes as lor_write. All arguments must be constants.
+/// @note The channel set is given to both LOR_BYTES_HEAD and
+///       LOR_BYTES_CSET_*, which must agree. Prefer LOR_BYTES_REQ and
+///       LOR_BYTES_REQ_ARGS, which take the channel set once.
+#define LOR_BYTES_HEAD(unit, effect, off, cbits)                               \
+  0, (unit), (effect) | LOR_CSET_FORMAT(off, cbits)
+
+/// @def LOR_BYTES_INTENSITY
+/// @brief Compile-time encoding of LOR_SET_INTENSITY effect arguments.
+#define LOR_BYTES_INTENSITY(i) (i)
+
+/// @def LOR_BYTES_DECIS
+/// @brief Compile-time encoding of a decisecond duration.
+#define LOR_BYTES_DECIS(ds)                                                    \
+  ((ds) >> 8) | (!((ds) >> 8) ? 0x80 : !((ds) & 0xFF) ? 0x40 : 0),           \
+          ((ds) & 0xFF ? (ds) & 0xFF : 1)
+
+/// @def LOR_BYTES_FADE
+/// @brief Compile-time encoding of LOR_FADE effect arguments.
+#define LOR_BYTES_FADE(start, end, ds) (start), (end), LOR_BYTES_DECIS(ds)
+
+/// @def LOR_BYTES_PULSE
+/// @brief Compile-time encoding of LOR_PULSE effect arguments.
+#define LOR_BYTES_PULSE(ds) ((ds) & 0xFF)
+
+/// @def LOR_BYTES_DMX_INTENSITY
+/// @brief Compile-time encoding of LOR_SET_DMX_INTENSITY effect arguments.
+#define LOR_BYTES_DMX_INTENSITY(output) (output)
+
+/// @def LOR_BYTES_CSET_UNIT
+/// @brief Compile-time encoding of a unit-wide channel set (no channels).
+#define LOR_BYTES_CSET_UNIT 0
+
+/// @def LOR_BYTES_CSET_16
+/// @brief Compile-time encoding of a channel set using both bytes of its
+///        bitset. Fails to compile if either byte of \p cbits is zero.
+#define LOR_BYTES_CSET_16(off, cbits)                                          \
+  (off) + LOR_BYTES_CHECK_(((cbits) & 0xFF) && ((cbits) >> 8 & 0xFF)),         \
+          (cbits) & 0xFF, (cbits) >> 8 & 0xFF
+
+/// @def LOR_BYTES_CSET_LOW
+/// @brief Compile-time encoding of a channel set using only the low byte of
+///        its bitset. Fails to compile if the bitset does not match.
+#define LOR_BYTES_CSET_LOW(off, cbits)                                         \
+  ((off) | ((off) ? 0x80 : 0)) +                                               \
+          LOR_BYTES_CHECK_(((cbits) & 0xFF) && !((cbits) >> 8 & 0xFF)),        \
+          (cbits) & 0xFF
+
+/// @def LOR_BYTES_CSET_HIGH
+/// @brief Compile-time encoding of a channel set using only the high byte of
+///        its bitset. Fails to compile if the bitset does not match.
+#define LOR_BYTES_CSET_HIGH(off, cbits)                                        \
+  ((off) | ((off) ? 0x40 : 0)) +                                               \
+          LOR_BYTES_CHECK_(!((cbits) & 0xFF) && ((cbits) >> 8 & 0xFF)),        \
+          (cbits) >> 8 & 0xFF
+
+/// @def LOR_BYTES_CSET_WIDE
+/// @brief Compile-time encoding of a unit-wide channel set with a non-zero
+///        offset (no channels). Fails to compile if \p off is zero.
+#define LOR_BYTES_CSET_WIDE(off)                                               \
+  ((off) | 0x40) + LOR_BYTES_CHECK_((off) && (off) < 64)
+
+/// @def LOR_BYTES_END
+/// @brief Compile-time encoding of the end of a request.
+#define LOR_BYTES_END 0
+
+// The channel set shapes of LOR_BYTES_REQ, each checking the channel set.
+#define LOR_BYTES_SHAPE_16_(off, cbits)                                        \
+  LOR_BYTES_CSET_16((off) + LOR_BYTES_CHECK_((off) < 64), cbits)
+#define LOR_BYTES_SHAPE_LOW_(off, cbits)                                       \
+  LOR_BYTES_CSET_LOW((off) + LOR_BYTES_CHECK_((off) < 64), cbits)
+#define LOR_BYTES_SHAPE_HIGH_(off, cbits)                                      \
+  LOR_BYTES_CSET_HIGH((off) + LOR_BYTES_CHECK_((off) < 64), cbits)
+#define LOR_BYTES_SHAPE_UNIT_(off, cbits)                                      \
+  LOR_BYTES_CSET_UNIT + LOR_BYTES_CHECK_(!(off) && !(cbits))
+#define LOR_BYTES_SHAPE_WIDE_(off, cbits)                                      \
+  LOR_BYTES_CSET_WIDE(off) + LOR_BYTES_CHECK_(!(cbits))
+
+/// @def LOR_BYTES_REQ
+/// @brief Compile-time encoding of an entire request for an effect without
+///        arguments, producing the same bytes as lor_write. \p shape is the
+///        encoded shape of the channel set, one of 16 (both bitset bytes), LOW
+///        (low byte only), HIGH (high byte only), UNIT (unit-wide, offset 0)
+///        or WIDE (unit-wide, non-zero offset), and fails to compile if it
+///        does not match \p off and \p cbits. All arguments must be constants.
+/// @code
+/// static const unsigned char unit_3_bank_0_off[] = {
+///         LOR_BYTES_REQ(16, 3, LOR_SET_OFF, 0, 0xFFFF)};
+/// @endcode
+#define LOR_BYTES_REQ(shape, unit, effect, off, cbits)                         \
+  LOR_BYTES_HEAD(unit, effect, off, cbits),                                    \
+          LOR_BYTES_SHAPE_##shape##_(off, cbits), LOR_BYTES_END
+
+/// @def LOR_BYTES_REQ_ARGS
+/// @brief Compile-time encoding of an entire request for an effect with
+///        arguments, given as the trailing arguments (e.g. LOR_BYTES_FADE).
+///        See LOR_BYTES_REQ.
+/// @code
+/// static const unsigned char unit_1_fade_in[] = {LOR_BYTES_REQ_ARGS(
+///         LOW, 1, LOR_FADE, 0, 0x00FF, LOR_BYTES_FADE(1, 240, 10))};
+/// @endcode
+#define LOR_BYTES_REQ_ARGS(shape, unit, effect, off, cbits, ...)               \
+  LOR_BYTES_HEAD(unit, effect, off, cbits), __VA_ARGS__,                       \
+          LOR_BYTES_SHAPE_##shape##_(off, cbits), LOR_BYTES_END
+
 /// @struct lor_req
 /// @brief Represents a request to apply an effect to a set of channels on a
 ///        specific unit. The effect may require additional arguments, which are
@@ -198,17 +334,234 @@ void lor_set_intensity(lor_req_s* req, lor_intensity i);
 void lor_set_fade(lor_req_s* req, lor_intensity start, lor_intensity end,
                   lor_decisec ds);
 
+/// @brief Returns the exact number of bytes a request encodes to, without
+///        encoding the request.
+/// @param req The request to measure.
+/// @return The encoded size of the request in bytes.
+size_t lor_req_size(const lor_req_s* req);
+
+/// @brief Returns the exact number of bytes \p rs requests encode to, without
+///        encoding the requests. A buffer of this size is guaranteed to hold
+///        every request when passed to lor_write.
+/// @param r The requests to measure.
+/// @param rs The number of requests in \p r.
+/// @return The total encoded size of the requests in bytes.
+size_t lor_write_size(const lor_req_s* r, size_t rs);
+
 /// @brief Encodes and writes up to \p rs requests to the provided buffer \p b
-///        as binary data. Requests are first encoded into a scratch buffer to
-///        ensure the buffer has enough space to hold the encoded data. The
-///        function will attempt to write as many requests as possible to the
-///        buffer, up to the provided request count.
+///        as binary data. The encoded size of each request is checked against
+///        the remaining buffer space before the request is encoded directly
+///        into the buffer. The function will attempt to write as many requests
+///        as possible to the buffer, up to the provided request count.
 /// @return If all requests were written, the number of bytes written to the
 ///         buffer is returned. If the buffer is too small to hold all requests,
 ///         the number of bytes required to hold at least one additional request
-///         is returned.
+///         is returned. See lor_encoder_write for resumable encoding.
 size_t lor_write(unsigned char* b, size_t bs, const lor_req_s* r, size_t rs);
 
+/// @struct lor_encoder
+/// @brief Represents the progress of encoding a list of requests across
+///        multiple, potentially small, output buffers. Unlike lor_write, a
+///        request which does not fit in the remaining buffer space is split
+///        and resumed by the next call to \p lor_encoder_write.
+typedef struct lor_encoder {
+  /// @brief The requests being encoded.
+  const lor_req_s* r;
+  /// @brief The number of requests in \p r.
+  size_t rs;
+  /// @brief The number of requests fully written.
+  size_t consumed;
+  /// @brief The number of bytes written.
+  size_t produced;
+  /// @brief The number of bytes remaining to be written.
+  size_t pending;
+  /// @brief The encoded request currently split across output buffers.
+  unsigned char partial[LOR_REQ_MAX_SIZE];
+  /// @brief The number of bytes of \p partial already written.
+  unsigned char partial_off;
+  /// @brief The encoded size of \p partial, or zero if no request is split.
+  unsigned char partial_size;
+} lor_encoder_s;
+
+/// @brief Initializes an encoder to encode \p rs requests from \p r. The
+///        requests must remain valid and unmodified until fully encoded.
+/// @param enc The encoder to initialize.
+/// @param r The requests to encode.
+/// @param rs The number of requests in \p r.
+void lor_encoder_init(lor_encoder_s* enc, const lor_req_s* r, size_t rs);
+
+/// @brief Encodes and writes up to \p bs bytes of the remaining requests to
+///        \p b, filling the buffer completely unless no requests remain. The
+///        encoder's consumed, produced and pending counts are updated.
+/// @param enc The encoder to continue.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @return The number of bytes written to the buffer, zero once the pending
+///         count reaches zero.
+size_t lor_encoder_write(lor_encoder_s* enc, unsigned char* b, size_t bs);
+
+/// @struct lor_chunk
+/// @brief Represents a contiguous range of requests and the range of bytes
+///        it encodes to within the encoding of all requests. Splitting a
+///        large list of requests into chunks allows each chunk to be measured
+///        and encoded independently (e.g. by a thread pool), with output
+///        identical to lor_write:
+///        1. lor_chunk_split, then lor_chunk_measure for each chunk,
+///        2. lor_chunk_offsets, once every chunk is measured,
+///        3. lor_chunk_write for each chunk, into one shared buffer.
+/// @note Chunks share no state, so measuring or writing different chunks
+///       concurrently is safe (except for statistics if TINYLOR_STATS is
+///       defined).
+typedef struct lor_chunk {
+  /// @brief The index of the first request of the chunk.
+  size_t first;
+  /// @brief The number of requests in the chunk.
+  size_t count;
+  /// @brief The offset of the chunk's encoded bytes in the output buffer.
+  size_t offset;
+  /// @brief The encoded size of the chunk in bytes.
+  size_t size;
+} lor_chunk_s;
+
+/// @brief Splits \p rs requests into \p cs chunks of (nearly) equal request
+///        counts. Chunks beyond the number of requests are empty.
+/// @param c The chunks to initialize.
+/// @param cs The number of chunks in \p c.
+/// @param rs The number of requests to split.
+void lor_chunk_split(lor_chunk_s* c, size_t cs, size_t rs);
+
+/// @brief Measures the encoded size of a chunk's requests.
+/// @param c The chunk to measure.
+/// @param r The requests the chunk was split from.
+void lor_chunk_measure(lor_chunk_s* c, const lor_req_s* r);
+
+/// @brief Sets the output offset of each measured chunk, the prefix sum of
+///        the sizes of the chunks before it.
+/// @param c The chunks, in request order.
+/// @param cs The number of chunks in \p c.
+/// @return The total encoded size of every chunk in bytes.
+size_t lor_chunk_offsets(lor_chunk_s* c, size_t cs);
+
+/// @brief Encodes a chunk's requests into its range of the output buffer.
+/// @param b The output buffer shared by every chunk, at least the total size
+///          returned by lor_chunk_offsets.
+/// @param c The chunk to encode.
+/// @param r The requests the chunk was split from.
+/// @return The number of bytes written, the chunk's size.
+size_t lor_chunk_write(unsigned char* b, const lor_chunk_s* c,
+                       const lor_req_s* r);
+
+/// @struct lor_req_batch
+/// @brief Represents a batch of requests stored as parallel arrays (one array
+///        per field) rather than an array of lor_req_s. Each field is read
+///        sequentially when encoding, so large batches are classified and
+///        measured without branching per request. Storage is provided by the
+///        caller, every array must hold at least \p cap elements (\p args
+///        holds 4 bytes per request).
+typedef struct lor_req_batch {
+  /// @brief The unit of each request.
+  lor_unit* unit;
+  /// @brief The effect of each request, a lor_effect value.
+  unsigned char* effect;
+  /// @brief The channel set offset of each request.
+  unsigned char* offset;
+  /// @brief The channel set bitset of each request.
+  unsigned short* cbits;
+  /// @brief The encoded effect arguments of each request, 4 bytes per request
+  ///        of which only the effect's argument size is used.
+  unsigned char* args;
+  /// @brief The number of requests in the batch.
+  size_t n;
+  /// @brief The maximum number of requests the batch can hold.
+  size_t cap;
+} lor_req_batch_s;
+
+/// @brief Initializes an empty batch using the provided field arrays.
+/// @param batch The batch to initialize.
+/// @param unit The unit array.
+/// @param effect The effect array.
+/// @param offset The channel set offset array.
+/// @param cbits The channel set bitset array.
+/// @param args The effect argument array, 4 bytes per request.
+/// @param cap The number of requests each array can hold.
+void lor_batch_init(lor_req_batch_s* batch, lor_unit* unit,
+                    unsigned char* effect, unsigned char* offset,
+                    unsigned short* cbits, unsigned char* args, size_t cap);
+
+/// @brief Appends a copy of a request to the batch.
+/// @param batch The batch to append to.
+/// @param req The request to append.
+/// @return 0 on success, -1 if the batch is full or the effect is invalid.
+int lor_batch_add(lor_req_batch_s* batch, const lor_req_s* req);
+
+/// @brief Returns the exact number of bytes the batch encodes to, the batch
+///        equivalent of lor_write_size.
+/// @param batch The batch to measure.
+/// @return The total encoded size of the batch in bytes.
+size_t lor_batch_size(const lor_req_batch_s* batch);
+
+/// @brief Encodes and writes the batch to the provided buffer \p b, producing
+///        the same bytes as lor_write does for the equivalent lor_req_s array.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @param batch The batch to encode.
+/// @return The same as lor_write: the number of bytes written if the batch
+///         was fully written, otherwise the encoded size of the first request
+///         which did not fit.
+size_t lor_batch_write(unsigned char* b, size_t bs,
+                       const lor_req_batch_s* batch);
+
+/// @brief Decodes up to \p rs requests from the binary data in \p b, the
+///        inverse of lor_write. Heartbeat messages are skipped. Bytes which do
+///        not form a valid request are skipped until the next possible start
+///        of a request. Decoding stops early at an incomplete request at the
+///        end of the buffer, which may be completed by appending more data.
+/// @note A single channel set (\p LOR_FMT_SINGLE) does not encode which half
+///       of the 16-bit bitset the channel was in, and is always decoded into
+///       the low byte. Re-encoding the decoded request produces the same bytes.
+/// @param b The buffer to read from.
+/// @param bs The size of the buffer.
+/// @param r The request buffer to decode into.
+/// @param rs The maximum number of requests to decode.
+/// @param n Optional, set to the number of requests decoded into \p r.
+/// @return The number of bytes consumed from \p b.
+size_t lor_read(const unsigned char* b, size_t bs, lor_req_s* r, size_t rs,
+                size_t* n);
+
+/// @brief Merges requests sharing the same unit, effect, effect arguments and
+///        16-channel boundary into a single request using the combined channel
+///        set, compacting \p r in place. A request is only merged into an
+///        earlier request if no request between the two applies to any of the
+///        same channels, so the result applies the same final state as the
+///        original sequence. Unit-wide requests (an empty bitset) are never
+///        merged.
+/// @note Each request is compared against prior requests until a match or
+///       conflicting request is found, worst case O(n^2) comparisons.
+/// @param r The requests to coalesce.
+/// @param rs The number of requests in \p r.
+/// @return The number of requests remaining in \p r.
+size_t lor_coalesce(lor_req_s* r, size_t rs);
+
+/// @brief Folds requests applying the same effect to the same channel set of
+///        every unit of a network into a single broadcast (unit 0xFF) request,
+///        followed by requests for the units whose effect differs. A channel
+///        set is only folded if every unit of \p units has exactly one request
+///        for it, no other request applies to any of its channels, and at
+///        least two units share the most common effect.
+/// @note Requests are bucketed by channel set with a sort, O(n log n), plus
+///       O(m * d) per bucket of m requests using d distinct effects to find
+///       the most common effect.
+/// @param r The requests to fold.
+/// @param rs The number of requests in \p r.
+/// @param units The units of the network, every unit a broadcast reaches.
+/// @param us The number of units in \p units.
+/// @param tmp Scratch storage of at least \p rs elements.
+/// @param out The request buffer to write to, at least \p rs requests in size
+///            and not overlapping \p r.
+/// @return The number of requests written to \p out.
+size_t lor_fold_broadcast(const lor_req_s* r, size_t rs, const lor_unit* units,
+                          size_t us, size_t* tmp, lor_req_s* out);
+
 /// @typedef lor_intensity_fn
 /// @brief Represents a function that converts an arbitrary byte value to a
 ///        a scaled intensity value used by the LOR protocol.
@@ -223,4 +576,1026 @@ typedef lor_intensity (*lor_intensity_fn)(unsigned char b);
 /// @return The scaled intensity value.
 lor_intensity lor_get_intensity(unsigned char b);
 
+/// @brief Encodes a [0,0xFF] value into a LOR intensity value using a gamma 2.2
+///        curve, approximating the perceived brightness of incandescent and
+///        most LED lights.
+/// @note This is a table driven implementation of the lor_intensity_fn type.
+/// @param b The byte value to convert.
+/// @return The scaled intensity value.
+lor_intensity lor_get_intensity_gamma(unsigned char b);
+
+/// @brief Encodes a [0,0xFF] value into a LOR intensity value using the CIE
+///        1931 lightness curve, so that equal steps in \p b appear as equal
+///        steps in perceived brightness.
+/// @note This is a table driven implementation of the lor_intensity_fn type.
+/// @param b The byte value to convert.
+/// @return The scaled intensity value.
+lor_intensity lor_get_intensity_cie(unsigned char b);
+
+/// @brief Converts \p n byte values from \p src (e.g. a DMX universe) into
+///        LOR intensity values written to \p dst. The built-in conversion
+///        functions are applied directly from their lookup tables. Custom
+///        functions are tabulated once per call when converting more than 256
+///        values, otherwise called once per value.
+/// @param dst The buffer to write \p n intensity values to.
+/// @param src The byte values to convert.
+/// @param n The number of values to convert.
+/// @param fn The conversion function to apply, or NULL for lor_get_intensity.
+void lor_get_intensities(lor_intensity* dst, const unsigned char* src,
+                         size_t n, lor_intensity_fn fn);
+
+/// @struct lor_dirty
+/// @brief Represents the set of changed channels of every unit, as a bitmap of
+///        64 banks of 16 channels per unit (the lor_channel_set geometry)
+///        summarized by one bit per non-empty bank and one bit per unit with
+///        a non-empty bank. Iterating the changed channels costs time in
+///        proportion to the number of changed banks, not the number of units
+///        or channels.
+typedef struct lor_dirty {
+  /// @brief The bit set of units with at least one changed bank.
+  unsigned long long units[4];
+  /// @brief The bit set of changed banks, per unit.
+  unsigned long long banks[256];
+  /// @brief The bit set of changed channels, per unit and bank.
+  unsigned short cbits[256][64];
+} lor_dirty_s;
+
+/// @brief Clears every changed channel.
+/// @param d The bitmap to clear.
+void lor_dirty_init(lor_dirty_s* d);
+
+/// @brief Marks a channel as changed.
+/// @param d The bitmap to modify.
+/// @param u The unit of the channel.
+/// @param c The channel number, relative to the unit, less than 1024.
+void lor_dirty_mark(lor_dirty_s* d, lor_unit u, lor_channel c);
+
+/// @brief Marks every channel of a channel set as changed.
+/// @param d The bitmap to modify.
+/// @param u The unit of the channels.
+/// @param cset The channels to mark.
+void lor_dirty_mark_set(lor_dirty_s* d, lor_unit u,
+                        const lor_channel_set* cset);
+
+/// @brief Removes the lowest changed bank (ordered by unit, then offset) from
+///        the bitmap and returns its changed channels.
+/// @param d The bitmap to iterate.
+/// @param u The unit of the changed channels.
+/// @param cset The changed channels.
+/// @return Non-zero if a bank was returned, zero if no channels are changed.
+int lor_dirty_next(lor_dirty_s* d, lor_unit* u, lor_channel_set* cset);
+
+/// @struct lor_frame
+/// @brief Represents the intensity state of a contiguous range of units and
+///        channels, double buffered as the current (pending) state and the
+///        previous (sent) state. Changes between the two are converted into
+///        the minimal set of requests by \p lor_frame_diff.
+/// @note The frame does not own its storage. The caller provides a buffer of
+///       at least 2 * units * channels bytes via \p lor_frame_init.
+typedef struct lor_frame {
+  /// @brief The current intensity of each channel, indexed by unit then
+  ///        channel. A value of zero indicates the channel has not been set.
+  lor_intensity* cur;
+  /// @brief The last intensity of each channel returned by lor_frame_diff.
+  lor_intensity* prev;
+  /// @brief The intensity conversion function applied by lor_frame_set.
+  lor_intensity_fn fn;
+  /// @brief The number of channels per unit, in the range of [1, 1024].
+  lor_channel channels;
+  /// @brief The first unit covered by the frame.
+  lor_unit first;
+  /// @brief The number of units covered by the frame.
+  lor_unit units;
+  /// @brief The optional bitmap of changed channels, see lor_frame_track.
+  lor_dirty_s* dirty;
+} lor_frame_s;
+
+/// @brief Initializes a frame covering \p units units (starting at \p first)
+///        of \p channels channels each, using the provided buffer \p b as
+///        storage. The previous state is cleared, so every channel set before
+///        the first call to lor_frame_diff will be included in its result.
+/// @param f The frame to initialize.
+/// @param b The storage buffer, at least 2 * units * channels bytes in size.
+/// @param first The first unit covered by the frame.
+/// @param units The number of units covered by the frame.
+/// @param channels The number of channels per unit, less than or equal to 1024.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_frame_init(lor_frame_s* f, lor_intensity* b, lor_unit first,
+                   lor_unit units, lor_channel channels);
+
+/// @brief Tracks the channels changed by lor_frame_set in \p d, so that
+///        lor_frame_diff only compares the changed banks of channels instead
+///        of the entire frame. Every channel of the frame is marked as changed.
+/// @note The bitmap must be exclusive to the frame, and must not be modified
+///       by the caller while tracked.
+/// @param f The frame to track.
+/// @param d The bitmap to use, or NULL to stop tracking.
+void lor_frame_track(lor_frame_s* f, lor_dirty_s* d);
+
+/// @brief Sets the current intensity of a channel within the frame. The value
+///        is converted using the frame's intensity function (lor_get_intensity
+///        by default) before being stored, so changes which quantize to the
+///        same LOR intensity value are not considered changes.
+/// @param f The frame to modify.
+/// @param u The unit of the channel.
+/// @param c The channel number, relative to the unit.
+/// @param b The byte value to convert and store.
+/// @return 0 on success, -1 if the unit or channel is outside the frame.
+int lor_frame_set(lor_frame_s* f, lor_unit u, lor_channel c, unsigned char b);
+
+/// @brief Compares the current and previous state of the frame and writes up
+///        to \p rs requests to \p r which apply the changes. Changed channels
+///        sharing a 16-channel boundary and intensity value are grouped into a
+///        single request. Channels included in the written requests are
+///        marked as sent. If \p rs is too small to hold all changes, the
+///        remaining changes are left pending for the next call.
+/// @param f The frame to compare.
+/// @param r The request buffer to write to.
+/// @param rs The maximum number of requests to write.
+/// @return The number of requests written to \p r.
+size_t lor_frame_diff(lor_frame_s* f, lor_req_s* r, size_t rs);
+
+/// @def LOR_DMX_SLOTS
+/// @brief The maximum number of slots in a DMX universe.
+#define LOR_DMX_SLOTS 512
+
+/// @struct lor_event
+/// @brief Represents a request scheduled to be sent at a specific frame.
+typedef struct lor_event {
+  /// @brief The index of the frame to send the request at.
+  unsigned long frame;
+  /// @brief The request to send.
+  lor_req_s req;
+} lor_event_s;
+
+/// @brief Converts a timeline of per-frame intensities of a channel into the
+///        events needed to reproduce it, replacing linear ramps with a single
+///        \p LOR_FADE request interpolated by the hardware. The duration of a
+///        fade is the duration of its ramp rounded to the nearest decisecond
+///        (so it ends within 50 ms of the ramp, e.g. 30 frames of 33 ms fade
+///        over 1 second), and a ramp is used when every intensity it covers is
+///        within \p tol of the rounded fade, including frames past the end of
+///        a fade rounded down. Other changes are sent as \p LOR_SET_INTENSITY
+///        requests, unchanged frames are not sent.
+/// @param t The intensity of the channel at each frame.
+/// @param n The number of frames in \p t.
+/// @param period_ms The period of each frame in milliseconds.
+/// @param tol The maximum difference allowed between an intensity and a ramp.
+/// @param target The request whose unit and channel set are used by every
+///               event, allowing channels with equal timelines to be combined.
+/// @param e The event buffer to write to, in frame order.
+/// @param es The maximum number of events to write.
+/// @return The number of events written to \p e. If equal to \p es, the
+///         timeline may have been only partially converted.
+size_t lor_fit_fades(const lor_intensity* t, size_t n, unsigned short period_ms,
+                     unsigned char tol, const lor_req_s* target,
+                     lor_event_s* e, size_t es);
+
+/// @struct lor_dmx_map
+/// @brief Represents the LOR channel a DMX slot is patched to.
+typedef struct lor_dmx_map {
+  /// @brief The unit of the channel, or zero if the slot is not patched.
+  lor_unit unit;
+  /// @brief The channel number, relative to the unit.
+  lor_channel channel;
+} lor_dmx_map_s;
+
+/// @struct lor_dmx
+/// @brief Represents a translator of DMX universes into the channels of a
+///        frame, as described by a patch table. Only slots which changed
+///        since the previous universe are written to the frame, and the frame
+///        groups equal channel values into shared channel sets once diffed.
+///        Several translators (e.g. one per universe) may share one frame.
+typedef struct lor_dmx {
+  /// @brief The patch table, one entry per slot of the universe.
+  const lor_dmx_map_s* map;
+  /// @brief The frame the patched channels are written to.
+  lor_frame_s* frame;
+  /// @brief Non-zero once a universe has been translated.
+  int primed;
+  /// @brief The previous universe.
+  unsigned char prev[LOR_DMX_SLOTS];
+} lor_dmx_s;
+
+/// @brief Initializes a translator writing to \p f using the patch table
+///        \p map of \p LOR_DMX_SLOTS entries. The table must outlive \p d.
+/// @param d The translator to initialize.
+/// @param map The patch table.
+/// @param f The frame to write patched channels to.
+void lor_dmx_init(lor_dmx_s* d, const lor_dmx_map_s* map, lor_frame_s* f);
+
+/// @brief Translates the first \p n slots of a DMX universe, writing each
+///        patched slot which changed since the previous universe to the frame.
+///        Every patched slot is written by the first call.
+/// @param d The translator to use.
+/// @param u The universe slot values.
+/// @param n The number of slots in \p u, up to \p LOR_DMX_SLOTS.
+/// @return The number of patched slots written to the frame.
+size_t lor_dmx_update(lor_dmx_s* d, const unsigned char* u, size_t n);
+
+/// @struct lor_addr
+/// @brief Represents the address of a single channel.
+typedef struct lor_addr {
+  /// @brief The unit of the channel, or zero if the address is unused.
+  lor_unit unit;
+  /// @brief The channel number, relative to the unit.
+  lor_channel channel;
+} lor_addr_s;
+
+/// @struct lor_patch_entry
+/// @brief Represents a logical channel patched to the address of a channel.
+typedef struct lor_patch_entry {
+  /// @brief The logical channel number.
+  unsigned long logical;
+  /// @brief The address the logical channel is patched to.
+  lor_addr_s addr;
+} lor_patch_entry_s;
+
+/// @struct lor_patch_bank
+/// @brief Represents the patched channels of a unit sharing a 16-channel
+///        boundary, in the geometry of a lor_channel_set.
+typedef struct lor_patch_bank {
+  /// @brief The unit of the channels.
+  lor_unit unit;
+  /// @brief The offset of the bank and the bitset of its patched channels.
+  lor_channel_set cset;
+  /// @brief The index of the first patch entry of the bank.
+  size_t first;
+  /// @brief The number of patch entries of the bank (greater than the number
+  ///        of bits set if several logical channels share a channel).
+  size_t count;
+} lor_patch_bank_s;
+
+/// @struct lor_patch
+/// @brief Represents an index of a flat space of logical channels patched to
+///        channels of any unit. Logical channels are translated in constant
+///        time, and the patch entries are ordered by unit, then channel, so
+///        iterating them (or the banks) visits each unit's channels in order.
+typedef struct lor_patch {
+  /// @brief The address of each logical channel, indexed by logical channel.
+  lor_addr_s* index;
+  /// @brief The number of logical channels in \p index.
+  size_t n;
+  /// @brief The patch entries, sorted by unit then channel.
+  const lor_patch_entry_s* e;
+  /// @brief The number of patch entries.
+  size_t es;
+  /// @brief The banks covering the patch entries, sorted by unit then offset.
+  lor_patch_bank_s* banks;
+  /// @brief The number of banks.
+  size_t bs;
+} lor_patch_s;
+
+/// @brief Initializes a patch from \p es patch entries, which are sorted in
+///        place and must outlive \p p. Logical channels without an entry are
+///        left unpatched.
+/// @param p The patch to initialize.
+/// @param index The index storage, one element per logical channel.
+/// @param n The number of logical channels, each entry's logical channel must
+///          be less than \p n.
+/// @param banks The bank storage, at least \p es elements.
+/// @param e The patch entries.
+/// @param es The number of patch entries.
+/// @return 0 on success, -1 if an entry is out of range, patched to unit zero
+///         or a channel of 1024 or greater, or patches a logical channel which
+///         was already patched.
+int lor_patch_init(lor_patch_s* p, lor_addr_s* index, size_t n,
+                   lor_patch_bank_s* banks, lor_patch_entry_s* e, size_t es);
+
+/// @brief Returns the address a logical channel is patched to.
+/// @param p The patch to use.
+/// @param logical The logical channel.
+/// @return The address, or NULL if the logical channel is not patched.
+const lor_addr_s* lor_patch_get(const lor_patch_s* p, unsigned long logical);
+
+/// @brief Writes the value of every patched logical channel to the frame, in
+///        patch order so the frame is written sequentially. The frame then
+///        groups equal channel values into shared channel sets once diffed.
+/// @param p The patch to use.
+/// @param f The frame to write to.
+/// @param v The value of each logical channel, \p p->n values.
+/// @return The number of values written to the frame, patched channels outside
+///         the frame are skipped.
+size_t lor_patch_update(const lor_patch_s* p, lor_frame_s* f,
+                        const unsigned char* v);
+
+/// @struct lor_e131
+/// @brief Represents an E1.31 (sACN) data packet parsed by lor_e131_parse.
+///        The slot data is not copied and points into the packet buffer.
+typedef struct lor_e131 {
+  /// @brief The slot values of the universe, excluding the start code.
+  const unsigned char* slots;
+  /// @brief The number of slot values.
+  size_t n;
+  /// @brief The universe number.
+  unsigned short universe;
+  /// @brief The priority of the source, in the range of [0, 200].
+  unsigned char priority;
+  /// @brief The sequence number of the packet.
+  unsigned char sequence;
+  /// @brief The options bit field (0x80 preview data, 0x40 stream terminated,
+  ///        0x20 force synchronization).
+  unsigned char options;
+  /// @brief The DMX start code, zero for dimmer data.
+  unsigned char start_code;
+} lor_e131_s;
+
+/// @def LOR_E131_MAX_SIZE
+/// @brief The size of an E1.31 data packet of a full DMX universe.
+#define LOR_E131_MAX_SIZE (126 + LOR_DMX_SLOTS)
+
+/// @brief Parses an E1.31 data packet (e.g. a received UDP datagram) without
+///        copying its slot data, which may be passed to lor_dmx_update.
+/// @param p The parsed packet to initialize.
+/// @param b The packet buffer.
+/// @param bs The size of the packet buffer.
+/// @return 0 on success, -1 if the buffer is not a valid E1.31 data packet.
+int lor_e131_parse(lor_e131_s* p, const unsigned char* b, size_t bs);
+
+/// @brief Builds an E1.31 data packet of dimmer data (start code zero) at the
+///        default priority of 100, e.g. to test a receiver with
+///        lor_e131_parse. The source name is "tinylor" and the CID is zero.
+/// @param b The buffer to write the packet to.
+/// @param bs The size of the buffer, at least 126 + \p n bytes (see
+///           LOR_E131_MAX_SIZE).
+/// @param universe The universe number.
+/// @param seq The sequence number.
+/// @param slots The slot values.
+/// @param n The number of slot values, up to \p LOR_DMX_SLOTS.
+/// @return The size of the packet, or zero if \p n or \p bs is invalid.
+size_t lor_e131_build(unsigned char* b, size_t bs, unsigned short universe,
+                      unsigned char seq, const unsigned char* slots, size_t n);
+
+/// @brief Determines whether a packet with sequence number \p seq should be
+///        processed after a packet with sequence number \p last from the same
+///        source, discarding late or duplicate packets as described by E1.31.
+/// @param last The sequence number of the last processed packet.
+/// @param seq The sequence number of the received packet.
+/// @return Non-zero if the packet should be processed, otherwise zero.
+int lor_e131_sequence_ok(unsigned char last, unsigned char seq);
+
+/// @brief Returns the number of bytes which may be sent within \p ms
+///        milliseconds over a serial link of \p baud baud, assuming 8N1
+///        framing (10 bits per byte).
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+/// @param ms The duration in milliseconds.
+/// @return The number of bytes which may be sent.
+size_t lor_wire_bytes(unsigned long baud, unsigned long ms);
+
+/// @brief Returns the number of microseconds required to send \p n bytes over
+///        a serial link of \p baud baud, assuming 8N1 framing (10 bits per
+///        byte), rounded up.
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+/// @param n The number of bytes to send.
+/// @return The wire time in microseconds.
+unsigned long lor_wire_us(unsigned long baud, size_t n);
+
+/// @struct lor_sched_entry
+/// @brief Represents a request waiting to be admitted by a scheduler.
+typedef struct lor_sched_entry {
+  /// @brief The request to send.
+  lor_req_s req;
+  /// @brief The priority of the request, higher values are admitted first.
+  unsigned char priority;
+} lor_sched_entry_s;
+
+/// @struct lor_sched
+/// @brief Represents a frame scheduler which admits queued requests by priority
+///        until the encoded size of the frame reaches the number of bytes the
+///        serial link can send within the frame period. Requests which do not
+///        fit are deferred to the following frame with their priority raised
+///        by one, so deferred requests are not starved by newer requests.
+/// @note Requests are admitted in their original order within a frame, but a
+///       deferred request may be sent after a later, higher priority request
+///       for the same channels. Use a single priority for each channel.
+typedef struct lor_sched {
+  /// @brief The queued requests, in the order they were added.
+  lor_sched_entry_s* e;
+  /// @brief The capacity of \p e.
+  size_t es;
+  /// @brief The number of queued requests.
+  size_t n;
+  /// @brief The number of encoded bytes which may be sent per frame.
+  size_t budget;
+  /// @brief The number of bytes of the next frame's budget reserved for other
+  ///        data (e.g. heartbeats), reset to zero by lor_sched_next.
+  size_t reserved;
+} lor_sched_s;
+
+/// @brief Initializes a scheduler using the provided queue storage \p e, with
+///        a per-frame budget of lor_wire_bytes(baud, ms) bytes.
+/// @param s The scheduler to initialize.
+/// @param e The queue storage buffer.
+/// @param es The number of entries in \p e.
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+/// @param ms The frame period in milliseconds.
+/// @note A budget smaller than the largest encoded request (11 bytes) may
+///       prevent some requests from ever being admitted.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_sched_init(lor_sched_s* s, lor_sched_entry_s* e, size_t es,
+                   unsigned long baud, unsigned long ms);
+
+/// @brief Queues a request to be admitted by a later call to lor_sched_next.
+/// @param s The scheduler to add the request to.
+/// @param req The request to queue, copied into the scheduler.
+/// @param priority The priority of the request, higher values first.
+/// @return 0 on success, -1 if the queue is full.
+int lor_sched_add(lor_sched_s* s, const lor_req_s* req, unsigned char priority);
+
+/// @brief Admits queued requests into the next frame, highest priority first,
+///        until the frame budget (less any reserved bytes) or \p rs requests
+///        is reached. Admitted requests are removed from the queue and written
+///        to \p r in the order they were added. The remaining requests are
+///        deferred.
+/// @param s The scheduler to admit requests from.
+/// @param r The request buffer to write the admitted requests to.
+/// @param rs The maximum number of requests to admit.
+/// @return The number of requests written to \p r.
+size_t lor_sched_next(lor_sched_s* s, lor_req_s* r, size_t rs);
+
+/// @struct lor_queue_entry
+/// @brief Represents a request waiting in an output queue.
+typedef struct lor_queue_entry {
+  /// @brief The request to send.
+  lor_req_s req;
+  /// @brief The packed unit, channel set and effect class of the request.
+  unsigned long long key;
+  /// @brief Non-zero if the request is still to be sent, zero if superseded.
+  int live;
+} lor_queue_entry_s;
+
+/// @struct lor_queue
+/// @brief Represents a first in, first out queue of requests in which a newer
+///        request replaces a queued request for the same unit, channel set
+///        and effect class (DMX intensity, or any other effect), so only the
+///        newest state of a channel set is sent when the link falls behind.
+///        The replacement keeps the queue position of the older request,
+///        unless a request queued after it overlaps the same channels, in
+///        which case the older request is dropped and the newer one appended.
+/// @note Matching requests are found in constant time through a direct-mapped
+///       table of the most recent request per key hash, so colliding keys are
+///       not always coalesced. A table of at least twice the queue capacity is
+///       suggested. Replacing a match in place first scans the requests queued
+///       after it for overlapping channels, so a push costs up to the number
+///       of requests queued after its match, and at most the queue capacity.
+typedef struct lor_queue {
+  /// @brief The queued requests, a ring buffer indexed by sequence number.
+  lor_queue_entry_s* e;
+  /// @brief The capacity of \p e, a power of two.
+  size_t es;
+  /// @brief The sequence number of the most recent request per key hash.
+  size_t* slots;
+  /// @brief The number of elements in \p slots, a power of two.
+  size_t ss;
+  /// @brief The sequence number of the oldest queued request.
+  size_t head;
+  /// @brief The sequence number of the next queued request.
+  size_t tail;
+  /// @brief The number of queued requests still to be sent.
+  size_t depth;
+  /// @brief The number of requests dropped because a newer request replaced
+  ///        them before they were sent.
+  unsigned long superseded;
+  /// @brief The number of requests rejected because the queue was full.
+  unsigned long rejected;
+} lor_queue_s;
+
+/// @brief Initializes an empty queue using the provided storage.
+/// @param q The queue to initialize.
+/// @param e The queue storage buffer.
+/// @param es The number of entries in \p e, a power of two.
+/// @param slots The key hash table storage.
+/// @param ss The number of elements in \p slots, a power of two.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_queue_init(lor_queue_s* q, lor_queue_entry_s* e, size_t es,
+                   size_t* slots, size_t ss);
+
+/// @brief Queues a request, replacing a queued request with the same key. See
+///        lor_queue_s for the cost of a replacement.
+/// @param q The queue to add the request to.
+/// @param req The request to queue, copied into the queue.
+/// @return 0 on success, -1 if the queue is full and the request was rejected
+///         (the caller should drain the queue or drop the request).
+int lor_queue_push(lor_queue_s* q, const lor_req_s* req);
+
+/// @brief Encodes and removes queued requests, oldest first, until the next
+///        request does not fit within the remaining space of \p b.
+/// @param q The queue to drain.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer, at least LOR_REQ_MAX_SIZE bytes to ensure
+///           progress.
+/// @return The number of bytes written to the buffer.
+size_t lor_queue_write(lor_queue_s* q, unsigned char* b, size_t bs);
+
+/// @struct lor_stream
+/// @brief Represents a serial output stream which inserts heartbeat messages
+///        between requests at the cadence of \p LOR_HEARTBEAT_DELAY_NS. The
+///        stream estimates when each request boundary is sent from the baud
+///        rate, so a heartbeat is inserted at the right point of a large frame
+///        rather than only before or after it.
+/// @note Times are monotonic nanosecond timestamps supplied by the caller.
+typedef struct lor_stream {
+  /// @brief The baud rate of the serial link.
+  unsigned long baud;
+  /// @brief The time at which the next heartbeat is due.
+  unsigned long long next_heartbeat;
+  /// @brief The estimated time at which previously written bytes finish
+  ///        sending.
+  unsigned long long busy_until;
+} lor_stream_s;
+
+/// @brief Initializes a stream for a serial link of \p baud baud. The first
+///        heartbeat is due immediately.
+/// @param s The stream to initialize.
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+void lor_stream_init(lor_stream_s* s, unsigned long baud);
+
+/// @brief Returns the number of heartbeat bytes the stream will insert within
+///        \p ms milliseconds of \p now, which may be reserved from a frame
+///        budget (see lor_sched_s reserved).
+/// @param s The stream to query.
+/// @param now The current time in nanoseconds.
+/// @param ms The frame period in milliseconds.
+/// @return The number of heartbeat bytes due within the frame period.
+size_t lor_stream_heartbeat_size(const lor_stream_s* s, unsigned long long now,
+                                 unsigned long ms);
+
+/// @brief Encodes and writes as many of the \p rs requests to \p b as fit,
+///        inserting a heartbeat at the first request boundary sent at or after
+///        the time the heartbeat is due. A due heartbeat is written even if
+///        \p rs is zero. The written bytes are assumed to be sent immediately.
+/// @param s The stream to write to.
+/// @param now The current time in nanoseconds.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @param r The requests to write.
+/// @param rs The number of requests in \p r.
+/// @param n Optional, set to the number of requests written.
+/// @return The number of bytes written to the buffer.
+size_t lor_stream_write(lor_stream_s* s, unsigned long long now,
+                        unsigned char* b, size_t bs, const lor_req_s* r,
+                        size_t rs, size_t* n);
+
+/// @def LOR_HIST_SUB_BITS
+/// @brief The log2 of the number of linear sub-buckets per power of two of a
+///        lor_hist_s, bounding the width of a bucket to 1/8 of its start.
+#define LOR_HIST_SUB_BITS 3
+
+/// @def LOR_HIST_BUCKETS
+/// @brief The number of buckets of a lor_hist_s, covering durations of up to
+///        2^32 nanoseconds (~4.3 seconds).
+#define LOR_HIST_BUCKETS ((32 - LOR_HIST_SUB_BITS + 1) << LOR_HIST_SUB_BITS)
+
+/// @struct lor_hist
+/// @brief Represents a histogram of durations in log-linear buckets. Durations
+///        below 2^LOR_HIST_SUB_BITS nanoseconds are counted exactly, and each
+///        longer power of two range is split into 2^LOR_HIST_SUB_BITS equal
+///        buckets (e.g. [589824, 655360) nanoseconds), so percentiles resolve
+///        to within 12.5%. Durations past the last bucket are counted by it.
+typedef struct lor_hist {
+  /// @brief The number of durations counted per bucket.
+  unsigned long count[LOR_HIST_BUCKETS];
+  /// @brief The number of durations counted.
+  unsigned long n;
+  /// @brief The longest duration counted, in nanoseconds.
+  unsigned long long max;
+} lor_hist_s;
+
+/// @brief Counts a duration.
+/// @param h The histogram to add to.
+/// @param ns The duration in nanoseconds.
+void lor_hist_add(lor_hist_s* h, unsigned long long ns);
+
+/// @brief Returns an upper bound of the \p pct percentile duration, the end of
+///        the bucket containing the percentile (or the longest duration, if
+///        shorter).
+/// @param h The histogram to query.
+/// @param pct The percentile, in the range of [0, 100].
+/// @return The upper bound in nanoseconds, or zero if the histogram is empty.
+unsigned long long lor_hist_percentile(const lor_hist_s* h, unsigned pct);
+
+/// @struct lor_clock
+/// @brief Represents a fixed rate frame clock with absolute deadlines, so the
+///        tick rate does not drift with the time spent per tick. Each tick
+///        records its start jitter (the time past its deadline) and, once
+///        the frame is written, its encode-to-write duration. A tick which
+///        starts a whole period late skips the missed deadlines, keeping the
+///        original phase, rather than sending a burst of late frames.
+/// @note Times are monotonic nanosecond timestamps supplied by the caller, see
+///       lor_clock_wait for a POSIX implementation of the wait. A frame loop
+///       waits for a tick, encodes (e.g. lor_frame_diff then lor_stream_write)
+///       and writes the frame, then calls lor_clock_done.
+typedef struct lor_clock {
+  /// @brief The period of the clock in nanoseconds.
+  unsigned long long period;
+  /// @brief The deadline of the next tick.
+  unsigned long long next;
+  /// @brief The start time of the current tick.
+  unsigned long long start;
+  /// @brief The number of ticks.
+  unsigned long ticks;
+  /// @brief The number of deadlines skipped because a tick started late.
+  unsigned long missed;
+  /// @brief The time past its deadline each tick started, including any
+  ///        skipped periods.
+  lor_hist_s jitter;
+  /// @brief The duration from tick start to lor_clock_done.
+  lor_hist_s encode;
+} lor_clock_s;
+
+/// @brief Initializes a clock whose first tick is due at \p now.
+/// @param c The clock to initialize.
+/// @param now The current time in nanoseconds.
+/// @param period The period in nanoseconds, e.g. 25000000 for 40 Hz.
+/// @return 0 on success, -1 for a zero period.
+int lor_clock_init(lor_clock_s* c, unsigned long long now,
+                   unsigned long long period);
+
+/// @brief Starts the due tick, recording its jitter and advancing the next
+///        deadline past \p now.
+/// @param c The clock to tick.
+/// @param now The current time in nanoseconds.
+/// @return The number of deadlines skipped, or -1 if the tick is not yet due.
+long lor_clock_tick(lor_clock_s* c, unsigned long long now);
+
+/// @brief Records the duration of the current tick, called once its frame is
+///        written.
+/// @param c The clock to update.
+/// @param now The current time in nanoseconds.
+void lor_clock_done(lor_clock_s* c, unsigned long long now);
+
+/// @def LOR_SHOW_HEADER_SIZE
+/// @brief The size of the header preceding the frame index of a compiled show.
+#define LOR_SHOW_HEADER_SIZE 12
+
+/// @struct lor_show
+/// @brief Represents a compiled show, a sequence of frames of pre-encoded
+///        requests with a per-frame offset index. A compiled show is portable
+///        between hosts and may be stored as a file and played back directly
+///        from memory (e.g. a file mapped with mmap, see lor_show_map and
+///        lor_show_play) without encoding.
+/// @note The compiled layout is a 12 byte header ("LORS", version, reserved
+///       byte, 16-bit frame period in milliseconds, 32-bit frame count), an
+///       index of frame count + 1 32-bit offsets relative to the end of the
+///       index, then the encoded frame data. Integers are little endian.
+typedef struct lor_show {
+  /// @brief The compiled show data.
+  const unsigned char* b;
+  /// @brief The size of the compiled show data.
+  size_t bs;
+  /// @brief The number of frames in the show.
+  unsigned long frames;
+  /// @brief The period of each frame in milliseconds.
+  unsigned short period_ms;
+} lor_show_s;
+
+/// @brief Compiles a show of \p frames frames into \p b. Frame \p i consists
+///        of the next \p rc[i] requests of \p r.
+/// @param b The buffer to write the compiled show to.
+/// @param bs The size of the buffer, may be zero to only measure the show.
+/// @param r The requests of every frame, in order.
+/// @param rc The number of requests in each frame.
+/// @param frames The number of frames in the show.
+/// @param period_ms The period of each frame in milliseconds.
+/// @return The size of the compiled show. If greater than \p bs, nothing was
+///         written and the caller should retry with a buffer of this size.
+size_t lor_show_compile(unsigned char* b, size_t bs, const lor_req_s* r,
+                        const size_t* rc, unsigned long frames,
+                        unsigned short period_ms);
+
+/// @brief Opens a compiled show for playback, validating its header and
+///        index. The show data is not copied and must outlive \p s.
+/// @param s The show to initialize.
+/// @param b The compiled show data.
+/// @param bs The size of the compiled show data.
+/// @return 0 on success, -1 if the data is not a valid compiled show.
+int lor_show_open(lor_show_s* s, const unsigned char* b, size_t bs);
+
+/// @brief Returns the encoded bytes of a frame of an opened show.
+/// @param s The show to read from.
+/// @param i The index of the frame, less than the show's frame count.
+/// @param n Set to the number of encoded bytes in the frame.
+/// @return A pointer to the encoded frame within the show data.
+const unsigned char* lor_show_frame(const lor_show_s* s, unsigned long i,
+                                    size_t* n);
+
+/// @struct lor_cache_entry
+/// @brief Represents a previously encoded request held by a cache.
+typedef struct lor_cache_entry {
+  /// @brief The packed unit, effect and channel set of the request.
+  unsigned long long key;
+  /// @brief The packed effect arguments of the request.
+  unsigned long args;
+  /// @brief The encoded size of the request, or zero if the entry is unused.
+  unsigned char size;
+  /// @brief The encoded request.
+  unsigned char b[LOR_REQ_MAX_SIZE];
+} lor_cache_entry_s;
+
+/// @struct lor_cache
+/// @brief Represents a direct-mapped cache of encoded requests, keyed on the
+///        packed request fields, which is useful when the same requests are
+///        repeatedly encoded (e.g. chases). A request mapping to an occupied
+///        entry evicts the request previously held by the entry.
+typedef struct lor_cache {
+  /// @brief The cache entries.
+  lor_cache_entry_s* e;
+  /// @brief The number of cache entries, a power of two.
+  size_t es;
+  /// @brief The number of requests found in the cache.
+  unsigned long hits;
+  /// @brief The number of requests encoded and added to the cache.
+  unsigned long misses;
+  /// @brief The number of misses which replaced a different request.
+  unsigned long evictions;
+} lor_cache_s;
+
+/// @brief Initializes a cache using the provided entry storage \p e.
+/// @param c The cache to initialize.
+/// @param e The entry storage buffer.
+/// @param es The number of entries in \p e, a power of two.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_cache_init(lor_cache_s* c, lor_cache_entry_s* e, size_t es);
+
+/// @brief Equivalent to lor_write, but copies previously encoded requests from
+///        the cache and adds any other requests to the cache.
+/// @param c The cache to use.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @param r The requests to write.
+/// @param rs The number of requests in \p r.
+/// @return See lor_write.
+size_t lor_cache_write(lor_cache_s* c, unsigned char* b, size_t bs,
+                       const lor_req_s* r, size_t rs);
+
+/// @struct lor_ring
+/// @brief Represents a lock-free, single producer single consumer ring buffer
+///        of encoded requests. This allows each network (serial port) to be
+///        encoded by its own thread and written by another, e.g. one encoding
+///        thread and one ring per network, without locks or blocking the other
+///        networks. lor_net_s (with TINYLOR_THREADS) provides these threads.
+/// @note Only one thread may call lor_ring_write and only one (possibly
+///       different) thread may call lor_ring_read and lor_ring_release.
+typedef struct lor_ring {
+  /// @brief The ring storage.
+  unsigned char* b;
+  /// @brief The size of \p b, a power of two.
+  size_t bs;
+  /// @brief The total number of bytes written, modified by the producer.
+  size_t head;
+  /// @brief The total number of bytes released, modified by the consumer.
+  size_t tail;
+} lor_ring_s;
+
+/// @brief Initializes an empty ring using the provided storage \p b.
+/// @param ring The ring to initialize.
+/// @param b The ring storage buffer.
+/// @param bs The size of \p b, a power of two.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_ring_init(lor_ring_s* ring, unsigned char* b, size_t bs);
+
+/// @brief Encodes as many of the \p rs requests into the ring as fit in its
+///        free space, then publishes them to the consumer at once. Requests
+///        are never split.
+/// @param ring The ring to write to, from the producer thread.
+/// @param r The requests to write.
+/// @param rs The number of requests in \p r.
+/// @return The number of requests written.
+size_t lor_ring_write(lor_ring_s* ring, const lor_req_s* r, size_t rs);
+
+/// @brief Returns the longest contiguous run of published bytes available to
+///        read, which remain valid until released by lor_ring_release.
+/// @param ring The ring to read from, from the consumer thread.
+/// @param n Set to the number of bytes available at the returned pointer.
+/// @return A pointer to the bytes available to read.
+const unsigned char* lor_ring_read(lor_ring_s* ring, size_t* n);
+
+/// @brief Releases \p n bytes returned by lor_ring_read (e.g. once written to
+///        the serial port), making their space available to the producer.
+/// @param ring The ring to release bytes from, from the consumer thread.
+/// @param n The number of bytes to release.
+void lor_ring_release(lor_ring_s* ring, size_t n);
+
+/// @brief Partitions requests by network, keeping their order within each
+///        network, e.g. to encode each network with lor_net_submit. Requests
+///        for the broadcast unit (0xFF) are copied to every network.
+/// @param r The requests to partition.
+/// @param rs The number of requests in \p r.
+/// @param net The network of each unit, indexed by unit. Requests for units
+///            mapped to a network of \p ns or greater are dropped.
+/// @param ns The number of networks.
+/// @param out The buffer to write the partitioned requests to.
+/// @param os The maximum number of requests to write to \p out.
+/// @param first Set to the index within \p out of the first request of each
+///              network, \p ns + 1 elements, so network i's requests are
+///              [first[i], first[i + 1]).
+/// @return The number of partitioned requests. If greater than \p os,
+///         nothing was written to \p out and the caller should retry with a
+///         buffer of this size.
+size_t lor_shard(const lor_req_s* r, size_t rs, const unsigned char* net,
+                 size_t ns, lor_req_s* out, size_t os, size_t* first);
+
+#ifdef TINYLOR_STATS
+
+/// @struct lor_stats
+/// @brief Represents statistics collected by the encoder when TINYLOR_STATS is
+///        defined. Requests are counted each time they are encoded by any
+///        function (requests copied from a lor_cache_s are not re-encoded),
+///        except lor_batch_write which is not instrumented.
+/// @note Statistics are global and not synchronized between threads. Batch
+///       encoding time is only measured if TINYLOR_STATS_CLOCK is defined as
+///       an expression returning a nanosecond timestamp (unsigned long long).
+typedef struct lor_stats {
+  /// @brief The number of requests encoded per effect, indexed by lor_effect.
+  unsigned long effects[LOR_SET_DMX_INTENSITY + 1];
+  /// @brief The number of requests encoded per channel set format, indexed by
+  ///        the lor_channel_format value shifted right by 4 bits.
+  unsigned long formats[(LOR_FMT_MULTIPART >> 4) + 1];
+  /// @brief The number of requests encoded.
+  unsigned long requests;
+  /// @brief The number of bytes encoded.
+  unsigned long long bytes;
+  /// @brief The number of lor_write calls.
+  unsigned long batches;
+  /// @brief The number of requests lor_write could not write for lack of
+  ///        buffer space.
+  unsigned long overflows;
+  /// @brief The total time spent in lor_write calls in nanoseconds.
+  unsigned long long batch_ns;
+} lor_stats_s;
+
+/// @typedef lor_stats_fn
+/// @brief Represents a function called after each request is encoded.
+typedef void (*lor_stats_fn)(const lor_req_s* req, size_t size, void* ctx);
+
+/// @brief Copies a snapshot of the statistics collected so far into \p s.
+/// @param s The statistics to write to.
+void lor_stats_get(lor_stats_s* s);
+
+/// @brief Resets every statistic to zero.
+void lor_stats_reset(void);
+
+/// @brief Sets (or clears, if \p fn is NULL) a function to be called after
+///        each request is encoded with the request, its encoded size and \p ctx.
+/// @param fn The function to call.
+/// @param ctx The context passed to \p fn.
+void lor_stats_hook(lor_stats_fn fn, void* ctx);
+
+#endif// TINYLOR_STATS
+
+#ifdef TINYLOR_POSIX
+
+/// @brief Configures an open serial port (or pseudo terminal) for the LOR
+///        protocol: raw 8N1 mode at \p baud baud, non-blocking, and where
+///        supported by the driver, low latency mode.
+/// @note Available when TINYLOR_POSIX is defined. The POSIX and X/Open APIs
+///       used require _XOPEN_SOURCE 700 (or an equivalent feature test macro)
+///       to be defined before any system header is included. Hardware flow
+///       control is only disabled if the non-standard CRTSCTS flag is visible,
+///       which requires e.g. _DEFAULT_SOURCE (glibc, the BSDs), _GNU_SOURCE
+///       or _DARWIN_C_SOURCE (macOS) to also be defined.
+/// @param fd The file descriptor of the serial port.
+/// @param baud The baud rate, e.g. 57600 or 115200.
+/// @return 0 on success, -1 on error (see errno).
+int lor_serial_configure(int fd, unsigned long baud);
+
+/// @brief Opens and configures the serial port at \p path using
+///        lor_serial_configure.
+/// @param path The path of the serial port device, e.g. "/dev/ttyUSB0".
+/// @param baud The baud rate, e.g. 57600 or 115200.
+/// @return The file descriptor of the opened port, or -1 on error.
+int lor_serial_open(const char* path, unsigned long baud);
+
+/// @brief Sends the \p iovcnt buffers of \p iov using as few writev calls as
+///        the port accepts, waiting up to \p timeout_ms milliseconds for the
+///        port to become writable whenever it is full. The buffers of \p iov
+///        are advanced past the bytes sent, so a timed out send may be resumed
+///        by calling the function again with the same arguments.
+/// @param fd The file descriptor of the serial port.
+/// @param iov The buffers to send, modified to exclude the bytes sent.
+/// @param iovcnt The number of buffers in \p iov.
+/// @param timeout_ms The maximum time to wait for the port, or -1 to wait
+///                   indefinitely.
+/// @return The number of bytes sent, less than the total if the send timed
+///         out, or -1 on error (see errno).
+long lor_serial_send(int fd, struct iovec* iov, int iovcnt, int timeout_ms);
+
+/// @brief Encodes \p rs requests into the scratch buffer \p b using lor_write,
+///        then sends the whole frame using lor_serial_send.
+/// @param fd The file descriptor of the serial port.
+/// @param b The scratch buffer to encode into, see lor_write_size.
+/// @param bs The size of \p b.
+/// @param r The requests to send.
+/// @param rs The number of requests in \p r.
+/// @param timeout_ms See lor_serial_send.
+/// @return The number of bytes sent, or -1 on error (see errno), including a
+///         scratch buffer too small to hold every request.
+long lor_serial_write(int fd, unsigned char* b, size_t bs, const lor_req_s* r,
+                      size_t rs, int timeout_ms);
+
+/// @brief Returns the current CLOCK_MONOTONIC time in nanoseconds, suitable
+///        for the stream, scheduler and clock functions.
+unsigned long long lor_clock_now(void);
+
+/// @brief Sleeps until the next deadline of the clock using an absolute
+///        CLOCK_MONOTONIC sleep (which does not accumulate drift), then ticks.
+/// @param c The clock to wait for.
+/// @return The number of deadlines skipped by the tick, or -1 on error.
+long lor_clock_wait(lor_clock_s* c);
+
+/// @brief Maps a compiled show file into memory read-only and opens it with
+///        lor_show_open, so startup time is independent of the show length.
+/// @param s The show to initialize, released with lor_show_unmap.
+/// @param path The path of the compiled show file.
+/// @return 0 on success, -1 on error (see errno, EINVAL if the file is not a
+///         valid compiled show).
+int lor_show_map(lor_show_s* s, const char* path);
+
+/// @brief Unmaps a show mapped by lor_show_map.
+/// @param s The show to unmap.
+void lor_show_unmap(lor_show_s* s);
+
+/// @brief Plays a show from frame \p i to its end at the show's frame period,
+///        sending each pre-encoded frame as-is with lor_serial_send, so
+///        playback neither encodes nor allocates. Heartbeats are sent ahead of
+///        frames at the cadence of \p LOR_HEARTBEAT_DELAY_NS. Frames whose
+///        deadline passed while a previous frame was sent are skipped, keeping
+///        the show in time.
+/// @param fd The file descriptor of the serial port.
+/// @param s The show to play.
+/// @param i The index of the first frame to play.
+/// @return The number of frames skipped, or -1 on error (see errno).
+long lor_show_play(int fd, const lor_show_s* s, unsigned long i);
+
+#ifdef TINYLOR_THREADS
+
+/// @struct lor_net
+/// @brief Represents the output of a network (serial port) driven by its own
+///        encoder and writer threads, connected by a lor_ring_s. Frames are
+///        handed to the encoder with lor_net_submit, so each network is
+///        encoded on its own core, and a slow port only stalls its own
+///        encoder once its ring is full rather than every network.
+/// @note Available when TINYLOR_POSIX and TINYLOR_THREADS are defined, which
+///       requires linking with POSIX threads. The fields are private.
+typedef struct lor_net {
+  /// @brief The encoded bytes waiting to be written to the port.
+  lor_ring_s ring;
+  /// @brief The file descriptor of the port.
+  int fd;
+  /// @brief The requests of the submitted frame.
+  const lor_req_s* r;
+  /// @brief The number of requests in \p r.
+  size_t rs;
+  /// @brief Non-zero while the submitted frame is being encoded.
+  int pending;
+  /// @brief Non-zero once the threads are asked to exit.
+  int stop;
+  /// @brief The errno of the first failed write, or zero.
+  int err;
+  /// @brief Guards \p pending, \p stop and \p err, and the waits for ring
+  ///        space and data (the ring itself is lock-free).
+  pthread_mutex_t lock;
+  /// @brief Signalled whenever a frame is submitted or encoded, and whenever
+  ///        bytes are published to or released from the ring.
+  pthread_cond_t cond;
+  /// @brief The encoder thread.
+  pthread_t encoder;
+  /// @brief The writer thread.
+  pthread_t writer;
+} lor_net_s;
+
+/// @brief Starts the encoder and writer threads of a network.
+/// @param n The network to start.
+/// @param fd The file descriptor of the port, e.g. from lor_serial_open.
+/// @param b The ring storage buffer.
+/// @param bs The size of \p b, a power of two of at least LOR_REQ_MAX_SIZE.
+/// @return 0 on success, -1 on error.
+int lor_net_start(lor_net_s* n, int fd, unsigned char* b, size_t bs);
+
+/// @brief Hands a frame to the encoder of a network, first waiting for the
+///        previous frame to be encoded. The requests must not be modified
+///        until the frame is encoded (see lor_net_sync).
+/// @param n The network to write to.
+/// @param r The requests of the frame.
+/// @param rs The number of requests in \p r.
+/// @return 0 on success, -1 if a previous write to the port failed (the
+///         frame is not submitted, see lor_net_stop).
+int lor_net_submit(lor_net_s* n, const lor_req_s* r, size_t rs);
+
+/// @brief Waits for the submitted frame of a network to be encoded, after
+///        which its requests may be reused.
+/// @param n The network to wait for.
+void lor_net_sync(lor_net_s* n);
+
+/// @brief Waits for the submitted frame to be encoded and written, then stops
+///        the threads of a network. The port is not closed.
+/// @param n The network to stop.
+/// @return 0 on success, -1 if a write to the port failed (errno is set to
+///         its error).
+int lor_net_stop(lor_net_s* n);
+
+#endif// TINYLOR_THREADS
+
+#endif// TINYLOR_POSIX
+
 #endif// TINYLOR_H
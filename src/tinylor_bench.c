@@ -0,0 +1,363 @@
+/// @file tinylor_bench.c
+/// @brief Micro and macro benchmarks of the encoding hot paths.
+/// @note Results are printed as CSV, one benchmark per line. An optional
+///       argument scales the number of iterations of every benchmark.
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "tinylor.h"
+
+/// @def BENCH_REPS
+/// @brief The number of times each benchmark is repeated, the fastest
+///        repetition is reported to reduce scheduling noise.
+#define BENCH_REPS 5
+
+/// @brief Accumulates benchmark results to prevent them being optimized out.
+static volatile size_t sink;
+
+/// @brief Iteration count multiplier from the command line.
+static unsigned long scale = 1;
+
+/// @brief Returns a monotonic timestamp in nanoseconds.
+static unsigned long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// @brief Returns the next value of a fixed seed xorshift generator, so every
+///        run benchmarks the same data.
+static unsigned long next_rand(void) {
+  static unsigned long long x = 0x2545F4914F6CDD1DULL;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return (unsigned long) (x >> 32);
+}
+
+/// @brief Prints the CSV result line of a benchmark.
+/// @param name The name of the benchmark.
+/// @param iters The number of iterations timed.
+/// @param reqs The number of requests (or values) processed per iteration.
+/// @param bytes The number of bytes produced per iteration.
+/// @param ns The fastest time in nanoseconds of all iterations.
+static void report(const char* name, const unsigned long iters,
+                   const size_t reqs, const size_t bytes,
+                   const unsigned long long ns) {
+  const double total = (double) iters * reqs;
+  const double sec = ns / 1e9;
+  printf("%s,%lu,%zu,%zu,%.2f,%.0f,%.0f\n", name, iters, reqs, bytes,
+         ns / total, total / sec, (double) iters * bytes / sec);
+}
+
+/// @brief Encodes \p rs requests \p iters times using lor_write.
+static void bench_write(const char* name, const lor_req_s* r, const size_t rs,
+                        const unsigned long iters) {
+  const size_t bs = lor_write_size(r, rs);
+  unsigned char* b = malloc(bs);
+  unsigned long long best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    const unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++) sink += lor_write(b, bs, r, rs);
+    const unsigned long long ns = now_ns() - start;
+    if (ns < best) best = ns;
+  }
+  report(name, iters, rs, bs, best);
+  free(b);
+}
+
+/// @brief Benchmarks lor_write for each effect and channel set format.
+static void bench_write_formats(void) {
+  static const struct {
+    const char* name;
+    lor_channel first;
+    unsigned short cbits;
+  } formats[] = {
+          {"single", 3, 0x0001}, {"16", 0, 0x0F0F},  {"8l", 0, 0x00FF},
+          {"8h", 0, 0xFF00},     {"unit", 0, 0x0000}, {"multipart", 48, 0x0F0F},
+  };
+  static const struct {
+    const char* name;
+    lor_effect effect;
+  } effects[] = {
+          {"intensity", LOR_SET_INTENSITY},
+          {"fade", LOR_FADE},
+          {"pulse", LOR_PULSE},
+          {"twinkle", LOR_TWINKLE},
+  };
+  enum { N = 1024 };
+  static lor_req_s r[N];
+  for (size_t e = 0; e < sizeof(effects) / sizeof(effects[0]); e++) {
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+      const lor_effect_args_u args = {.fade = {1, 240, 10}};
+      for (int i = 0; i < N; i++) {
+        r[i] = (lor_req_s){0};
+        lor_set_unit(&r[i], (lor_unit) (i % 240 + 1));
+        lor_set_channels(&r[i], formats[f].first, formats[f].cbits);
+        lor_set_effect(&r[i], effects[e].effect, &args);
+      }
+      char name[64];
+      snprintf(name, sizeof(name), "write/%s/%s", effects[e].name,
+               formats[f].name);
+      bench_write(name, r, N, 2000 * scale);
+    }
+  }
+}
+
+/// @brief Benchmarks lor_write and lor_batch_write on the same mixed requests.
+static void bench_batch(void) {
+  enum { N = 4096 };
+  static lor_req_s r[N];
+  static lor_unit unit[N];
+  static unsigned char effect[N], offset[N], args[N * 4];
+  static unsigned short cbits[N];
+  lor_req_batch_s batch;
+  lor_batch_init(&batch, unit, effect, offset, cbits, args, N);
+  for (int i = 0; i < N; i++) {
+    const lor_effect_args_u a = {.fade = {1, 240, 10}};
+    lor_set_unit(&r[i], (lor_unit) (i % 240 + 1));
+    lor_set_channels(&r[i], (lor_channel) (next_rand() % 1024),
+                     (unsigned short) next_rand());
+    lor_set_effect(&r[i], (lor_effect) (next_rand() % 8 + 1), &a);
+    lor_batch_add(&batch, &r[i]);
+  }
+  bench_write("batch/aos", r, N, 2000 * scale);
+
+  const size_t bs = lor_batch_size(&batch);
+  unsigned char* b = malloc(bs);
+  const unsigned long iters = 2000 * scale;
+  unsigned long long best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    const unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++)
+      sink += lor_batch_write(b, bs, &batch);
+    const unsigned long long ns = now_ns() - start;
+    if (ns < best) best = ns;
+  }
+  report("batch/soa", iters, N, bs, best);
+  free(b);
+}
+
+/// @brief The work of one thread of the parallel chunk benchmark.
+typedef struct bench_chunk_job {
+  unsigned char* b;
+  lor_chunk_s* c;
+  size_t cs;
+  size_t i;
+  const lor_req_s* r;
+  pthread_barrier_t* barrier;
+  unsigned long iters;
+} bench_chunk_job;
+
+/// @brief Measures its chunk, waits for every chunk to be measured and their
+///        offsets computed (by whichever thread is released first), then
+///        writes its chunk, once per iteration.
+static void* bench_chunk_thread(void* arg) {
+  const bench_chunk_job* const job = arg;
+  lor_chunk_s* const c = &job->c[job->i];
+  for (unsigned long i = 0; i < job->iters; i++) {
+    lor_chunk_measure(c, job->r);
+    if (pthread_barrier_wait(job->barrier) == PTHREAD_BARRIER_SERIAL_THREAD)
+      lor_chunk_offsets(job->c, job->cs);
+    pthread_barrier_wait(job->barrier);
+    lor_chunk_write(job->b, c, job->r);
+    pthread_barrier_wait(job->barrier);
+  }
+  return NULL;
+}
+
+/// @brief Benchmarks chunked encoding of a full state resend (every bank of
+///        240 units) split across \p threads threads.
+static void bench_chunks(const size_t threads) {
+  enum { N = 240 * 64, MAX_THREADS = 16 };
+  // generated once so every thread count encodes the same requests
+  static lor_req_s r[N];
+  static int generated;
+  for (int i = 0; i < N && !generated; i++) {
+    r[i] = (lor_req_s){0};
+    lor_set_unit(&r[i], (lor_unit) (i / 64 + 1));
+    r[i].cset = (lor_channel_set){(unsigned char) (i % 64),
+                                  (unsigned short) next_rand()};
+    lor_set_intensity(&r[i], (lor_intensity) next_rand());
+  }
+  generated = 1;
+  const size_t bs = lor_write_size(r, N);
+  unsigned char* b = malloc(bs);
+  lor_chunk_s c[MAX_THREADS];
+  lor_chunk_split(c, threads, N);
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, (unsigned) threads);
+  const unsigned long iters = 200 * scale;
+
+  unsigned long long best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    pthread_t t[MAX_THREADS];
+    bench_chunk_job jobs[MAX_THREADS];
+    const unsigned long long start = now_ns();
+    for (size_t i = 0; i < threads; i++) {
+      jobs[i] = (bench_chunk_job){b, c, threads, i, r, &barrier, iters};
+      pthread_create(&t[i], NULL, bench_chunk_thread, &jobs[i]);
+    }
+    for (size_t i = 0; i < threads; i++) pthread_join(t[i], NULL);
+    const unsigned long long ns = now_ns() - start;
+    if (ns < best) best = ns;
+  }
+  sink += b[bs - 2];
+  char name[64];
+  snprintf(name, sizeof(name), "chunks/%zu", threads);
+  report(name, iters, N, bs, best);
+  pthread_barrier_destroy(&barrier);
+  free(b);
+}
+
+/// @brief Benchmarks single and batch intensity conversion.
+static void bench_intensity(void) {
+  enum { N = 4096 };
+  static unsigned char src[N];
+  static lor_intensity dst[N];
+  for (int i = 0; i < N; i++) src[i] = (unsigned char) next_rand();
+  const unsigned long iters = 2000 * scale;
+
+  unsigned long long best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    const unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++)
+      for (int j = 0; j < N; j++) dst[j] = lor_get_intensity(src[j]);
+    const unsigned long long ns = now_ns() - start;
+    sink += dst[N - 1];
+    if (ns < best) best = ns;
+  }
+  report("intensity/single", iters, N, N, best);
+
+  best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    const unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++)
+      lor_get_intensities(dst, src, N, lor_get_intensity_gamma);
+    const unsigned long long ns = now_ns() - start;
+    sink += dst[N - 1];
+    if (ns < best) best = ns;
+  }
+  report("intensity/batch", iters, N, N, best);
+}
+
+/// @brief Benchmarks channel set alignment by lor_set_channels.
+static void bench_set_channels(void) {
+  enum { N = 4096 };
+  static lor_req_s r[N];
+  const unsigned long iters = 2000 * scale;
+  unsigned long long best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    const unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++)
+      for (int j = 0; j < N; j++)
+        lor_set_channels(&r[j], (lor_channel) j, (unsigned short) (i + j));
+    const unsigned long long ns = now_ns() - start;
+    sink += r[N - 1].cset.cbits;
+    if (ns < best) best = ns;
+  }
+  report("set_channels", iters, N, 0, best);
+}
+
+/// @brief Benchmarks diffing and encoding a full frame of \p channels
+///        channels, 512 channels per unit, where every channel changes.
+static void bench_frame(const size_t channels) {
+  const lor_channel per_unit = 512;
+  const lor_unit units = (lor_unit) ((channels + per_unit - 1) / per_unit);
+  const size_t n = (size_t) units * per_unit;
+  lor_intensity* storage = malloc(n * 2);
+  lor_req_s* r = malloc(n * sizeof(*r));
+  unsigned char* b = malloc(n * LOR_REQ_MAX_SIZE);
+  unsigned char* values = malloc(n * 2);
+  for (size_t i = 0; i < n * 2; i++) values[i] = (unsigned char) next_rand();
+
+  lor_frame_s frame;
+  lor_frame_init(&frame, storage, 1, units, per_unit);
+  const unsigned long iters = (100000000 / n / 100 + 1) * scale;
+  size_t reqs = 0, bytes = 0;
+  unsigned long long best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    reqs = bytes = 0;
+    const unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++) {
+      // alternate between two states so every frame has changes
+      const unsigned char* v = &values[(i % 2) * n];
+      for (lor_unit u = 0; u < units; u++)
+        for (lor_channel c = 0; c < per_unit; c++)
+          lor_frame_set(&frame, (lor_unit) (u + 1), c, v[u * per_unit + c]);
+      const size_t rs = lor_frame_diff(&frame, r, n);
+      bytes += lor_write(b, n * LOR_REQ_MAX_SIZE, r, rs);
+      reqs += rs;
+    }
+    const unsigned long long ns = now_ns() - start;
+    if (ns < best) best = ns;
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "frame/%zu", channels);
+  report(name, iters, reqs / iters, bytes / iters, best);
+  sink += bytes;
+  free(values);
+  free(b);
+  free(r);
+  free(storage);
+}
+
+/// @brief Benchmarks diffing a frame of 240 units of 1024 channels, where 50
+///        random channels change per frame, with and without dirty tracking.
+static void bench_frame_sparse(const int track) {
+  const lor_unit units = 240;
+  const lor_channel per_unit = 1024;
+  const size_t n = (size_t) units * per_unit;
+  enum { CHANGES = 50 };
+  lor_intensity* storage = malloc(n * 2);
+  lor_dirty_s* dirty = malloc(sizeof(*dirty));
+  lor_req_s r[CHANGES];
+
+  lor_frame_s frame;
+  lor_frame_init(&frame, storage, 1, units, per_unit);
+  lor_dirty_init(dirty);
+  if (track) lor_frame_track(&frame, dirty);
+  while (lor_frame_diff(&frame, r, CHANGES)) continue;
+  const unsigned long iters = 200 * scale;
+  size_t reqs = 0;
+  unsigned long long best = ~0ULL;
+  for (int rep = 0; rep < BENCH_REPS; rep++) {
+    reqs = 0;
+    const unsigned long long start = now_ns();
+    for (unsigned long i = 0; i < iters; i++) {
+      for (int c = 0; c < CHANGES; c++) {
+        const unsigned long x = next_rand();
+        lor_frame_set(&frame, (lor_unit) (x % units + 1),
+                      (lor_channel) (x / units % per_unit),
+                      (unsigned char) (i * 2 + 1));
+      }
+      reqs += lor_frame_diff(&frame, r, CHANGES);
+    }
+    const unsigned long long ns = now_ns() - start;
+    if (ns < best) best = ns;
+  }
+  report(track ? "frame_sparse/dirty" : "frame_sparse/scan", iters,
+         reqs / iters, 0, best);
+  free(dirty);
+  free(storage);
+}
+
+int main(const int argc, char** argv) {
+  if (argc > 1) scale = strtoul(argv[1], NULL, 10);
+  if (!scale) scale = 1;
+  printf("name,iterations,requests,bytes,ns_per_req,req_per_s,bytes_per_s\n");
+  bench_write_formats();
+  bench_batch();
+  bench_chunks(1);
+  bench_chunks(4);
+  bench_intensity();
+  bench_set_channels();
+  bench_frame(1000);
+  bench_frame(10000);
+  bench_frame(100000);
+  bench_frame_sparse(0);
+  bench_frame_sparse(1);
+  return 0;
+}
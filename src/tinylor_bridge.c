@@ -0,0 +1,390 @@
+/// @file tinylor_bridge.c
+/// @brief Bridges E1.31 (sACN) universes received over UDP to LOR frames.
+/// @note Universe k (starting at 1) is patched slot for slot to channels
+///       [0, 512) of unit k. Received packets are batched with recvmmsg,
+///       parsed in place and translated into a shared frame, which is diffed
+///       and written once per frame clock tick through a stream inserting
+///       heartbeats, so the units stay active while the frame is idle. On exit the packet-to-wire
+///       latency percentiles are printed, the time from receiving a packet
+///       which changed the frame to its frame being written.
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tinylor.h"
+
+/// @def BRIDGE_MAX_UNIVERSES
+/// @brief The maximum number of universes bridged.
+#define BRIDGE_MAX_UNIVERSES 16
+
+/// @def BRIDGE_BATCH
+/// @brief The maximum number of packets received by a single recvmmsg call.
+#define BRIDGE_BATCH 32
+
+/// @def BRIDGE_PENDING
+/// @brief The maximum number of packets whose latency is measured per frame.
+#define BRIDGE_PENDING 1024
+
+/// @brief The bridge and sender stand-in options.
+typedef struct bridge_opts {
+  /// @brief The UDP port to receive on (and send to), zero for an ephemeral
+  ///        port (only with the in-process sender).
+  unsigned short port;
+  /// @brief The number of universes, starting at universe 1.
+  unsigned universes;
+  /// @brief The frame rate in Hz.
+  unsigned long rate;
+  /// @brief The run time in seconds, zero to run until interrupted.
+  unsigned long seconds;
+  /// @brief The output serial port or file path.
+  const char* output;
+  /// @brief The baud rate of a serial port output.
+  unsigned long baud;
+  /// @brief Non-zero to also run the sender stand-in.
+  int send;
+  /// @brief Non-zero to only run the sender stand-in.
+  int send_only;
+} bridge_opts;
+
+/// @brief Set by SIGINT and SIGTERM to stop the bridge and sender.
+static volatile sig_atomic_t stop;
+
+/// @brief Requests the bridge and sender stop.
+static void on_signal(const int sig) {
+  (void) sig;
+  stop = 1;
+}
+
+/// @brief Returns the deadline of the run, or zero to run until interrupted.
+static unsigned long long run_until(const bridge_opts* o) {
+  return o->seconds ? lor_clock_now() + o->seconds * 1000000000ULL : 0;
+}
+
+/// @brief Sends every universe at the frame rate to 127.0.0.1, a chase of 16
+///        full intensity slots advancing one bank per packet. Packets are sent
+///        half a period out of phase with a bridge started at the same time,
+///        so they wait half a period on average for their frame.
+/// @param arg The options.
+/// @return NULL.
+static void* sender(void* arg) {
+  const bridge_opts* const o = arg;
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    perror("sender socket");
+    return NULL;
+  }
+  struct sockaddr_in addr = {.sin_family = AF_INET};
+  addr.sin_port = htons(o->port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  const unsigned long long period = 1000000000ULL / o->rate;
+  lor_clock_s c;
+  lor_clock_init(&c, lor_clock_now() + period / 2, period);
+  const unsigned long long until = run_until(o);
+  unsigned char slots[LOR_DMX_SLOTS], b[LOR_E131_MAX_SIZE];
+  for (unsigned long t = 0; !stop && (!until || c.next < until); t++) {
+    if (lor_clock_wait(&c) < 0) break;
+    memset(slots, 0, sizeof(slots));
+    memset(&slots[t % (LOR_DMX_SLOTS / 16) * 16], 0xFF, 16);
+    for (unsigned u = 1; u <= o->universes; u++) {
+      const size_t n = lor_e131_build(b, sizeof(b), (unsigned short) u,
+                                      (unsigned char) t, slots, sizeof(slots));
+      sendto(fd, b, n, 0, (struct sockaddr*) &addr, sizeof(addr));
+    }
+  }
+  close(fd);
+  return NULL;
+}
+
+/// @brief The state of the bridge.
+typedef struct bridge {
+  /// @brief The frame shared by every universe.
+  lor_frame_s frame;
+  /// @brief The storage of \p frame.
+  lor_intensity storage[2 * BRIDGE_MAX_UNIVERSES * LOR_DMX_SLOTS];
+  /// @brief The patch table of each universe.
+  lor_dmx_map_s map[BRIDGE_MAX_UNIVERSES][LOR_DMX_SLOTS];
+  /// @brief The translator of each universe.
+  lor_dmx_s dmx[BRIDGE_MAX_UNIVERSES];
+  /// @brief The sequence number of the last packet of each universe.
+  unsigned char seq[BRIDGE_MAX_UNIVERSES];
+  /// @brief Non-zero once a packet of the universe was processed.
+  int seen[BRIDGE_MAX_UNIVERSES];
+  /// @brief The requests of a frame, at most one per channel.
+  lor_req_s r[BRIDGE_MAX_UNIVERSES * LOR_DMX_SLOTS];
+  /// @brief The output stream, inserting heartbeats between requests.
+  lor_stream_s stream;
+  /// @brief The encoding buffer of a frame, with room for a few heartbeats.
+  unsigned char b[BRIDGE_MAX_UNIVERSES * LOR_DMX_SLOTS * LOR_REQ_MAX_SIZE +
+                  8 * LOR_HEARTBEAT_SIZE];
+  /// @brief The receive times of the packets which changed the pending frame.
+  unsigned long long pending[BRIDGE_PENDING];
+  /// @brief The number of receive times in \p pending.
+  size_t pendings;
+  /// @brief The packet-to-wire latency.
+  lor_hist_s latency;
+  /// @brief The number of packets received.
+  unsigned long packets;
+  /// @brief The number of packets discarded (invalid, out of order, preview
+  ///        data or an unpatched universe).
+  unsigned long discarded;
+  /// @brief The number of frames written.
+  unsigned long frames;
+  /// @brief The number of bytes written.
+  unsigned long long bytes;
+} bridge;
+
+/// @brief Translates a received packet into the frame.
+/// @param br The bridge.
+/// @param b The packet.
+/// @param n The size of the packet.
+/// @param universes The number of universes bridged.
+/// @param now The receive time of the packet.
+static void bridge_packet(bridge* br, const unsigned char* b, const size_t n,
+                          const unsigned universes,
+                          const unsigned long long now) {
+  br->packets++;
+  lor_e131_s p;
+  if (lor_e131_parse(&p, b, n) || p.start_code || p.options & 0x80 ||
+      !p.universe || p.universe > universes) {
+    br->discarded++;
+    return;
+  }
+  const unsigned i = p.universe - 1u;
+  if (br->seen[i] && !lor_e131_sequence_ok(br->seq[i], p.sequence)) {
+    br->discarded++;
+    return;
+  }
+  br->seen[i] = 1;
+  br->seq[i] = p.sequence;
+  if (lor_dmx_update(&br->dmx[i], p.slots, p.n) &&
+      br->pendings < BRIDGE_PENDING)
+    br->pending[br->pendings++] = now;
+}
+
+/// @brief Writes the changes of the frame and any due heartbeats, then records
+///        the latency of each packet which changed it. A frame without
+///        changes still writes its due heartbeats.
+/// @param br The bridge.
+/// @param fd The output file descriptor.
+/// @return 0 on success, -1 on error.
+static int bridge_frame(bridge* br, const int fd) {
+  const size_t rs = lor_frame_diff(&br->frame, br->r,
+                                   sizeof(br->r) / sizeof(br->r[0]));
+  size_t i = 0, k;
+  do {
+    const size_t h = lor_stream_write(&br->stream, lor_clock_now(), br->b,
+                                      sizeof(br->b), &br->r[i], rs - i, &k);
+    if (!h) break;
+    struct iovec iov = {br->b, h};
+    if (lor_serial_send(fd, &iov, 1, -1) < 0) return -1;
+    br->bytes += h;
+    i += k;
+  } while (i < rs);
+  const unsigned long long wire = lor_clock_now();
+  for (size_t i = 0; i < br->pendings; i++)
+    lor_hist_add(&br->latency, wire - br->pending[i]);
+  br->pendings = 0;
+  br->frames++;
+  return 0;
+}
+
+/// @brief Prints the percentiles of a histogram in microseconds.
+static void print_hist(const char* name, const lor_hist_s* h) {
+  printf("%s: n=%lu p50=%.1fus p90=%.1fus p99=%.1fus max=%.1fus\n", name, h->n,
+         lor_hist_percentile(h, 50) / 1e3, lor_hist_percentile(h, 90) / 1e3,
+         lor_hist_percentile(h, 99) / 1e3, h->max / 1e3);
+}
+
+/// @brief Opens the output, configuring it as a serial port if it is a
+///        terminal. Without an output path, frames are written to /dev/null.
+/// @return The file descriptor, or -1 on error.
+static int open_output(const bridge_opts* o) {
+  const char* const path = o->output ? o->output : "/dev/null";
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+  if (fd < 0) return -1;
+  if (isatty(fd) && lor_serial_configure(fd, o->baud)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/// @brief Receives and bridges packets until the run time elapses or the
+///        bridge is interrupted.
+/// @param br The bridge.
+/// @param o The options.
+/// @param sock The bound UDP socket.
+/// @param out The output file descriptor.
+/// @return 0 on success, -1 on error.
+static int bridge_run(bridge* br, const bridge_opts* o, const int sock,
+                      const int out) {
+  static unsigned char packets[BRIDGE_BATCH][LOR_E131_MAX_SIZE];
+  struct iovec iov[BRIDGE_BATCH];
+  struct mmsghdr msgs[BRIDGE_BATCH];
+  for (int i = 0; i < BRIDGE_BATCH; i++) {
+    iov[i] = (struct iovec){packets[i], sizeof(packets[i])};
+    msgs[i] = (struct mmsghdr){0};
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  lor_clock_s c;
+  lor_clock_init(&c, lor_clock_now(), 1000000000ULL / o->rate);
+  const unsigned long long until = run_until(o);
+  struct pollfd p = {.fd = sock, .events = POLLIN};
+  while (!stop) {
+    unsigned long long now = lor_clock_now();
+    if (until && now >= until) break;
+    if (lor_clock_tick(&c, now) >= 0) {
+      if (bridge_frame(br, out)) return -1;
+      lor_clock_done(&c, lor_clock_now());
+      continue;
+    }
+    // wait for packets until the next frame is due
+    const unsigned long long wait = c.next - now;
+    const struct timespec ts = {(time_t) (wait / 1000000000ULL),
+                                (long) (wait % 1000000000ULL)};
+    const int ready = ppoll(&p, 1, &ts, NULL);
+    if (ready < 0 && errno != EINTR) return -1;
+    if (ready <= 0) continue;
+    const int n = recvmmsg(sock, msgs, BRIDGE_BATCH, MSG_DONTWAIT, NULL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+      return -1;
+    }
+    now = lor_clock_now();
+    for (int i = 0; i < n; i++)
+      bridge_packet(br, packets[i], msgs[i].msg_len, o->universes, now);
+  }
+  print_hist("latency", &br->latency);
+  print_hist("jitter", &c.jitter);
+  print_hist("encode", &c.encode);
+  printf("packets=%lu discarded=%lu frames=%lu missed=%lu bytes=%llu\n",
+         br->packets, br->discarded, br->frames, c.missed, br->bytes);
+  return 0;
+}
+
+/// @brief Prints the command line usage.
+static void usage(const char* name) {
+  fprintf(stderr,
+          "usage: %s [-p port] [-u universes] [-r hz] [-t seconds] "
+          "[-o output] [-b baud] [-s | -S]\n"
+          "  -p  UDP port to receive on, 0 for any free port with -s "
+          "(default 5568)\n"
+          "  -u  universes bridged to units 1..n (default 1, max %d)\n"
+          "  -r  frame rate in Hz (default 40)\n"
+          "  -t  run time in seconds, 0 until interrupted (default 0)\n"
+          "  -o  serial port or file to write frames to (default /dev/null)\n"
+          "  -b  baud rate of a serial port (default 115200)\n"
+          "  -s  also run the sender stand-in, receiving on 127.0.0.1 only\n"
+          "  -S  only run the sender stand-in over 127.0.0.1\n",
+          name, BRIDGE_MAX_UNIVERSES);
+}
+
+int main(const int argc, char** argv) {
+  bridge_opts o = {.port = 5568, .universes = 1, .rate = 40, .baud = 115200};
+  int opt;
+  while ((opt = getopt(argc, argv, "p:u:r:t:o:b:sSh")) != -1) {
+    switch (opt) {
+      case 'p':
+        o.port = (unsigned short) strtoul(optarg, NULL, 10);
+        break;
+      case 'u':
+        o.universes = (unsigned) strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        o.rate = strtoul(optarg, NULL, 10);
+        break;
+      case 't':
+        o.seconds = strtoul(optarg, NULL, 10);
+        break;
+      case 'o':
+        o.output = optarg;
+        break;
+      case 'b':
+        o.baud = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        o.send = 1;
+        break;
+      case 'S':
+        o.send_only = 1;
+        break;
+      case 'h':
+        usage(argv[0]);
+        return 0;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if ((!o.port && !o.send) || !o.universes || o.universes > BRIDGE_MAX_UNIVERSES ||
+      !o.rate || o.rate > 1000) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  struct sigaction sa = {.sa_handler = on_signal};
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  if (o.send_only) {
+    sender(&o);
+    return 0;
+  }
+
+  static bridge br;
+  lor_frame_init(&br.frame, br.storage, 1, (lor_unit) o.universes,
+                 LOR_DMX_SLOTS);
+  for (unsigned u = 0; u < o.universes; u++) {
+    for (int i = 0; i < LOR_DMX_SLOTS; i++)
+      br.map[u][i] = (lor_dmx_map_s){(lor_unit) (u + 1), (lor_channel) i};
+    lor_dmx_init(&br.dmx[u], br.map[u], &br.frame);
+  }
+  lor_stream_init(&br.stream, o.baud);
+
+  const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr = {.sin_family = AF_INET};
+  addr.sin_port = htons(o.port);
+  // with the in-process sender, only its packets over loopback are bridged
+  addr.sin_addr.s_addr = htonl(o.send ? INADDR_LOOPBACK : INADDR_ANY);
+  socklen_t len = sizeof(addr);
+  if (sock < 0 || bind(sock, (struct sockaddr*) &addr, sizeof(addr)) ||
+      getsockname(sock, (struct sockaddr*) &addr, &len)) {
+    perror("socket");
+    return 1;
+  }
+  o.port = ntohs(addr.sin_port);// the port chosen for an ephemeral port
+  const int out = open_output(&o);
+  if (out < 0) {
+    perror(o.output ? o.output : "/dev/null");
+    return 1;
+  }
+
+  // the sender starts once the socket is bound, so no packet is lost
+  pthread_t t;
+  if (o.send && pthread_create(&t, NULL, sender, &o)) {
+    fprintf(stderr, "failed to start the sender\n");
+    return 1;
+  }
+  const int err = bridge_run(&br, &o, sock, out);
+  if (err) perror("bridge");
+  if (o.send) {
+    stop = 1;
+    pthread_join(t, NULL);
+  }
+  close(out);
+  close(sock);
+  // a bridge fed by the sender stand-in must have written its packets
+  return err || (o.send && !br.latency.n);
+}
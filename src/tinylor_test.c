@@ -1,5 +1,19 @@
 #undef NDEBUG
 #include <assert.h>
+#include <string.h>
+
+#ifdef TINYLOR_POSIX
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
 
 #include "tinylor.h"
 
@@ -35,6 +49,1182 @@ static void test_channel_alignment(const lor_channel first,
   assert(req.cset.cbits == expected.cbits);
 }
 
+/// @brief Tests the frame diff request generation and quantization skipping.
+static void test_frame_diff(void) {
+  lor_intensity b[2 * 2 * 32];
+  lor_frame_s f;
+  assert(lor_frame_init(&f, b, 1, 2, 32) == 0);
+  assert(lor_frame_set(&f, 3, 0, 0xFF) == -1);// unit outside of frame
+  assert(lor_frame_set(&f, 1, 32, 0xFF) == -1);// channel outside of frame
+
+  // channels sharing a bank and intensity are grouped into a single request
+  for (int c = 0; c < 8; c++) lor_frame_set(&f, 1, c, 0xFF);
+  lor_frame_set(&f, 1, 8, 0x00);
+  lor_frame_set(&f, 2, 17, 0xFF);
+
+  lor_req_s r[8];
+  assert(lor_frame_diff(&f, r, 8) == 3);
+  assert(r[0].unit == 1 && r[0].cset.offset == 0 && r[0].cset.cbits == 0xFF);
+  assert(r[0].args.set_intensity.intensity == lor_get_intensity(0xFF));
+  assert(r[1].unit == 1 && r[1].cset.cbits == 0x100);
+  assert(r[2].unit == 2 && r[2].cset.offset == 1 && r[2].cset.cbits == 0x2);
+
+  // unchanged (or equally quantized) channels produce no requests
+  assert(lor_frame_diff(&f, r, 8) == 0);
+  lor_frame_set(&f, 1, 9, 0x0F);
+  assert(lor_frame_diff(&f, r, 8) == 1);
+  lor_frame_set(&f, 1, 9, 0x10);
+  assert(lor_get_intensity(0x0F) == lor_get_intensity(0x10));
+  assert(lor_frame_diff(&f, r, 8) == 0);
+
+  // changes exceeding the request buffer remain pending
+  lor_frame_set(&f, 1, 0, 0x00);
+  lor_frame_set(&f, 2, 0, 0x00);
+  assert(lor_frame_diff(&f, r, 1) == 1 && r[0].unit == 1);
+  assert(lor_frame_diff(&f, r, 8) == 1 && r[0].unit == 2);
+}
+
+/// @brief Tests dirty channel iteration and dirty tracking of frames.
+static void test_dirty(void) {
+  static lor_dirty_s d;
+  lor_dirty_init(&d);
+  lor_unit u;
+  lor_channel_set cset;
+  assert(!lor_dirty_next(&d, &u, &cset));
+
+  // banks are returned once, ordered by unit then offset
+  lor_dirty_mark(&d, 200, 1023);
+  lor_dirty_mark(&d, 3, 17);
+  lor_dirty_mark(&d, 3, 18);
+  lor_dirty_mark(&d, 3, 2);
+  lor_dirty_mark(&d, 3, 1024);// ignored, outside of the unit
+  assert(lor_dirty_next(&d, &u, &cset) && u == 3);
+  assert(cset.offset == 0 && cset.cbits == 0x4);
+  assert(lor_dirty_next(&d, &u, &cset) && u == 3);
+  assert(cset.offset == 1 && cset.cbits == 0x6);
+  assert(lor_dirty_next(&d, &u, &cset) && u == 200);
+  assert(cset.offset == 63 && cset.cbits == 0x8000);
+  assert(!lor_dirty_next(&d, &u, &cset));
+
+  // a tracked frame produces the same requests as an untracked frame
+  lor_intensity b1[2 * 2 * 40], b2[2 * 2 * 40];
+  lor_frame_s f1, f2;
+  lor_frame_init(&f1, b1, 1, 2, 40);
+  lor_frame_init(&f2, b2, 1, 2, 40);
+  lor_frame_track(&f2, &d);
+  lor_req_s r1[16], r2[16];
+  for (int i = 0; i < 4; i++) {
+    const lor_channel c = (lor_channel) (i * 13 % 40);
+    const unsigned char v = (unsigned char) (i * 70);
+    lor_frame_set(&f1, (lor_unit) (i % 2 + 1), c, v);
+    lor_frame_set(&f2, (lor_unit) (i % 2 + 1), c, v);
+  }
+  size_t n = lor_frame_diff(&f1, r1, 16);
+  assert(n == 4 && lor_frame_diff(&f2, r2, 16) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(r1[i].unit == r2[i].unit && r1[i].cset.offset == r2[i].cset.offset);
+    assert(r1[i].cset.cbits == r2[i].cset.cbits);
+    assert(r1[i].args.set_intensity.intensity ==
+           r2[i].args.set_intensity.intensity);
+  }
+
+  // a channel changed and reverted before diffing is not a change
+  lor_frame_set(&f2, 1, 0, 0xFF);
+  lor_frame_set(&f2, 1, 0, 0x00);
+  assert(lor_frame_diff(&f2, r2, 16) == 0);
+
+  // changes exceeding the request buffer remain pending
+  lor_frame_set(&f2, 1, 0, 0x80);
+  lor_frame_set(&f2, 1, 1, 0xFF);
+  lor_frame_set(&f2, 2, 0, 0x80);
+  assert(lor_frame_diff(&f2, r2, 1) == 1 && r2[0].cset.cbits == 0x1);
+  assert(lor_frame_diff(&f2, r2, 1) == 1 && r2[0].cset.cbits == 0x2);
+  assert(lor_frame_diff(&f2, r2, 16) == 1 && r2[0].unit == 2);
+  assert(lor_frame_diff(&f2, r2, 16) == 0);
+}
+
+/// @brief Tests merging of same-effect requests into shared channel sets.
+static void test_coalesce(void) {
+  lor_req_s r[20] = {0};
+  for (int c = 0; c < 16; c++) {
+    lor_set_unit(&r[c], 1);
+    lor_set_channel(&r[c], c);
+    lor_set_intensity(&r[c], 0x80);
+  }
+  unsigned char b[256];
+  assert(lor_write(b, sizeof(b), r, 16) == 16 * 7);
+  assert(lor_coalesce(r, 16) == 1);
+  assert(r[0].cset.offset == 0 && r[0].cset.cbits == 0xFFFF);
+  assert(lor_write(b, sizeof(b), r, 1) == 8);
+
+  // differing units, boundaries or arguments are kept apart
+  lor_set_unit(&r[1], 2);
+  lor_set_channel(&r[1], 0);
+  lor_set_intensity(&r[1], 0x80);
+  r[2] = r[0];
+  lor_set_channel(&r[2], 16);
+  r[3] = r[0];
+  lor_set_intensity(&r[3], 0x40);
+  assert(lor_coalesce(r, 4) == 4);
+
+  // a request is not merged past a conflicting request to the same channels
+  lor_set_channel(&r[0], 0);
+  lor_set_channel(&r[1], 0);
+  lor_set_unit(&r[1], 1);
+  lor_set_effect(&r[1], LOR_SET_OFF, NULL);
+  r[2] = r[0];
+  r[3] = r[0];
+  lor_set_channel(&r[3], 1);
+  assert(lor_coalesce(r, 4) == 3);
+  assert(r[0].cset.cbits == 0x1 && r[1].effect == LOR_SET_OFF);
+  assert(r[2].cset.cbits == 0x3);
+}
+
+/// @brief Tests the encoded size calculation against lor_write.
+static void test_write_size(void) {
+  lor_req_s r[4] = {0};
+  lor_set_channels(&r[0], 0, 0xFFFF);
+  lor_set_fade(&r[0], 1, 240, 10);
+  lor_set_channel(&r[1], 8);
+  lor_set_effect(&r[2], LOR_SET_OFF, NULL);
+  lor_set_channels(&r[3], 40, 0x00FF);
+  lor_set_intensity(&r[3], 0x80);
+
+  unsigned char b[64];
+  size_t total = 0;
+  for (int i = 0; i < 4; i++) {
+    const size_t n = lor_req_size(&r[i]);
+    assert(lor_write(b, sizeof(b), &r[i], 1) == n);
+    total += n;
+  }
+  assert(lor_write_size(r, 4) == total);
+  assert(lor_write(b, total, r, 4) == total);
+
+  // a buffer too small for the last request reports the request's size
+  assert(lor_write(b, total - 1, r, 4) == lor_req_size(&r[3]));
+
+  // the fade duration follows the start and end intensities
+  lor_write(b, sizeof(b), r, 1);
+  assert(b[3] == 1 && b[4] == 240 && b[5] == 0x80 && b[6] == 10);
+}
+
+/// @brief Tests resuming an encoder across buffers smaller than a request.
+static void test_encoder(void) {
+  lor_req_s r[3] = {0};
+  lor_set_channels(&r[0], 0, 0xFFFF);
+  lor_set_fade(&r[0], 1, 240, 10);
+  lor_set_channel(&r[1], 20);
+  lor_set_intensity(&r[1], 0x40);
+  lor_set_effect(&r[2], LOR_TWINKLE, NULL);
+
+  unsigned char expected[64];
+  const size_t total = lor_write(expected, sizeof(expected), r, 3);
+
+  for (size_t bs = 1; bs <= total; bs++) {
+    lor_encoder_s enc;
+    lor_encoder_init(&enc, r, 3);
+    assert(enc.pending == total && enc.consumed == 0);
+
+    unsigned char b[64];
+    size_t h = 0, n;
+    while ((n = lor_encoder_write(&enc, &b[h], bs)) > 0) {
+      assert(n == bs || enc.pending == 0);
+      h += n;
+      assert(enc.produced == h && enc.pending == total - h);
+    }
+    assert(h == total && enc.consumed == 3);
+    assert(memcmp(b, expected, total) == 0);
+  }
+}
+
+/// @brief Tests chunked encoding matches lor_write regardless of chunk order.
+static void test_chunk(void) {
+  enum { N = 23 };
+  lor_req_s r[N] = {0};
+  for (int i = 0; i < N; i++) {
+    lor_set_unit(&r[i], (lor_unit) (i + 1));
+    lor_set_channels(&r[i], (lor_channel) i, (unsigned short) (i * 0x1111));
+    lor_set_fade(&r[i], 1, (lor_intensity) i, (lor_decisec) i);
+    if (i % 3) lor_set_intensity(&r[i], 0x40);
+  }
+  unsigned char expected[N * LOR_REQ_MAX_SIZE];
+  const size_t total = lor_write(expected, sizeof(expected), r, N);
+
+  for (size_t cs = 1; cs <= N + 2; cs++) {
+    lor_chunk_s c[N + 2];
+    lor_chunk_split(c, cs, N);
+    // measure and write in reverse order, as concurrent chunks might
+    for (size_t i = cs; i-- > 0;) lor_chunk_measure(&c[i], r);
+    assert(lor_chunk_offsets(c, cs) == total);
+    unsigned char b[N * LOR_REQ_MAX_SIZE];
+    for (size_t i = cs; i-- > 0;)
+      assert(lor_chunk_write(b, &c[i], r) == c[i].size);
+    assert(c[cs - 1].first + c[cs - 1].count == N);
+    assert(memcmp(b, expected, total) == 0);
+  }
+}
+
+/// @brief Tests batch encoding matches lor_write for every effect and format.
+static void test_batch(void) {
+  enum { N = 64 };
+  static const unsigned short cbits[] = {0x0000, 0x0001, 0x0100, 0x00FF,
+                                         0xFF00, 0x0FF0, 0xFFFF};
+  lor_req_s r[N] = {0};
+  for (int i = 0; i < N; i++) {
+    lor_set_unit(&r[i], (lor_unit) (i + 1));
+    lor_set_channels(&r[i], (lor_channel) ((i % 3) * 16),
+                     cbits[i % (sizeof(cbits) / sizeof(cbits[0]))]);
+    const lor_effect_args_u args = {.fade = {1, 240, (lor_decisec) (i * 97)}};
+    lor_set_effect(&r[i], (lor_effect) (i % 8 + 1), &args);
+  }
+
+  lor_unit unit[N];
+  unsigned char effect[N], offset[N], args[N * 4];
+  unsigned short bits[N];
+  lor_req_batch_s batch;
+  lor_batch_init(&batch, unit, effect, offset, bits, args, N);
+  for (int i = 0; i < N; i++) assert(lor_batch_add(&batch, &r[i]) == 0);
+  assert(lor_batch_add(&batch, &r[0]) == -1);
+
+  unsigned char expected[N * LOR_REQ_MAX_SIZE];
+  const size_t total = lor_write(expected, sizeof(expected), r, N);
+  assert(lor_batch_size(&batch) == total);
+  for (size_t bs = 0; bs <= total; bs++) {
+    unsigned char b[N * LOR_REQ_MAX_SIZE];
+    const size_t n = lor_batch_write(b, bs, &batch);
+    assert(n == lor_write(expected, bs, r, N));
+    if (bs == total) assert(memcmp(b, expected, total) == 0);
+  }
+}
+
+/// @brief Tests decoding of encoded requests, heartbeats and invalid data.
+static void test_read(void) {
+  lor_req_s r[8] = {0};
+  lor_set_channels(&r[0], 0, 0xFFFF);
+  lor_set_fade(&r[0], 1, 240, 10);
+  lor_set_fade(&r[1], 240, 1, 0x1234);
+  lor_set_channel(&r[1], 3);
+  lor_set_channels(&r[2], 16, 0x00F0);
+  lor_set_intensity(&r[2], 0x40);
+  lor_set_channels(&r[3], 32, 0xF000);
+  lor_set_effect(&r[3], LOR_SHIMMER, NULL);
+  lor_set_channels(&r[4], 48, 0x0FF0);
+  lor_set_effect(&r[4], LOR_PULSE, &(lor_effect_args_u){.pulse = {5}});
+  lor_set_effect(&r[5], LOR_SET_OFF, NULL);
+  lor_set_channels(&r[6], 0, 0xF000);
+  lor_set_effect(&r[6], LOR_SET_DMX_INTENSITY,
+                 &(lor_effect_args_u){.set_dmx_intensity = {0x7F}});
+  lor_set_channels(&r[7], 0, 0x00F0);
+  lor_set_effect(&r[7], LOR_SET_LIGHTS, NULL);
+  for (int i = 0; i < 8; i++) lor_set_unit(&r[i], (lor_unit) (i + 1));
+
+  unsigned char b[128];
+  const size_t n = lor_write(b, sizeof(b), r, 8);
+
+  // decoding and re-encoding produces identical bytes and requests
+  lor_req_s d[8];
+  size_t dn;
+  assert(lor_read(b, n, d, 8, &dn) == n && dn == 8);
+  for (int i = 0; i < 8; i++) {
+    assert(d[i].unit == r[i].unit && d[i].effect == r[i].effect);
+    assert(d[i].cset.offset == r[i].cset.offset);
+    assert(d[i].cset.cbits == r[i].cset.cbits);
+  }
+  assert(d[0].args.fade.deciseconds == 10);
+  assert(d[1].args.fade.deciseconds == 0x1234);
+  assert(d[4].args.pulse.deciseconds == 5);
+  assert(d[6].args.set_dmx_intensity.output == 0x7F);
+  unsigned char e[128];
+  assert(lor_write(e, sizeof(e), d, 8) == n && memcmp(b, e, n) == 0);
+
+  // heartbeats are skipped and garbage is resynchronized
+  unsigned char s[128] = {0xAA, 0x00, 0x01, 0x0F};
+  size_t h = 4;
+  memcpy(&s[h], LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE);
+  h += LOR_HEARTBEAT_SIZE;
+  h += lor_write(&s[h], sizeof(s) - h, &r[2], 2);
+  assert(lor_read(s, h, d, 8, &dn) == h && dn == 2);
+  assert(d[0].unit == 3 && d[1].unit == 4);
+
+  // an incomplete request at the end of the buffer is not consumed
+  assert(lor_read(b, n - 1, d, 8, &dn) == n - lor_req_size(&r[7]));
+  assert(dn == 7);
+
+  // a unit-wide multipart request ending the buffer is decoded
+  lor_req_s u = {0};
+  lor_set_unit(&u, 9);
+  u.cset = (lor_channel_set){5, 0};
+  lor_set_effect(&u, LOR_SET_OFF, NULL);
+  const size_t un = lor_write(b, sizeof(b), &u, 1);
+  assert(un == 5 && b[3] == (5 | 0x40));
+  assert(lor_read(b, un, d, 8, &dn) == un && dn == 1);
+  assert(d[0].unit == 9 && d[0].cset.offset == 5 && d[0].cset.cbits == 0);
+  assert(lor_read(b, un - 1, d, 8, &dn) == 0 && dn == 0);
+}
+
+/// @brief Example custom intensity conversion function.
+static lor_intensity invert_intensity(const unsigned char b) {
+  return lor_get_intensity(0xFF - b);
+}
+
+/// @brief Tests the intensity conversion tables and batch conversion.
+static void test_intensity(void) {
+  const lor_intensity_fn fns[] = {lor_get_intensity, lor_get_intensity_gamma,
+                                  lor_get_intensity_cie, invert_intensity};
+  unsigned char src[512];
+  for (int i = 0; i < 512; i++) src[i] = (unsigned char) i;
+
+  for (int i = 0; i < 256; i++) {
+    // the linear table matches the original floating point conversion
+    const lor_intensity l = 240 - (lor_intensity) ((1.0f - (i / 255.0f)) * 239);
+    assert(lor_get_intensity((unsigned char) i) == l);
+  }
+  for (int f = 0; f < 4; f++) {
+    const lor_intensity_fn fn = fns[f];
+    assert(fn(f < 3 ? 0x00 : 0xFF) == 1 && fn(f < 3 ? 0xFF : 0x00) == 240);
+
+    lor_intensity dst[512];
+    lor_get_intensities(dst, src, 512, fn);
+    for (int i = 0; i < 512; i++) assert(dst[i] == fn(src[i]));
+    lor_get_intensities(dst, src, 16, fn);
+    for (int i = 0; i < 16; i++) assert(dst[i] == fn(src[i]));
+  }
+  for (int i = 1; i < 256; i++) {
+    assert(lor_get_intensity_gamma(i) >= lor_get_intensity_gamma(i - 1));
+    assert(lor_get_intensity_cie(i) >= lor_get_intensity_cie(i - 1));
+  }
+}
+
+/// @brief Tests the wire time calculations and scheduler admission order.
+static void test_sched(void) {
+  assert(lor_wire_bytes(57600, 50) == 288);
+  assert(lor_wire_bytes(115200, 50) == 576);
+  assert(lor_wire_us(115200, 576) == 50000);
+  assert(lor_wire_us(57600, 1) == 174);
+
+  lor_sched_entry_s e[8];
+  lor_sched_s s;
+  assert(lor_sched_init(&s, e, 8, 9600, 25) == 0);// 24 byte budget
+  assert(s.budget == 24);
+
+  lor_req_s req = {0};
+  lor_set_channel(&req, 0);
+  lor_set_intensity(&req, 0x40);// 7 bytes
+  for (int i = 0; i < 4; i++) {
+    lor_set_unit(&req, (lor_unit) (i + 1));
+    assert(lor_sched_add(&s, &req, i == 3 ? 10 : 0) == 0);
+  }
+
+  // the high priority request is admitted first, then others in order
+  lor_req_s r[8];
+  assert(lor_sched_next(&s, r, 8) == 3);
+  assert(r[0].unit == 1 && r[1].unit == 2 && r[2].unit == 4);
+  assert(lor_write_size(r, 3) <= s.budget);
+
+  // deferred requests gain priority over requests added afterwards
+  lor_set_unit(&req, 5);
+  assert(lor_sched_add(&s, &req, 0) == 0);
+  assert(lor_sched_next(&s, r, 1) == 1 && r[0].unit == 3);
+  assert(lor_sched_next(&s, r, 8) == 1 && r[0].unit == 5);
+  assert(lor_sched_next(&s, r, 8) == 0);
+
+  // reserved bytes reduce the budget of the next frame only
+  for (int i = 0; i < 4; i++) assert(lor_sched_add(&s, &req, 0) == 0);
+  s.reserved = LOR_HEARTBEAT_SIZE * 2;
+  assert(lor_sched_next(&s, r, 8) == 2 && s.reserved == 0);
+  assert(lor_sched_next(&s, r, 8) == 2);
+}
+
+/// @brief Tests superseding, backpressure and draining of an output queue.
+static void test_queue(void) {
+  lor_queue_entry_s e[4];
+  size_t slots[16];
+  lor_queue_s q;
+  assert(lor_queue_init(&q, e, 3, slots, 16) == -1);
+  assert(lor_queue_init(&q, e, 4, slots, 16) == 0);
+
+  lor_req_s r[5] = {0};
+  for (int i = 0; i < 5; i++) lor_set_unit(&r[i], 1);
+  lor_set_channel(&r[0], 0);
+  lor_set_intensity(&r[0], 10);
+  lor_set_channel(&r[1], 1);
+  lor_set_intensity(&r[1], 20);
+  lor_set_channels(&r[2], 0, 0x3);
+  lor_set_intensity(&r[2], 40);
+  r[3] = r[0];
+  lor_set_intensity(&r[3], 50);
+  lor_set_unit(&r[4], 2);
+
+  // a newer request replaces the pending request in place
+  assert(lor_queue_push(&q, &r[0]) == 0);
+  assert(lor_queue_push(&q, &r[1]) == 0);
+  lor_set_intensity(&r[0], 30);
+  assert(lor_queue_push(&q, &r[0]) == 0);
+  assert(q.depth == 2 && q.superseded == 1);
+
+  // unless a later request overlaps it, then it is dropped and re-queued
+  assert(lor_queue_push(&q, &r[2]) == 0);
+  assert(lor_queue_push(&q, &r[3]) == 0);
+  assert(q.depth == 3 && q.superseded == 2);
+  assert(lor_queue_push(&q, &r[4]) == -1 && q.rejected == 1);
+
+  // drained in order, only as many requests as fit
+  unsigned char b[64], expected[64];
+  const size_t n = lor_write(expected, sizeof(expected), &r[1], 3);
+  size_t h = lor_queue_write(&q, b, LOR_REQ_MAX_SIZE);
+  assert(h == lor_req_size(&r[1]) && q.depth == 2);
+  h += lor_queue_write(&q, &b[h], sizeof(b) - h);
+  assert(h == n && memcmp(b, expected, n) == 0);
+  assert(q.depth == 0 && lor_queue_write(&q, b, sizeof(b)) == 0);
+  assert(lor_queue_push(&q, &r[4]) == 0);
+}
+
+/// @brief Tests heartbeat insertion at request boundaries.
+static void test_stream(void) {
+  lor_stream_s s;
+  lor_stream_init(&s, 9600);// 960 bytes per second
+  assert(lor_stream_heartbeat_size(&s, 0, 50) == LOR_HEARTBEAT_SIZE);
+  assert(lor_stream_heartbeat_size(&s, 0, 1000) == 2 * LOR_HEARTBEAT_SIZE);
+
+  lor_req_s r[100] = {0};
+  for (int i = 0; i < 100; i++) {
+    lor_set_unit(&r[i], 1);
+    lor_set_channel(&r[i], i);
+    lor_set_intensity(&r[i], 0x40);// 7 bytes each
+  }
+
+  // a heartbeat is due immediately, and again ~480 bytes into the frame
+  unsigned char b[1024];
+  size_t n;
+  const size_t h = lor_stream_write(&s, 0, b, sizeof(b), r, 100, &n);
+  assert(n == 100 && h == 700 + 2 * LOR_HEARTBEAT_SIZE);
+  assert(memcmp(b, LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE) == 0);
+  const size_t mid = LOR_HEARTBEAT_SIZE + 68 * 7;
+  assert(memcmp(&b[mid], LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE) == 0);
+  assert(s.busy_until == lor_wire_us(9600, h) * 1000ULL);
+
+  // the stream waits for previously written bytes before the next heartbeat
+  assert(lor_stream_write(&s, 0, b, sizeof(b), NULL, 0, &n) == 0);
+  const unsigned long long due = s.next_heartbeat;
+  assert(lor_stream_write(&s, due, b, sizeof(b), NULL, 0, &n) == 5);
+  assert(s.next_heartbeat == due + LOR_HEARTBEAT_DELAY_NS);
+
+  // only whole requests are written
+  assert(lor_stream_write(&s, due, b, 10, r, 100, &n) == 7 && n == 1);
+}
+
+/// @brief Tests frame clock deadlines, missed ticks and jitter histograms.
+static void test_clock(void) {
+  lor_hist_s h = {0};
+  assert(lor_hist_percentile(&h, 99) == 0);
+  for (int i = 0; i < 98; i++) lor_hist_add(&h, 1000);// bucket [960, 1024)
+  lor_hist_add(&h, 0);
+  lor_hist_add(&h, 5000000);
+  assert(h.n == 100 && h.count[0] == 1 && h.count[63] == 98);
+  assert(lor_hist_percentile(&h, 1) == 0);
+  assert(lor_hist_percentile(&h, 99) == 1023);
+  assert(lor_hist_percentile(&h, 100) == 5000000);
+  lor_hist_add(&h, ~0ULL);
+  assert(h.count[LOR_HIST_BUCKETS - 1] == 1);
+
+  // short durations are exact, and every duration lies within its bucket
+  h = (lor_hist_s){0};
+  for (unsigned long long ns = 0; ns < 8; ns++) lor_hist_add(&h, ns);
+  for (int i = 0; i < 8; i++) assert(h.count[i] == 1);
+  for (unsigned long long ns = 1; ns < 1ULL << 32; ns = ns * 3 + 1) {
+    h = (lor_hist_s){0};
+    lor_hist_add(&h, ns);
+    lor_hist_add(&h, ~0ULL);
+    const unsigned long long end = lor_hist_percentile(&h, 50);
+    assert(end >= ns && end - ns <= ns / 8);
+  }
+
+  // sub-millisecond percentiles are resolved
+  h = (lor_hist_s){0};
+  for (int i = 0; i < 99; i++) lor_hist_add(&h, 600000);
+  lor_hist_add(&h, 2000000);
+  assert(lor_hist_percentile(&h, 99) == 655359);
+
+  // 40 Hz, ticks are due at absolute multiples of the period
+  const unsigned long long ms = 1000000;
+  lor_clock_s c;
+  assert(lor_clock_init(&c, 0, 0) == -1);
+  assert(lor_clock_init(&c, 1000 * ms, 25 * ms) == 0);
+  assert(lor_clock_tick(&c, 1000 * ms) == 0 && c.next == 1025 * ms);
+  lor_clock_done(&c, 1004 * ms);
+  assert(lor_clock_tick(&c, 1024 * ms) == -1);
+  assert(lor_clock_tick(&c, 1026 * ms) == 0 && c.next == 1050 * ms);
+
+  // a tick started over a period late skips the missed deadlines
+  assert(lor_clock_tick(&c, 1110 * ms) == 2 && c.next == 1125 * ms);
+  assert(c.ticks == 3 && c.missed == 2);
+  assert(c.jitter.n == 3 && c.jitter.max == 60 * ms);
+  assert(c.encode.n == 1 && c.encode.max == 4 * ms);
+}
+
+/// @brief Tests compiling and playing back a show.
+static void test_show(void) {
+  lor_req_s r[6] = {0};
+  for (int i = 0; i < 6; i++) {
+    lor_set_unit(&r[i], 1);
+    lor_set_channel(&r[i], i);
+    lor_set_intensity(&r[i], (lor_intensity) (i + 1));
+  }
+  const size_t rc[4] = {1, 0, 2, 3};
+
+  const size_t n = lor_show_compile(NULL, 0, r, rc, 4, 50);
+  assert(n == LOR_SHOW_HEADER_SIZE + 5 * 4 + lor_write_size(r, 6));
+  unsigned char b[256];
+  assert(lor_show_compile(b, sizeof(b), r, rc, 4, 50) == n);
+
+  lor_show_s show;
+  assert(lor_show_open(&show, b, n) == 0);
+  assert(show.frames == 4 && show.period_ms == 50);
+  size_t k = 0;
+  for (unsigned long i = 0; i < 4; k += rc[i++]) {
+    unsigned char e[64];
+    size_t fs;
+    const unsigned char* f = lor_show_frame(&show, i, &fs);
+    assert(fs == lor_write(e, sizeof(e), &r[k], rc[i]));
+    assert(memcmp(f, e, fs) == 0);
+  }
+
+  // truncated or corrupt data is rejected
+  assert(lor_show_open(&show, b, n - 1) == -1);
+  assert(lor_show_open(&show, b, LOR_SHOW_HEADER_SIZE) == -1);
+  b[0] = 'X';
+  assert(lor_show_open(&show, b, n) == -1);
+}
+
+/// @brief Tests the encoded request cache against lor_write.
+static void test_cache(void) {
+  lor_cache_entry_s e[64];
+  lor_cache_s c;
+  assert(lor_cache_init(&c, e, 48) == -1);
+  assert(lor_cache_init(&c, e, 64) == 0);
+
+  lor_req_s r[4] = {0};
+  lor_set_fade(&r[0], 1, 240, 10);
+  lor_set_fade(&r[1], 1, 240, 20);// differs only by duration
+  lor_set_channels(&r[2], 0, 0xFFFF);
+  lor_set_effect(&r[2], LOR_SET_OFF, NULL);
+  r[3] = r[0];
+
+  unsigned char b[64], expected[64];
+  const size_t n = lor_write(expected, sizeof(expected), r, 4);
+  for (int pass = 0; pass < 2; pass++) {
+    assert(lor_cache_write(&c, b, sizeof(b), r, 4) == n);
+    assert(memcmp(b, expected, n) == 0);
+  }
+  assert(c.misses + c.hits == 8 && c.misses - c.evictions == 3);
+  assert(lor_cache_write(&c, b, n - 1, r, 4) == lor_req_size(&r[3]));
+}
+
+/// @brief Tests writing requests through a ring smaller than the requests.
+static void test_ring(void) {
+  unsigned char storage[16];
+  lor_ring_s ring;
+  assert(lor_ring_init(&ring, storage, 12) == -1);
+  assert(lor_ring_init(&ring, storage, 16) == 0);
+
+  lor_req_s r[8] = {0};
+  for (int i = 0; i < 8; i++) {
+    lor_set_unit(&r[i], (lor_unit) (i + 1));
+    lor_set_channel(&r[i], i);
+    lor_set_intensity(&r[i], 0x40);// 7 bytes each
+  }
+  unsigned char expected[64], b[64];
+  const size_t n = lor_write(expected, sizeof(expected), r, 8);
+
+  // the consumer's reads reassemble the requests, including wrapped requests
+  size_t h = 0, i = 0;
+  while (h < n) {
+    i += lor_ring_write(&ring, &r[i], 8 - i);
+    size_t avail;
+    const unsigned char* p = lor_ring_read(&ring, &avail);
+    assert(avail > 0);
+    memcpy(&b[h], p, avail);
+    h += avail;
+    lor_ring_release(&ring, avail);
+  }
+  assert(h == n && i == 8 && memcmp(b, expected, n) == 0);
+}
+
+/// @brief Tests partitioning requests by network.
+static void test_shard(void) {
+  unsigned char net[256];
+  memset(net, 0xFF, sizeof(net));// unpatched units are dropped
+  net[1] = net[3] = 0;
+  net[2] = 1;
+  lor_req_s r[5] = {0}, out[8];
+  const lor_unit units[5] = {1, 2, 0xFF, 3, 4};
+  for (int i = 0; i < 5; i++) {
+    lor_set_unit(&r[i], units[i]);
+    lor_set_channel(&r[i], i);
+  }
+
+  size_t first[3];
+  memset(out, 0, sizeof(out));
+  assert(lor_shard(r, 5, net, 2, out, 4, first) == 5);// too small
+  assert(out[0].unit == 0);
+  assert(lor_shard(r, 5, net, 2, out, 8, first) == 5);
+  assert(first[0] == 0 && first[1] == 3 && first[2] == 5);
+  // order is kept within each network, broadcasts are copied to both
+  assert(out[0].unit == 1 && out[1].unit == 0xFF && out[2].unit == 3);
+  assert(out[3].unit == 2 && out[4].unit == 0xFF);
+  assert(out[4].cset.cbits == r[2].cset.cbits);
+}
+
+/// @brief Tests parsing E1.31 packets and their sequence numbers.
+static void test_e131(void) {
+  unsigned char slots[LOR_DMX_SLOTS], b[LOR_E131_MAX_SIZE];
+  for (int i = 0; i < LOR_DMX_SLOTS; i++) slots[i] = (unsigned char) i;
+  const size_t n = lor_e131_build(b, sizeof(b), 7, 42, slots, LOR_DMX_SLOTS);
+  assert(n == LOR_E131_MAX_SIZE);
+  assert(!lor_e131_build(b, n - 1, 7, 42, slots, LOR_DMX_SLOTS));// too small
+  assert(!lor_e131_build(b, n, 7, 42, slots, LOR_DMX_SLOTS + 1));
+
+  lor_e131_s p;
+  assert(lor_e131_parse(&p, b, n) == 0);
+  assert(p.universe == 7 && p.sequence == 42 && p.priority == 100);
+  assert(p.start_code == 0 && p.n == LOR_DMX_SLOTS && p.slots == &b[126]);
+  assert(lor_e131_parse(&p, b, 125) == -1);// truncated
+  b[4] = 'X';
+  assert(lor_e131_parse(&p, b, n) == -1);// not an ACN packet
+
+  assert(lor_e131_sequence_ok(42, 43) && lor_e131_sequence_ok(255, 0));
+  assert(!lor_e131_sequence_ok(42, 42) && !lor_e131_sequence_ok(42, 30));
+  assert(lor_e131_sequence_ok(42, 10));// far behind, likely a restart
+}
+
+#ifdef TINYLOR_STATS
+/// @brief Example statistics hook counting encoded bytes.
+static void count_bytes(const lor_req_s* req, const size_t size, void* ctx) {
+  (void) req;
+  *(size_t*) ctx += size;
+}
+
+/// @brief Tests the encoder statistics and hook.
+static void test_stats(void) {
+  lor_req_s r[3] = {0};
+  lor_set_channels(&r[0], 0, 0xFFFF);
+  lor_set_fade(&r[0], 1, 240, 10);
+  lor_set_channels(&r[1], 32, 0x00FF);
+  lor_set_effect(&r[1], LOR_TWINKLE, NULL);
+  lor_set_channel(&r[2], 3);
+  lor_set_effect(&r[2], LOR_TWINKLE, NULL);
+
+  size_t hooked = 0;
+  lor_stats_reset();
+  lor_stats_hook(count_bytes, &hooked);
+  unsigned char b[64];
+  const size_t n = lor_write(b, sizeof(b), r, 3);
+  assert(lor_write(b, 4, r, 3) == lor_req_size(&r[0]));
+  assert(lor_write(b, lor_req_size(&r[0]), r, 3) == lor_req_size(&r[1]));
+  lor_stats_hook(NULL, NULL);
+
+  lor_stats_s s;
+  lor_stats_get(&s);
+  assert(s.requests == 4 && s.bytes == n + lor_req_size(&r[0]));
+  assert(hooked == s.bytes);
+  assert(s.batches == 3 && s.overflows == 3 + 2);
+  assert(s.effects[LOR_FADE] == 2 && s.effects[LOR_TWINKLE] == 2);
+  assert(s.formats[LOR_FMT_16 >> 4] == 2);
+  assert(s.formats[LOR_FMT_MULTIPART >> 4] == 1);
+  assert(s.formats[LOR_FMT_SINGLE >> 4] == 1);
+
+  lor_stats_reset();
+  lor_stats_get(&s);
+  assert(s.requests == 0 && s.bytes == 0);
+}
+#endif
+
+#ifdef TINYLOR_POSIX
+/// @brief Tests bridging E1.31 packets received over loopback into requests.
+static void test_e131_loopback(void) {
+  const int rx = socket(AF_INET, SOCK_DGRAM, 0);
+  const int tx = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(rx >= 0 && tx >= 0);
+  struct sockaddr_in addr = {.sin_family = AF_INET};
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  assert(!bind(rx, (struct sockaddr*) &addr, len));
+  assert(!getsockname(rx, (struct sockaddr*) &addr, &len));
+
+  // the sender stand-in sets the first 16 slots to full intensity
+  unsigned char slots[32] = {0}, b[638];
+  memset(slots, 0xFF, 16);
+  const size_t n = lor_e131_build(b, sizeof(b), 1, 1, slots, sizeof(slots));
+  assert(sendto(tx, b, n, 0, (struct sockaddr*) &addr, len) == (ssize_t) n);
+
+  unsigned char rb[638];
+  const ssize_t rn = recv(rx, rb, sizeof(rb), 0);
+  lor_e131_s p;
+  assert(rn == (ssize_t) n && !lor_e131_parse(&p, rb, (size_t) rn));
+
+  lor_intensity storage[2 * 32];
+  lor_frame_s f;
+  lor_frame_init(&f, storage, 1, 1, 32);
+  lor_dmx_map_s map[LOR_DMX_SLOTS] = {0};
+  for (int i = 0; i < 32; i++) map[i] = (lor_dmx_map_s){1, (lor_channel) i};
+  lor_dmx_s d;
+  lor_dmx_init(&d, map, &f);
+  assert(lor_dmx_update(&d, p.slots, p.n) == 32);
+
+  lor_req_s r[4];
+  assert(lor_frame_diff(&f, r, 4) == 2);
+  assert(r[0].cset.cbits == 0xFFFF && r[1].cset.offset == 1);
+
+  close(tx);
+  close(rx);
+}
+
+/// @brief The requests written by the ring producer thread.
+typedef struct ring_job {
+  lor_ring_s* ring;
+  const lor_req_s* r;
+  size_t rs;
+} ring_job;
+
+/// @brief Writes every request of the job to its ring, retrying while full.
+static void* ring_producer(void* arg) {
+  const ring_job* const job = arg;
+  for (size_t i = 0; i < job->rs;) {
+    const size_t w = lor_ring_write(job->ring, &job->r[i], job->rs - i);
+    if (!w) sched_yield();
+    i += w;
+  }
+  return NULL;
+}
+
+/// @brief Tests a ring shared by a producer and a consumer thread.
+static void test_ring_threads(void) {
+  enum { N = 20000 };
+  static lor_req_s r[N];
+  static unsigned char expected[N * LOR_REQ_MAX_SIZE], b[N * LOR_REQ_MAX_SIZE];
+  for (int i = 0; i < N; i++) {
+    r[i] = (lor_req_s){0};
+    lor_set_unit(&r[i], (lor_unit) (i % 240 + 1));
+    lor_set_channels(&r[i], (lor_channel) (i % 1024),
+                     (unsigned short) (i * 2654435761u >> 16));
+    lor_set_fade(&r[i], 1, (lor_intensity) i, (lor_decisec) i);
+    if (i % 3) lor_set_intensity(&r[i], (lor_intensity) i);
+  }
+  const size_t n = lor_write(expected, sizeof(expected), r, N);
+
+  unsigned char storage[64];
+  lor_ring_s ring;
+  lor_ring_init(&ring, storage, sizeof(storage));
+  ring_job job = {&ring, r, N};
+  pthread_t t;
+  assert(pthread_create(&t, NULL, ring_producer, &job) == 0);
+  size_t h = 0;
+  while (h < n) {
+    size_t avail;
+    const unsigned char* p = lor_ring_read(&ring, &avail);
+    if (!avail) {
+      sched_yield();
+      continue;
+    }
+    assert(h + avail <= n);
+    memcpy(&b[h], p, avail);
+    h += avail;
+    lor_ring_release(&ring, avail);
+  }
+  assert(pthread_join(t, NULL) == 0);
+  assert(memcmp(b, expected, n) == 0);
+}
+
+#ifdef TINYLOR_THREADS
+/// @brief Tests writing frames of several networks from their own threads.
+static void test_net(void) {
+  enum { NETS = 4, UNITS = 16, FRAMES = 3 };
+  unsigned char net[256] = {0};
+  lor_req_s r[UNITS * 4] = {0}, out[UNITS * 4];
+  for (int i = 0; i < UNITS * 4; i++) {
+    lor_set_unit(&r[i], (lor_unit) (i % UNITS + 1));
+    lor_set_channels(&r[i], (lor_channel) (i / UNITS), (unsigned short) i);
+    lor_set_intensity(&r[i], (lor_intensity) i);
+    net[i % UNITS + 1] = (unsigned char) (i % NETS);
+  }
+  size_t first[NETS + 1];
+  assert(lor_shard(r, UNITS * 4, net, NETS, out, UNITS * 4, first) ==
+         UNITS * 4);
+
+  // rings smaller than a frame make the encoders wait for the writers
+  static unsigned char storage[NETS][16];
+  lor_net_s n[NETS];
+  int fds[NETS][2];
+  for (int k = 0; k < NETS; k++) {
+    assert(!pipe(fds[k]));
+    assert(!lor_net_start(&n[k], fds[k][1], storage[k], sizeof(storage[k])));
+  }
+  for (int f = 0; f < FRAMES; f++)
+    for (int k = 0; k < NETS; k++)
+      assert(!lor_net_submit(&n[k], &out[first[k]], first[k + 1] - first[k]));
+  for (int k = 0; k < NETS; k++) assert(!lor_net_stop(&n[k]));
+
+  for (int k = 0; k < NETS; k++) {
+    unsigned char expected[FRAMES * UNITS * LOR_REQ_MAX_SIZE], b[1024];
+    size_t h = 0;
+    for (int f = 0; f < FRAMES; f++)
+      h += lor_write(&expected[h], sizeof(expected) - h, &out[first[k]],
+                     first[k + 1] - first[k]);
+    close(fds[k][1]);
+    size_t got = 0;
+    for (ssize_t w; (w = read(fds[k][0], &b[got], sizeof(b) - got)) > 0;)
+      got += (size_t) w;
+    assert(got == h && memcmp(b, expected, h) == 0);
+    close(fds[k][0]);
+  }
+
+  // a failed write is reported once the network stops
+  const int full = open("/dev/full", O_WRONLY);
+  if (full >= 0) {
+    assert(!lor_net_start(&n[0], full, storage[0], sizeof(storage[0])));
+    assert(!lor_net_submit(&n[0], r, UNITS * 4));
+    assert(lor_net_stop(&n[0]) == -1 && errno == ENOSPC);
+    close(full);
+  }
+}
+#endif
+
+/// @brief Tests playing a compiled show file mapped into memory.
+static void test_show_play(void) {
+  lor_req_s r[6] = {0};
+  for (int i = 0; i < 6; i++) {
+    lor_set_unit(&r[i], 2);
+    lor_set_channel(&r[i], i);
+    lor_set_intensity(&r[i], (lor_intensity) (i + 1));
+  }
+  const size_t rc[4] = {1, 0, 2, 3};
+  unsigned char b[256];
+  const size_t n = lor_show_compile(b, sizeof(b), r, rc, 4, 2);
+
+  char path[] = "/tmp/tinylor_show_XXXXXX";
+  const int file = mkstemp(path);
+  assert(file >= 0 && write(file, b, n) == (ssize_t) n);
+  close(file);
+  lor_show_s show;
+  assert(lor_show_map(&show, path) == 0);
+  assert(show.frames == 4 && show.b != b);
+
+  // a heartbeat, then every frame (the empty frame sends nothing)
+  int fds[2];
+  assert(!pipe(fds));
+  const long skipped = lor_show_play(fds[1], &show, 0);
+  assert(skipped >= 0);
+  lor_show_unmap(&show);
+  close(fds[1]);
+  unsigned char expected[256], got[256];
+  memcpy(expected, LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE);
+  const size_t e = LOR_HEARTBEAT_SIZE +
+                   lor_write(&expected[LOR_HEARTBEAT_SIZE], 200, r, 6);
+  size_t h = 0;
+  for (ssize_t w; (w = read(fds[0], &got[h], sizeof(got) - h)) > 0;)
+    h += (size_t) w;
+  close(fds[0]);
+  // frames are only skipped if the host stalls for a whole period
+  if (!skipped) assert(h == e && memcmp(got, expected, e) == 0);
+  assert(h > LOR_HEARTBEAT_SIZE);
+  assert(memcmp(got, expected, LOR_HEARTBEAT_SIZE) == 0);
+
+  // a file which is not a compiled show is rejected
+  const int bad = open(path, O_WRONLY | O_TRUNC);
+  assert(bad >= 0 && write(bad, "LORS", 4) == 4);
+  close(bad);
+  assert(lor_show_map(&show, path) == -1 && errno == EINVAL);
+  unlink(path);
+}
+
+/// @brief Tests sleeping until frame clock deadlines.
+static void test_clock_wait(void) {
+  lor_clock_s c;
+  const unsigned long long start = lor_clock_now();
+  lor_clock_init(&c, start, 2000000);
+  long skipped = 0;
+  for (int i = 0; i < 5; i++) {
+    const long n = lor_clock_wait(&c);
+    assert(n >= 0);
+    skipped += n;
+    lor_clock_done(&c, lor_clock_now());
+  }
+  // the fifth tick is never earlier than four periods after the first
+  assert(lor_clock_now() >= start + 4 * c.period);
+  assert(c.ticks == 5 && c.missed == (unsigned long) skipped);
+  assert(c.encode.n == 5);
+}
+
+/// @brief Tests sending frames to a pseudo terminal pair.
+static void test_serial(void) {
+  const int master = posix_openpt(O_RDWR | O_NOCTTY);
+  assert(master >= 0 && !grantpt(master) && !unlockpt(master));
+  const int fd = lor_serial_open(ptsname(master), 115200);
+  assert(fd >= 0);
+  assert(lor_serial_configure(fd, 1234) == -1);// unsupported baud rate
+#ifdef CRTSCTS
+  struct termios t;
+  assert(!tcgetattr(fd, &t) && !(t.c_cflag & CRTSCTS));
+#endif
+
+  lor_req_s r[16] = {0};
+  for (int i = 0; i < 16; i++) {
+    lor_set_unit(&r[i], 1);
+    lor_set_channel(&r[i], i);
+    lor_set_intensity(&r[i], lor_get_intensity(i * 16));
+  }
+  unsigned char b[256], expected[256];
+  const size_t n = lor_write(expected, sizeof(expected), r, 16);
+  assert(lor_serial_write(fd, b, n - 1, r, 16, 1000) == -1);
+  assert(lor_serial_write(fd, b, sizeof(b), r, 16, 1000) == (long) n);
+
+  // heartbeat and frame buffers are sent together
+  struct iovec iov[2] = {{LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE},
+                         {expected, n}};
+  assert(lor_serial_send(fd, iov, 2, 1000) == (long) (LOR_HEARTBEAT_SIZE + n));
+  assert(!iov[0].iov_len && !iov[1].iov_len);
+
+  unsigned char rb[512];
+  size_t h = 0;
+  while (h < 2 * n + LOR_HEARTBEAT_SIZE) {
+    const ssize_t w = read(master, &rb[h], sizeof(rb) - h);
+    assert(w > 0);
+    h += (size_t) w;
+  }
+  assert(memcmp(rb, expected, n) == 0);
+  assert(memcmp(&rb[n], LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE) == 0);
+  assert(memcmp(&rb[n + LOR_HEARTBEAT_SIZE], expected, n) == 0);
+
+  close(fd);
+  close(master);
+}
+#endif
+
+/// @brief Tests translating DMX universes into frame changes.
+static void test_dmx(void) {
+  lor_intensity storage[2 * 2 * 32];
+  lor_frame_s f;
+  lor_frame_init(&f, storage, 1, 2, 32);
+
+  // patch slots 0-15 to unit 1 channels 0-15 and slot 100 to unit 2 channel 4
+  lor_dmx_map_s map[LOR_DMX_SLOTS] = {0};
+  for (int i = 0; i < 16; i++) map[i] = (lor_dmx_map_s){1, (lor_channel) i};
+  map[100] = (lor_dmx_map_s){2, 4};
+
+  lor_dmx_s d;
+  lor_dmx_init(&d, map, &f);
+  unsigned char u[LOR_DMX_SLOTS] = {0};
+  memset(u, 0xFF, 16);
+  assert(lor_dmx_update(&d, u, LOR_DMX_SLOTS) == 17);
+
+  lor_req_s r[8];
+  assert(lor_frame_diff(&f, r, 8) == 2);
+  assert(r[0].unit == 1 && r[0].cset.cbits == 0xFFFF);
+  assert(r[1].unit == 2 && r[1].cset.cbits == 0x10);
+
+  // only changed slots are written, unpatched slots are ignored
+  assert(lor_dmx_update(&d, u, LOR_DMX_SLOTS) == 0);
+  u[3] = 0x80;
+  u[200] = 0x80;
+  assert(lor_dmx_update(&d, u, LOR_DMX_SLOTS) == 1);
+  assert(lor_frame_diff(&f, r, 8) == 1 && r[0].cset.cbits == 0x8);
+}
+
+/// @brief Tests logical channel translation and grouped patch ordering.
+static void test_patch(void) {
+  // logical channels 0-19 patched in reverse to unit 2 channels 0-19, logical
+  // channel 30 patched to unit 1 channel 40, logical channels 20-29 unpatched
+  lor_patch_entry_s e[21];
+  for (int i = 0; i < 20; i++)
+    e[i] = (lor_patch_entry_s){(unsigned long) (19 - i),
+                               {2, (lor_channel) i}};
+  e[20] = (lor_patch_entry_s){30, {1, 40}};
+
+  lor_addr_s index[32];
+  lor_patch_bank_s banks[21];
+  lor_patch_s p;
+  assert(lor_patch_init(&p, index, 32, banks, e, 21) == 0);
+  assert(lor_patch_get(&p, 25) == NULL && lor_patch_get(&p, 32) == NULL);
+  assert(lor_patch_get(&p, 30)->unit == 1);
+  assert(lor_patch_get(&p, 30)->channel == 40);
+  assert(lor_patch_get(&p, 0)->unit == 2);
+  assert(lor_patch_get(&p, 0)->channel == 19);
+
+  // banks ordered by unit then offset, entries ordered by channel
+  assert(p.bs == 3);
+  assert(banks[0].unit == 1 && banks[0].cset.offset == 2);
+  assert(banks[0].cset.cbits == 0x0100 && banks[0].count == 1);
+  assert(banks[1].unit == 2 && banks[1].cset.offset == 0);
+  assert(banks[1].cset.cbits == 0xFFFF && banks[1].first == 1);
+  assert(banks[2].cset.cbits == 0x000F && banks[2].count == 4);
+  for (size_t i = 1; i < 21; i++) assert(e[i].addr.channel == i - 1);
+
+  // logical values are written to the frame and grouped into channel sets
+  lor_intensity storage[2 * 2 * 64];
+  lor_frame_s f;
+  lor_frame_init(&f, storage, 1, 2, 64);
+  unsigned char v[32];
+  memset(v, 0xFF, sizeof(v));
+  assert(lor_patch_update(&p, &f, v) == 21);
+  lor_req_s r[8];
+  assert(lor_frame_diff(&f, r, 8) == 3);
+  assert(r[1].unit == 2 && r[1].cset.cbits == 0xFFFF);
+
+  // duplicate logical channels and invalid addresses are rejected
+  e[1] = (lor_patch_entry_s){30, {1, 1}};
+  assert(lor_patch_init(&p, index, 32, banks, e, 21) == -1);
+  e[0] = (lor_patch_entry_s){0, {1, 1024}};
+  assert(lor_patch_init(&p, index, 32, banks, e, 1) == -1);
+}
+
+/// @brief Tests replacing linear intensity ramps with hardware fades.
+static void test_fit_fades(void) {
+  // hold at 40, ramp to 240 over 1 second (20 frames of 50ms), hold, step down
+  lor_intensity t[40];
+  for (int i = 0; i < 40; i++) {
+    if (i < 5) t[i] = 40;
+    else if (i <= 25) t[i] = (lor_intensity) (40 + (i - 5) * 10);
+    else if (i < 30) t[i] = 240;
+    else t[i] = 100;
+  }
+  t[15] += 2;// within tolerance of the ramp
+
+  lor_req_s target = {0};
+  lor_set_unit(&target, 3);
+  lor_set_channel(&target, 7);
+
+  lor_event_s e[40];
+  const size_t n = lor_fit_fades(t, 40, 50, 2, &target, e, 40);
+  assert(n == 3);
+  assert(e[0].frame == 0 && e[0].req.effect == LOR_SET_INTENSITY);
+  assert(e[1].frame == 5 && e[1].req.effect == LOR_FADE);
+  assert(e[1].req.args.fade.start_intensity == 40);
+  assert(e[1].req.args.fade.end_intensity == 240);
+  assert(e[1].req.args.fade.deciseconds == 10);
+  assert(e[1].req.unit == 3 && e[1].req.cset.cbits == target.cset.cbits);
+  assert(e[2].frame == 30 && e[2].req.args.set_intensity.intensity == 100);
+
+  // without tolerance the disturbed frame splits the ramp
+  assert(lor_fit_fades(t, 40, 50, 0, &target, e, 40) > 3);
+
+  // a ramp whose rounded fade misses its intensities is not a fade
+  const lor_intensity odd[4] = {10, 20, 30, 30};
+  assert(lor_fit_fades(odd, 4, 75, 0, &target, e, 40) == 3);
+  assert(e[0].req.effect == LOR_SET_INTENSITY);
+
+  // 30 fps: 30 frames of 33 ms are faded over 10 deciseconds
+  lor_intensity t30[40];
+  for (int i = 0; i < 40; i++)
+    t30[i] = (lor_intensity) (i <= 30 ? 30 + i * 6 : 210);
+  assert(lor_fit_fades(t30, 40, 33, 2, &target, e, 40) == 1);
+  assert(e[0].frame == 0 && e[0].req.effect == LOR_FADE);
+  assert(e[0].req.args.fade.start_intensity == 30);
+  assert(e[0].req.args.fade.end_intensity == 210);
+  assert(e[0].req.args.fade.deciseconds == 10);
+  // the 10 ms rounding error leaves the fade 1.8 from the last intensities
+  assert(lor_fit_fades(t30, 40, 33, 1, &target, e, 40) > 1);
+
+  // a fade rounded down (140 ms to 1 decisecond) holds its end intensity for
+  // the frames past 100 ms, which must be within tolerance of it
+  const lor_intensity early[6] = {40, 47, 54, 69, 60, 60};
+  assert(lor_fit_fades(early, 6, 35, 8, &target, e, 40) > 1);
+  assert(lor_fit_fades(early, 6, 35, 9, &target, e, 40) == 1);
+  assert(e[0].req.args.fade.deciseconds == 1);
+}
+
+/// @brief Tests folding identical requests across units into a broadcast.
+static void test_fold_broadcast(void) {
+  const lor_unit units[4] = {1, 2, 3, 4};
+  lor_req_s r[6] = {0}, out[6];
+  size_t tmp[6];
+  for (int i = 0; i < 4; i++) {
+    lor_set_unit(&r[i], units[i]);
+    lor_set_channels(&r[i], 0, 0xFFFF);
+    lor_set_effect(&r[i], LOR_SET_OFF, NULL);
+  }
+  lor_set_intensity(&r[1], 0x80);// unit 2 is an exception
+  lor_set_unit(&r[4], 2);
+  lor_set_channel(&r[4], 20);// unrelated channels are kept
+  lor_set_intensity(&r[4], 0x40);
+
+  size_t n = lor_fold_broadcast(r, 5, units, 4, tmp, out);
+  assert(n == 3);
+  assert(out[0].unit == 0xFF && out[0].effect == LOR_SET_OFF);
+  assert(out[0].cset.cbits == 0xFFFF);
+  assert(out[1].unit == 2 && out[1].effect == LOR_SET_INTENSITY);
+  assert(out[2].unit == 2 && out[2].cset.offset == 1);
+
+  // a unit of the network without a request for the channels prevents folding
+  const lor_unit more[5] = {1, 2, 3, 4, 5};
+  assert(lor_fold_broadcast(r, 5, more, 5, tmp, out) == 5);
+
+  // as does another request to any of the same channels
+  lor_set_channel(&r[4], 3);
+  assert(lor_fold_broadcast(r, 5, units, 4, tmp, out) == 5);
+}
+
+/// @brief Tests compile-time encoded requests against lor_write.
+static void test_static_bytes(void) {
+  static const unsigned char expected[] = {
+          LOR_BYTES_REQ(16, 3, LOR_SET_OFF, 0, 0xFFFF),
+          LOR_BYTES_REQ(UNIT, 0xFF, LOR_SET_LIGHTS, 0, 0),
+          LOR_BYTES_REQ_ARGS(HIGH, 1, LOR_FADE, 2, 0x0F00,
+                             LOR_BYTES_FADE(1, 240, 10)),
+          LOR_BYTES_REQ_ARGS(LOW, 1, LOR_FADE, 0, 0x0008,
+                             LOR_BYTES_FADE(240, 1, 0x1200)),
+          LOR_BYTES_REQ_ARGS(LOW, 4, LOR_SET_INTENSITY, 5, 0x00F0,
+                             LOR_BYTES_INTENSITY(0x40)),
+          LOR_BYTES_REQ_ARGS(HIGH, 4, LOR_PULSE, 0, 0x8000,
+                             LOR_BYTES_PULSE(5)),
+          LOR_BYTES_REQ(WIDE, 2, LOR_TWINKLE, 7, 0),
+  };
+  // the piecewise macros produce the same bytes
+  static const unsigned char piecewise[] = {
+          LOR_BYTES_HEAD(3, LOR_SET_OFF, 0, 0xFFFF),
+          LOR_BYTES_CSET_16(0, 0xFFFF),
+          LOR_BYTES_END,
+          LOR_BYTES_HEAD(0xFF, LOR_SET_LIGHTS, 0, 0),
+          LOR_BYTES_CSET_UNIT,
+          LOR_BYTES_END,
+  };
+  assert(memcmp(piecewise, expected, sizeof(piecewise)) == 0);
+
+  lor_req_s r[7] = {0};
+  lor_set_unit(&r[0], 3);
+  lor_set_channels(&r[0], 0, 0xFFFF);
+  lor_set_effect(&r[0], LOR_SET_OFF, NULL);
+  lor_set_unit(&r[1], 0xFF);
+  lor_set_effect(&r[1], LOR_SET_LIGHTS, NULL);
+  lor_set_unit(&r[2], 1);
+  lor_set_channels(&r[2], 32, 0x0F00);
+  lor_set_fade(&r[2], 1, 240, 10);
+  lor_set_unit(&r[3], 1);
+  lor_set_channel(&r[3], 3);
+  lor_set_fade(&r[3], 240, 1, 0x1200);
+  lor_set_unit(&r[4], 4);
+  lor_set_channels(&r[4], 80, 0x00F0);
+  lor_set_intensity(&r[4], 0x40);
+  lor_set_unit(&r[5], 4);
+  lor_set_channel(&r[5], 15);
+  lor_set_effect(&r[5], LOR_PULSE, &(lor_effect_args_u){.pulse = {5}});
+  lor_set_unit(&r[6], 2);
+  r[6].cset = (lor_channel_set){7, 0};
+  lor_set_effect(&r[6], LOR_TWINKLE, NULL);
+
+  unsigned char b[128];
+  assert(lor_write(b, sizeof(b), r, 7) == sizeof(expected));
+  assert(memcmp(b, expected, sizeof(expected)) == 0);
+
+  // the constant expression format matches the encoded format of every set
+  for (unsigned long cbits = 0; cbits <= 0xFFFF; cbits++) {
+    for (unsigned char off = 0; off < 2; off++) {
+      lor_req_s req = {.effect = LOR_SET_OFF, .cset = {off, cbits}};
+      lor_write(b, sizeof(b), &req, 1);
+      assert((b[2] & 0xF0) == (int) LOR_CSET_FORMAT(off, cbits));
+    }
+  }
+}
+
 int main(void) {
   test_channel_format_header(0x00FF, LOR_FMT_8L);
   test_channel_format_header(0xFF00, LOR_FMT_8H);
@@ -57,5 +1247,42 @@ int main(void) {
   test_channel_alignment(4, 0x000F, (lor_channel_set){0, 0x00F0});
   test_channel_alignment(8, 0x00FF, (lor_channel_set){0, 0xFF00});
 
+  test_frame_diff();
+  test_dirty();
+  test_coalesce();
+  test_fold_broadcast();
+  test_static_bytes();
+  test_write_size();
+  test_encoder();
+  test_chunk();
+  test_batch();
+  test_read();
+  test_intensity();
+  test_sched();
+  test_queue();
+  test_stream();
+  test_clock();
+  test_show();
+  test_cache();
+  test_ring();
+  test_shard();
+  test_dmx();
+  test_patch();
+  test_e131();
+  test_fit_fades();
+#ifdef TINYLOR_STATS
+  test_stats();
+#endif
+#ifdef TINYLOR_POSIX
+  test_e131_loopback();
+  test_ring_threads();
+#ifdef TINYLOR_THREADS
+  test_net();
+#endif
+  test_clock_wait();
+  test_show_play();
+  test_serial();
+#endif
+
   return 0;
 }
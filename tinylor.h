@@ -13,6 +13,13 @@
 
 #include <stddef.h>
 
+#ifdef TINYLOR_POSIX
+#include <sys/uio.h>
+#ifdef TINYLOR_THREADS
+#include <pthread.h>
+#endif
+#endif
+
 /// @typedef lor_channel
 /// @brief Represents a channel number, which is a unique identifier for a
 ///        specific light or group of lights. Channels are typically in the
@@ -131,6 +138,135 @@ typedef union lor_effect_data {
 /// @brief The intended delay in nanoseconds between sending LOR heartbeats.
 #define LOR_HEARTBEAT_DELAY_NS 500000000
 
+/// @def LOR_REQ_MAX_SIZE
+/// @brief The maximum number of bytes a single request encodes to.
+#define LOR_REQ_MAX_SIZE 11
+
+/// @def LOR_CSET_FORMAT
+/// @brief Constant expression equivalent of the channel set format selected
+///        when encoding a channel set of offset \p off and bitset \p cbits.
+#define LOR_CSET_FORMAT(off, cbits)                                            \
+  ((off)                               ? LOR_FMT_MULTIPART                     \
+   : !(cbits)                          ? LOR_FMT_UNIT                          \
+   : !((cbits) & ((cbits) - 1))        ? LOR_FMT_SINGLE                        \
+   : ((cbits) & 0xFF) && (cbits) >> 8  ? LOR_FMT_16                            \
+   : ((cbits) & 0xFF)                  ? LOR_FMT_8L                            \
+                                       : LOR_FMT_8H)
+
+/// @def LOR_BYTES_CHECK_
+/// @brief Evaluates to zero if \p cond is true, otherwise fails to compile.
+#define LOR_BYTES_CHECK_(cond) (0 * sizeof(char[(cond) ? 1 : -1]))
+
+/// @def LOR_BYTES_HEAD
+/// @brief Compile-time encoding of a request header. Compile-time encoded
+///        requests are written as the concatenation of LOR_BYTES_HEAD, the
+///        effect arguments (if any, e.g. LOR_BYTES_FADE), the channel set
+///        (one of the LOR_BYTES_CSET_* macros) and LOR_BYTES_END, producing
+///        the same bytes as lor_write. All arguments must be constants.
+/// @note The channel set is given to both LOR_BYTES_HEAD and
+///       LOR_BYTES_CSET_*, which must agree. Prefer LOR_BYTES_REQ and
+///       LOR_BYTES_REQ_ARGS, which take the channel set once.
+#define LOR_BYTES_HEAD(unit, effect, off, cbits)                               \
+  0, (unit), (effect) | LOR_CSET_FORMAT(off, cbits)
+
+/// @def LOR_BYTES_INTENSITY
+/// @brief Compile-time encoding of LOR_SET_INTENSITY effect arguments.
+#define LOR_BYTES_INTENSITY(i) (i)
+
+/// @def LOR_BYTES_DECIS
+/// @brief Compile-time encoding of a decisecond duration.
+#define LOR_BYTES_DECIS(ds)                                                    \
+  ((ds) >> 8) | (!((ds) >> 8) ? 0x80 : !((ds) & 0xFF) ? 0x40 : 0),           \
+          ((ds) & 0xFF ? (ds) & 0xFF : 1)
+
+/// @def LOR_BYTES_FADE
+/// @brief Compile-time encoding of LOR_FADE effect arguments.
+#define LOR_BYTES_FADE(start, end, ds) (start), (end), LOR_BYTES_DECIS(ds)
+
+/// @def LOR_BYTES_PULSE
+/// @brief Compile-time encoding of LOR_PULSE effect arguments.
+#define LOR_BYTES_PULSE(ds) ((ds) & 0xFF)
+
+/// @def LOR_BYTES_DMX_INTENSITY
+/// @brief Compile-time encoding of LOR_SET_DMX_INTENSITY effect arguments.
+#define LOR_BYTES_DMX_INTENSITY(output) (output)
+
+/// @def LOR_BYTES_CSET_UNIT
+/// @brief Compile-time encoding of a unit-wide channel set (no channels).
+#define LOR_BYTES_CSET_UNIT 0
+
+/// @def LOR_BYTES_CSET_16
+/// @brief Compile-time encoding of a channel set using both bytes of its
+///        bitset. Fails to compile if either byte of \p cbits is zero.
+#define LOR_BYTES_CSET_16(off, cbits)                                          \
+  (off) + LOR_BYTES_CHECK_(((cbits) & 0xFF) && ((cbits) >> 8 & 0xFF)),         \
+          (cbits) & 0xFF, (cbits) >> 8 & 0xFF
+
+/// @def LOR_BYTES_CSET_LOW
+/// @brief Compile-time encoding of a channel set using only the low byte of
+///        its bitset. Fails to compile if the bitset does not match.
+#define LOR_BYTES_CSET_LOW(off, cbits)                                         \
+  ((off) | ((off) ? 0x80 : 0)) +                                               \
+          LOR_BYTES_CHECK_(((cbits) & 0xFF) && !((cbits) >> 8 & 0xFF)),        \
+          (cbits) & 0xFF
+
+/// @def LOR_BYTES_CSET_HIGH
+/// @brief Compile-time encoding of a channel set using only the high byte of
+///        its bitset. Fails to compile if the bitset does not match.
+#define LOR_BYTES_CSET_HIGH(off, cbits)                                        \
+  ((off) | ((off) ? 0x40 : 0)) +                                               \
+          LOR_BYTES_CHECK_(!((cbits) & 0xFF) && ((cbits) >> 8 & 0xFF)),        \
+          (cbits) >> 8 & 0xFF
+
+/// @def LOR_BYTES_CSET_WIDE
+/// @brief Compile-time encoding of a unit-wide channel set with a non-zero
+///        offset (no channels). Fails to compile if \p off is zero.
+#define LOR_BYTES_CSET_WIDE(off)                                               \
+  ((off) | 0x40) + LOR_BYTES_CHECK_((off) && (off) < 64)
+
+/// @def LOR_BYTES_END
+/// @brief Compile-time encoding of the end of a request.
+#define LOR_BYTES_END 0
+
+// The channel set shapes of LOR_BYTES_REQ, each checking the channel set.
+#define LOR_BYTES_SHAPE_16_(off, cbits)                                        \
+  LOR_BYTES_CSET_16((off) + LOR_BYTES_CHECK_((off) < 64), cbits)
+#define LOR_BYTES_SHAPE_LOW_(off, cbits)                                       \
+  LOR_BYTES_CSET_LOW((off) + LOR_BYTES_CHECK_((off) < 64), cbits)
+#define LOR_BYTES_SHAPE_HIGH_(off, cbits)                                      \
+  LOR_BYTES_CSET_HIGH((off) + LOR_BYTES_CHECK_((off) < 64), cbits)
+#define LOR_BYTES_SHAPE_UNIT_(off, cbits)                                      \
+  LOR_BYTES_CSET_UNIT + LOR_BYTES_CHECK_(!(off) && !(cbits))
+#define LOR_BYTES_SHAPE_WIDE_(off, cbits)                                      \
+  LOR_BYTES_CSET_WIDE(off) + LOR_BYTES_CHECK_(!(cbits))
+
+/// @def LOR_BYTES_REQ
+/// @brief Compile-time encoding of an entire request for an effect without
+///        arguments, producing the same bytes as lor_write. \p shape is the
+///        encoded shape of the channel set, one of 16 (both bitset bytes), LOW
+///        (low byte only), HIGH (high byte only), UNIT (unit-wide, offset 0)
+///        or WIDE (unit-wide, non-zero offset), and fails to compile if it
+///        does not match \p off and \p cbits. All arguments must be constants.
+/// @code
+/// static const unsigned char unit_3_bank_0_off[] = {
+///         LOR_BYTES_REQ(16, 3, LOR_SET_OFF, 0, 0xFFFF)};
+/// @endcode
+#define LOR_BYTES_REQ(shape, unit, effect, off, cbits)                         \
+  LOR_BYTES_HEAD(unit, effect, off, cbits),                                    \
+          LOR_BYTES_SHAPE_##shape##_(off, cbits), LOR_BYTES_END
+
+/// @def LOR_BYTES_REQ_ARGS
+/// @brief Compile-time encoding of an entire request for an effect with
+///        arguments, given as the trailing arguments (e.g. LOR_BYTES_FADE).
+///        See LOR_BYTES_REQ.
+/// @code
+/// static const unsigned char unit_1_fade_in[] = {LOR_BYTES_REQ_ARGS(
+///         LOW, 1, LOR_FADE, 0, 0x00FF, LOR_BYTES_FADE(1, 240, 10))};
+/// @endcode
+#define LOR_BYTES_REQ_ARGS(shape, unit, effect, off, cbits, ...)               \
+  LOR_BYTES_HEAD(unit, effect, off, cbits), __VA_ARGS__,                       \
+          LOR_BYTES_SHAPE_##shape##_(off, cbits), LOR_BYTES_END
+
 /// @struct lor_req
 /// @brief Represents a request to apply an effect to a set of channels on a
 ///        specific unit. The effect may require additional arguments, which are
@@ -206,17 +342,234 @@ void lor_set_intensity(lor_req_s* req, lor_intensity i);
 void lor_set_fade(lor_req_s* req, lor_intensity start, lor_intensity end,
                   lor_decisec ds);
 
+/// @brief Returns the exact number of bytes a request encodes to, without
+///        encoding the request.
+/// @param req The request to measure.
+/// @return The encoded size of the request in bytes.
+size_t lor_req_size(const lor_req_s* req);
+
+/// @brief Returns the exact number of bytes \p rs requests encode to, without
+///        encoding the requests. A buffer of this size is guaranteed to hold
+///        every request when passed to lor_write.
+/// @param r The requests to measure.
+/// @param rs The number of requests in \p r.
+/// @return The total encoded size of the requests in bytes.
+size_t lor_write_size(const lor_req_s* r, size_t rs);
+
 /// @brief Encodes and writes up to \p rs requests to the provided buffer \p b
-///        as binary data. Requests are first encoded into a scratch buffer to
-///        ensure the buffer has enough space to hold the encoded data. The
-///        function will attempt to write as many requests as possible to the
-///        buffer, up to the provided request count.
+///        as binary data. The encoded size of each request is checked against
+///        the remaining buffer space before the request is encoded directly
+///        into the buffer. The function will attempt to write as many requests
+///        as possible to the buffer, up to the provided request count.
 /// @return If all requests were written, the number of bytes written to the
 ///         buffer is returned. If the buffer is too small to hold all requests,
 ///         the number of bytes required to hold at least one additional request
-///         is returned.
+///         is returned. See lor_encoder_write for resumable encoding.
 size_t lor_write(unsigned char* b, size_t bs, const lor_req_s* r, size_t rs);
 
+/// @struct lor_encoder
+/// @brief Represents the progress of encoding a list of requests across
+///        multiple, potentially small, output buffers. Unlike lor_write, a
+///        request which does not fit in the remaining buffer space is split
+///        and resumed by the next call to \p lor_encoder_write.
+typedef struct lor_encoder {
+  /// @brief The requests being encoded.
+  const lor_req_s* r;
+  /// @brief The number of requests in \p r.
+  size_t rs;
+  /// @brief The number of requests fully written.
+  size_t consumed;
+  /// @brief The number of bytes written.
+  size_t produced;
+  /// @brief The number of bytes remaining to be written.
+  size_t pending;
+  /// @brief The encoded request currently split across output buffers.
+  unsigned char partial[LOR_REQ_MAX_SIZE];
+  /// @brief The number of bytes of \p partial already written.
+  unsigned char partial_off;
+  /// @brief The encoded size of \p partial, or zero if no request is split.
+  unsigned char partial_size;
+} lor_encoder_s;
+
+/// @brief Initializes an encoder to encode \p rs requests from \p r. The
+///        requests must remain valid and unmodified until fully encoded.
+/// @param enc The encoder to initialize.
+/// @param r The requests to encode.
+/// @param rs The number of requests in \p r.
+void lor_encoder_init(lor_encoder_s* enc, const lor_req_s* r, size_t rs);
+
+/// @brief Encodes and writes up to \p bs bytes of the remaining requests to
+///        \p b, filling the buffer completely unless no requests remain. The
+///        encoder's consumed, produced and pending counts are updated.
+/// @param enc The encoder to continue.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @return The number of bytes written to the buffer, zero once the pending
+///         count reaches zero.
+size_t lor_encoder_write(lor_encoder_s* enc, unsigned char* b, size_t bs);
+
+/// @struct lor_chunk
+/// @brief Represents a contiguous range of requests and the range of bytes
+///        it encodes to within the encoding of all requests. Splitting a
+///        large list of requests into chunks allows each chunk to be measured
+///        and encoded independently (e.g. by a thread pool), with output
+///        identical to lor_write:
+///        1. lor_chunk_split, then lor_chunk_measure for each chunk,
+///        2. lor_chunk_offsets, once every chunk is measured,
+///        3. lor_chunk_write for each chunk, into one shared buffer.
+/// @note Chunks share no state, so measuring or writing different chunks
+///       concurrently is safe (except for statistics if TINYLOR_STATS is
+///       defined).
+typedef struct lor_chunk {
+  /// @brief The index of the first request of the chunk.
+  size_t first;
+  /// @brief The number of requests in the chunk.
+  size_t count;
+  /// @brief The offset of the chunk's encoded bytes in the output buffer.
+  size_t offset;
+  /// @brief The encoded size of the chunk in bytes.
+  size_t size;
+} lor_chunk_s;
+
+/// @brief Splits \p rs requests into \p cs chunks of (nearly) equal request
+///        counts. Chunks beyond the number of requests are empty.
+/// @param c The chunks to initialize.
+/// @param cs The number of chunks in \p c.
+/// @param rs The number of requests to split.
+void lor_chunk_split(lor_chunk_s* c, size_t cs, size_t rs);
+
+/// @brief Measures the encoded size of a chunk's requests.
+/// @param c The chunk to measure.
+/// @param r The requests the chunk was split from.
+void lor_chunk_measure(lor_chunk_s* c, const lor_req_s* r);
+
+/// @brief Sets the output offset of each measured chunk, the prefix sum of
+///        the sizes of the chunks before it.
+/// @param c The chunks, in request order.
+/// @param cs The number of chunks in \p c.
+/// @return The total encoded size of every chunk in bytes.
+size_t lor_chunk_offsets(lor_chunk_s* c, size_t cs);
+
+/// @brief Encodes a chunk's requests into its range of the output buffer.
+/// @param b The output buffer shared by every chunk, at least the total size
+///          returned by lor_chunk_offsets.
+/// @param c The chunk to encode.
+/// @param r The requests the chunk was split from.
+/// @return The number of bytes written, the chunk's size.
+size_t lor_chunk_write(unsigned char* b, const lor_chunk_s* c,
+                       const lor_req_s* r);
+
+/// @struct lor_req_batch
+/// @brief Represents a batch of requests stored as parallel arrays (one array
+///        per field) rather than an array of lor_req_s. Each field is read
+///        sequentially when encoding, so large batches are classified and
+///        measured without branching per request. Storage is provided by the
+///        caller, every array must hold at least \p cap elements (\p args
+///        holds 4 bytes per request).
+typedef struct lor_req_batch {
+  /// @brief The unit of each request.
+  lor_unit* unit;
+  /// @brief The effect of each request, a lor_effect value.
+  unsigned char* effect;
+  /// @brief The channel set offset of each request.
+  unsigned char* offset;
+  /// @brief The channel set bitset of each request.
+  unsigned short* cbits;
+  /// @brief The encoded effect arguments of each request, 4 bytes per request
+  ///        of which only the effect's argument size is used.
+  unsigned char* args;
+  /// @brief The number of requests in the batch.
+  size_t n;
+  /// @brief The maximum number of requests the batch can hold.
+  size_t cap;
+} lor_req_batch_s;
+
+/// @brief Initializes an empty batch using the provided field arrays.
+/// @param batch The batch to initialize.
+/// @param unit The unit array.
+/// @param effect The effect array.
+/// @param offset The channel set offset array.
+/// @param cbits The channel set bitset array.
+/// @param args The effect argument array, 4 bytes per request.
+/// @param cap The number of requests each array can hold.
+void lor_batch_init(lor_req_batch_s* batch, lor_unit* unit,
+                    unsigned char* effect, unsigned char* offset,
+                    unsigned short* cbits, unsigned char* args, size_t cap);
+
+/// @brief Appends a copy of a request to the batch.
+/// @param batch The batch to append to.
+/// @param req The request to append.
+/// @return 0 on success, -1 if the batch is full or the effect is invalid.
+int lor_batch_add(lor_req_batch_s* batch, const lor_req_s* req);
+
+/// @brief Returns the exact number of bytes the batch encodes to, the batch
+///        equivalent of lor_write_size.
+/// @param batch The batch to measure.
+/// @return The total encoded size of the batch in bytes.
+size_t lor_batch_size(const lor_req_batch_s* batch);
+
+/// @brief Encodes and writes the batch to the provided buffer \p b, producing
+///        the same bytes as lor_write does for the equivalent lor_req_s array.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @param batch The batch to encode.
+/// @return The same as lor_write: the number of bytes written if the batch
+///         was fully written, otherwise the encoded size of the first request
+///         which did not fit.
+size_t lor_batch_write(unsigned char* b, size_t bs,
+                       const lor_req_batch_s* batch);
+
+/// @brief Decodes up to \p rs requests from the binary data in \p b, the
+///        inverse of lor_write. Heartbeat messages are skipped. Bytes which do
+///        not form a valid request are skipped until the next possible start
+///        of a request. Decoding stops early at an incomplete request at the
+///        end of the buffer, which may be completed by appending more data.
+/// @note A single channel set (\p LOR_FMT_SINGLE) does not encode which half
+///       of the 16-bit bitset the channel was in, and is always decoded into
+///       the low byte. Re-encoding the decoded request produces the same bytes.
+/// @param b The buffer to read from.
+/// @param bs The size of the buffer.
+/// @param r The request buffer to decode into.
+/// @param rs The maximum number of requests to decode.
+/// @param n Optional, set to the number of requests decoded into \p r.
+/// @return The number of bytes consumed from \p b.
+size_t lor_read(const unsigned char* b, size_t bs, lor_req_s* r, size_t rs,
+                size_t* n);
+
+/// @brief Merges requests sharing the same unit, effect, effect arguments and
+///        16-channel boundary into a single request using the combined channel
+///        set, compacting \p r in place. A request is only merged into an
+///        earlier request if no request between the two applies to any of the
+///        same channels, so the result applies the same final state as the
+///        original sequence. Unit-wide requests (an empty bitset) are never
+///        merged.
+/// @note Each request is compared against prior requests until a match or
+///       conflicting request is found, worst case O(n^2) comparisons.
+/// @param r The requests to coalesce.
+/// @param rs The number of requests in \p r.
+/// @return The number of requests remaining in \p r.
+size_t lor_coalesce(lor_req_s* r, size_t rs);
+
+/// @brief Folds requests applying the same effect to the same channel set of
+///        every unit of a network into a single broadcast (unit 0xFF) request,
+///        followed by requests for the units whose effect differs. A channel
+///        set is only folded if every unit of \p units has exactly one request
+///        for it, no other request applies to any of its channels, and at
+///        least two units share the most common effect.
+/// @note Requests are bucketed by channel set with a sort, O(n log n), plus
+///       O(m * d) per bucket of m requests using d distinct effects to find
+///       the most common effect.
+/// @param r The requests to fold.
+/// @param rs The number of requests in \p r.
+/// @param units The units of the network, every unit a broadcast reaches.
+/// @param us The number of units in \p units.
+/// @param tmp Scratch storage of at least \p rs elements.
+/// @param out The request buffer to write to, at least \p rs requests in size
+///            and not overlapping \p r.
+/// @return The number of requests written to \p out.
+size_t lor_fold_broadcast(const lor_req_s* r, size_t rs, const lor_unit* units,
+                          size_t us, size_t* tmp, lor_req_s* out);
+
 /// @typedef lor_intensity_fn
 /// @brief Represents a function that converts an arbitrary byte value to a
 ///        a scaled intensity value used by the LOR protocol.
@@ -231,6 +584,1028 @@ typedef lor_intensity (*lor_intensity_fn)(unsigned char b);
 /// @return The scaled intensity value.
 lor_intensity lor_get_intensity(unsigned char b);
 
+/// @brief Encodes a [0,0xFF] value into a LOR intensity value using a gamma 2.2
+///        curve, approximating the perceived brightness of incandescent and
+///        most LED lights.
+/// @note This is a table driven implementation of the lor_intensity_fn type.
+/// @param b The byte value to convert.
+/// @return The scaled intensity value.
+lor_intensity lor_get_intensity_gamma(unsigned char b);
+
+/// @brief Encodes a [0,0xFF] value into a LOR intensity value using the CIE
+///        1931 lightness curve, so that equal steps in \p b appear as equal
+///        steps in perceived brightness.
+/// @note This is a table driven implementation of the lor_intensity_fn type.
+/// @param b The byte value to convert.
+/// @return The scaled intensity value.
+lor_intensity lor_get_intensity_cie(unsigned char b);
+
+/// @brief Converts \p n byte values from \p src (e.g. a DMX universe) into
+///        LOR intensity values written to \p dst. The built-in conversion
+///        functions are applied directly from their lookup tables. Custom
+///        functions are tabulated once per call when converting more than 256
+///        values, otherwise called once per value.
+/// @param dst The buffer to write \p n intensity values to.
+/// @param src The byte values to convert.
+/// @param n The number of values to convert.
+/// @param fn The conversion function to apply, or NULL for lor_get_intensity.
+void lor_get_intensities(lor_intensity* dst, const unsigned char* src,
+                         size_t n, lor_intensity_fn fn);
+
+/// @struct lor_dirty
+/// @brief Represents the set of changed channels of every unit, as a bitmap of
+///        64 banks of 16 channels per unit (the lor_channel_set geometry)
+///        summarized by one bit per non-empty bank and one bit per unit with
+///        a non-empty bank. Iterating the changed channels costs time in
+///        proportion to the number of changed banks, not the number of units
+///        or channels.
+typedef struct lor_dirty {
+  /// @brief The bit set of units with at least one changed bank.
+  unsigned long long units[4];
+  /// @brief The bit set of changed banks, per unit.
+  unsigned long long banks[256];
+  /// @brief The bit set of changed channels, per unit and bank.
+  unsigned short cbits[256][64];
+} lor_dirty_s;
+
+/// @brief Clears every changed channel.
+/// @param d The bitmap to clear.
+void lor_dirty_init(lor_dirty_s* d);
+
+/// @brief Marks a channel as changed.
+/// @param d The bitmap to modify.
+/// @param u The unit of the channel.
+/// @param c The channel number, relative to the unit, less than 1024.
+void lor_dirty_mark(lor_dirty_s* d, lor_unit u, lor_channel c);
+
+/// @brief Marks every channel of a channel set as changed.
+/// @param d The bitmap to modify.
+/// @param u The unit of the channels.
+/// @param cset The channels to mark.
+void lor_dirty_mark_set(lor_dirty_s* d, lor_unit u,
+                        const lor_channel_set* cset);
+
+/// @brief Removes the lowest changed bank (ordered by unit, then offset) from
+///        the bitmap and returns its changed channels.
+/// @param d The bitmap to iterate.
+/// @param u The unit of the changed channels.
+/// @param cset The changed channels.
+/// @return Non-zero if a bank was returned, zero if no channels are changed.
+int lor_dirty_next(lor_dirty_s* d, lor_unit* u, lor_channel_set* cset);
+
+/// @struct lor_frame
+/// @brief Represents the intensity state of a contiguous range of units and
+///        channels, double buffered as the current (pending) state and the
+///        previous (sent) state. Changes between the two are converted into
+///        the minimal set of requests by \p lor_frame_diff.
+/// @note The frame does not own its storage. The caller provides a buffer of
+///       at least 2 * units * channels bytes via \p lor_frame_init.
+typedef struct lor_frame {
+  /// @brief The current intensity of each channel, indexed by unit then
+  ///        channel. A value of zero indicates the channel has not been set.
+  lor_intensity* cur;
+  /// @brief The last intensity of each channel returned by lor_frame_diff.
+  lor_intensity* prev;
+  /// @brief The intensity conversion function applied by lor_frame_set.
+  lor_intensity_fn fn;
+  /// @brief The number of channels per unit, in the range of [1, 1024].
+  lor_channel channels;
+  /// @brief The first unit covered by the frame.
+  lor_unit first;
+  /// @brief The number of units covered by the frame.
+  lor_unit units;
+  /// @brief The optional bitmap of changed channels, see lor_frame_track.
+  lor_dirty_s* dirty;
+} lor_frame_s;
+
+/// @brief Initializes a frame covering \p units units (starting at \p first)
+///        of \p channels channels each, using the provided buffer \p b as
+///        storage. The previous state is cleared, so every channel set before
+///        the first call to lor_frame_diff will be included in its result.
+/// @param f The frame to initialize.
+/// @param b The storage buffer, at least 2 * units * channels bytes in size.
+/// @param first The first unit covered by the frame.
+/// @param units The number of units covered by the frame.
+/// @param channels The number of channels per unit, less than or equal to 1024.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_frame_init(lor_frame_s* f, lor_intensity* b, lor_unit first,
+                   lor_unit units, lor_channel channels);
+
+/// @brief Tracks the channels changed by lor_frame_set in \p d, so that
+///        lor_frame_diff only compares the changed banks of channels instead
+///        of the entire frame. Every channel of the frame is marked as changed.
+/// @note The bitmap must be exclusive to the frame, and must not be modified
+///       by the caller while tracked.
+/// @param f The frame to track.
+/// @param d The bitmap to use, or NULL to stop tracking.
+void lor_frame_track(lor_frame_s* f, lor_dirty_s* d);
+
+/// @brief Sets the current intensity of a channel within the frame. The value
+///        is converted using the frame's intensity function (lor_get_intensity
+///        by default) before being stored, so changes which quantize to the
+///        same LOR intensity value are not considered changes.
+/// @param f The frame to modify.
+/// @param u The unit of the channel.
+/// @param c The channel number, relative to the unit.
+/// @param b The byte value to convert and store.
+/// @return 0 on success, -1 if the unit or channel is outside the frame.
+int lor_frame_set(lor_frame_s* f, lor_unit u, lor_channel c, unsigned char b);
+
+/// @brief Compares the current and previous state of the frame and writes up
+///        to \p rs requests to \p r which apply the changes. Changed channels
+///        sharing a 16-channel boundary and intensity value are grouped into a
+///        single request. Channels included in the written requests are
+///        marked as sent. If \p rs is too small to hold all changes, the
+///        remaining changes are left pending for the next call.
+/// @param f The frame to compare.
+/// @param r The request buffer to write to.
+/// @param rs The maximum number of requests to write.
+/// @return The number of requests written to \p r.
+size_t lor_frame_diff(lor_frame_s* f, lor_req_s* r, size_t rs);
+
+/// @def LOR_DMX_SLOTS
+/// @brief The maximum number of slots in a DMX universe.
+#define LOR_DMX_SLOTS 512
+
+/// @struct lor_event
+/// @brief Represents a request scheduled to be sent at a specific frame.
+typedef struct lor_event {
+  /// @brief The index of the frame to send the request at.
+  unsigned long frame;
+  /// @brief The request to send.
+  lor_req_s req;
+} lor_event_s;
+
+/// @brief Converts a timeline of per-frame intensities of a channel into the
+///        events needed to reproduce it, replacing linear ramps with a single
+///        \p LOR_FADE request interpolated by the hardware. The duration of a
+///        fade is the duration of its ramp rounded to the nearest decisecond
+///        (so it ends within 50 ms of the ramp, e.g. 30 frames of 33 ms fade
+///        over 1 second), and a ramp is used when every intensity it covers is
+///        within \p tol of the rounded fade, including frames past the end of
+///        a fade rounded down. Other changes are sent as \p LOR_SET_INTENSITY
+///        requests, unchanged frames are not sent.
+/// @param t The intensity of the channel at each frame.
+/// @param n The number of frames in \p t.
+/// @param period_ms The period of each frame in milliseconds.
+/// @param tol The maximum difference allowed between an intensity and a ramp.
+/// @param target The request whose unit and channel set are used by every
+///               event, allowing channels with equal timelines to be combined.
+/// @param e The event buffer to write to, in frame order.
+/// @param es The maximum number of events to write.
+/// @return The number of events written to \p e. If equal to \p es, the
+///         timeline may have been only partially converted.
+size_t lor_fit_fades(const lor_intensity* t, size_t n, unsigned short period_ms,
+                     unsigned char tol, const lor_req_s* target,
+                     lor_event_s* e, size_t es);
+
+/// @struct lor_dmx_map
+/// @brief Represents the LOR channel a DMX slot is patched to.
+typedef struct lor_dmx_map {
+  /// @brief The unit of the channel, or zero if the slot is not patched.
+  lor_unit unit;
+  /// @brief The channel number, relative to the unit.
+  lor_channel channel;
+} lor_dmx_map_s;
+
+/// @struct lor_dmx
+/// @brief Represents a translator of DMX universes into the channels of a
+///        frame, as described by a patch table. Only slots which changed
+///        since the previous universe are written to the frame, and the frame
+///        groups equal channel values into shared channel sets once diffed.
+///        Several translators (e.g. one per universe) may share one frame.
+typedef struct lor_dmx {
+  /// @brief The patch table, one entry per slot of the universe.
+  const lor_dmx_map_s* map;
+  /// @brief The frame the patched channels are written to.
+  lor_frame_s* frame;
+  /// @brief Non-zero once a universe has been translated.
+  int primed;
+  /// @brief The previous universe.
+  unsigned char prev[LOR_DMX_SLOTS];
+} lor_dmx_s;
+
+/// @brief Initializes a translator writing to \p f using the patch table
+///        \p map of \p LOR_DMX_SLOTS entries. The table must outlive \p d.
+/// @param d The translator to initialize.
+/// @param map The patch table.
+/// @param f The frame to write patched channels to.
+void lor_dmx_init(lor_dmx_s* d, const lor_dmx_map_s* map, lor_frame_s* f);
+
+/// @brief Translates the first \p n slots of a DMX universe, writing each
+///        patched slot which changed since the previous universe to the frame.
+///        Every patched slot is written by the first call.
+/// @param d The translator to use.
+/// @param u The universe slot values.
+/// @param n The number of slots in \p u, up to \p LOR_DMX_SLOTS.
+/// @return The number of patched slots written to the frame.
+size_t lor_dmx_update(lor_dmx_s* d, const unsigned char* u, size_t n);
+
+/// @struct lor_addr
+/// @brief Represents the address of a single channel.
+typedef struct lor_addr {
+  /// @brief The unit of the channel, or zero if the address is unused.
+  lor_unit unit;
+  /// @brief The channel number, relative to the unit.
+  lor_channel channel;
+} lor_addr_s;
+
+/// @struct lor_patch_entry
+/// @brief Represents a logical channel patched to the address of a channel.
+typedef struct lor_patch_entry {
+  /// @brief The logical channel number.
+  unsigned long logical;
+  /// @brief The address the logical channel is patched to.
+  lor_addr_s addr;
+} lor_patch_entry_s;
+
+/// @struct lor_patch_bank
+/// @brief Represents the patched channels of a unit sharing a 16-channel
+///        boundary, in the geometry of a lor_channel_set.
+typedef struct lor_patch_bank {
+  /// @brief The unit of the channels.
+  lor_unit unit;
+  /// @brief The offset of the bank and the bitset of its patched channels.
+  lor_channel_set cset;
+  /// @brief The index of the first patch entry of the bank.
+  size_t first;
+  /// @brief The number of patch entries of the bank (greater than the number
+  ///        of bits set if several logical channels share a channel).
+  size_t count;
+} lor_patch_bank_s;
+
+/// @struct lor_patch
+/// @brief Represents an index of a flat space of logical channels patched to
+///        channels of any unit. Logical channels are translated in constant
+///        time, and the patch entries are ordered by unit, then channel, so
+///        iterating them (or the banks) visits each unit's channels in order.
+typedef struct lor_patch {
+  /// @brief The address of each logical channel, indexed by logical channel.
+  lor_addr_s* index;
+  /// @brief The number of logical channels in \p index.
+  size_t n;
+  /// @brief The patch entries, sorted by unit then channel.
+  const lor_patch_entry_s* e;
+  /// @brief The number of patch entries.
+  size_t es;
+  /// @brief The banks covering the patch entries, sorted by unit then offset.
+  lor_patch_bank_s* banks;
+  /// @brief The number of banks.
+  size_t bs;
+} lor_patch_s;
+
+/// @brief Initializes a patch from \p es patch entries, which are sorted in
+///        place and must outlive \p p. Logical channels without an entry are
+///        left unpatched.
+/// @param p The patch to initialize.
+/// @param index The index storage, one element per logical channel.
+/// @param n The number of logical channels, each entry's logical channel must
+///          be less than \p n.
+/// @param banks The bank storage, at least \p es elements.
+/// @param e The patch entries.
+/// @param es The number of patch entries.
+/// @return 0 on success, -1 if an entry is out of range, patched to unit zero
+///         or a channel of 1024 or greater, or patches a logical channel which
+///         was already patched.
+int lor_patch_init(lor_patch_s* p, lor_addr_s* index, size_t n,
+                   lor_patch_bank_s* banks, lor_patch_entry_s* e, size_t es);
+
+/// @brief Returns the address a logical channel is patched to.
+/// @param p The patch to use.
+/// @param logical The logical channel.
+/// @return The address, or NULL if the logical channel is not patched.
+const lor_addr_s* lor_patch_get(const lor_patch_s* p, unsigned long logical);
+
+/// @brief Writes the value of every patched logical channel to the frame, in
+///        patch order so the frame is written sequentially. The frame then
+///        groups equal channel values into shared channel sets once diffed.
+/// @param p The patch to use.
+/// @param f The frame to write to.
+/// @param v The value of each logical channel, \p p->n values.
+/// @return The number of values written to the frame, patched channels outside
+///         the frame are skipped.
+size_t lor_patch_update(const lor_patch_s* p, lor_frame_s* f,
+                        const unsigned char* v);
+
+/// @struct lor_e131
+/// @brief Represents an E1.31 (sACN) data packet parsed by lor_e131_parse.
+///        The slot data is not copied and points into the packet buffer.
+typedef struct lor_e131 {
+  /// @brief The slot values of the universe, excluding the start code.
+  const unsigned char* slots;
+  /// @brief The number of slot values.
+  size_t n;
+  /// @brief The universe number.
+  unsigned short universe;
+  /// @brief The priority of the source, in the range of [0, 200].
+  unsigned char priority;
+  /// @brief The sequence number of the packet.
+  unsigned char sequence;
+  /// @brief The options bit field (0x80 preview data, 0x40 stream terminated,
+  ///        0x20 force synchronization).
+  unsigned char options;
+  /// @brief The DMX start code, zero for dimmer data.
+  unsigned char start_code;
+} lor_e131_s;
+
+/// @def LOR_E131_MAX_SIZE
+/// @brief The size of an E1.31 data packet of a full DMX universe.
+#define LOR_E131_MAX_SIZE (126 + LOR_DMX_SLOTS)
+
+/// @brief Parses an E1.31 data packet (e.g. a received UDP datagram) without
+///        copying its slot data, which may be passed to lor_dmx_update.
+/// @param p The parsed packet to initialize.
+/// @param b The packet buffer.
+/// @param bs The size of the packet buffer.
+/// @return 0 on success, -1 if the buffer is not a valid E1.31 data packet.
+int lor_e131_parse(lor_e131_s* p, const unsigned char* b, size_t bs);
+
+/// @brief Builds an E1.31 data packet of dimmer data (start code zero) at the
+///        default priority of 100, e.g. to test a receiver with
+///        lor_e131_parse. The source name is "tinylor" and the CID is zero.
+/// @param b The buffer to write the packet to.
+/// @param bs The size of the buffer, at least 126 + \p n bytes (see
+///           LOR_E131_MAX_SIZE).
+/// @param universe The universe number.
+/// @param seq The sequence number.
+/// @param slots The slot values.
+/// @param n The number of slot values, up to \p LOR_DMX_SLOTS.
+/// @return The size of the packet, or zero if \p n or \p bs is invalid.
+size_t lor_e131_build(unsigned char* b, size_t bs, unsigned short universe,
+                      unsigned char seq, const unsigned char* slots, size_t n);
+
+/// @brief Determines whether a packet with sequence number \p seq should be
+///        processed after a packet with sequence number \p last from the same
+///        source, discarding late or duplicate packets as described by E1.31.
+/// @param last The sequence number of the last processed packet.
+/// @param seq The sequence number of the received packet.
+/// @return Non-zero if the packet should be processed, otherwise zero.
+int lor_e131_sequence_ok(unsigned char last, unsigned char seq);
+
+/// @brief Returns the number of bytes which may be sent within \p ms
+///        milliseconds over a serial link of \p baud baud, assuming 8N1
+///        framing (10 bits per byte).
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+/// @param ms The duration in milliseconds.
+/// @return The number of bytes which may be sent.
+size_t lor_wire_bytes(unsigned long baud, unsigned long ms);
+
+/// @brief Returns the number of microseconds required to send \p n bytes over
+///        a serial link of \p baud baud, assuming 8N1 framing (10 bits per
+///        byte), rounded up.
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+/// @param n The number of bytes to send.
+/// @return The wire time in microseconds.
+unsigned long lor_wire_us(unsigned long baud, size_t n);
+
+/// @struct lor_sched_entry
+/// @brief Represents a request waiting to be admitted by a scheduler.
+typedef struct lor_sched_entry {
+  /// @brief The request to send.
+  lor_req_s req;
+  /// @brief The priority of the request, higher values are admitted first.
+  unsigned char priority;
+} lor_sched_entry_s;
+
+/// @struct lor_sched
+/// @brief Represents a frame scheduler which admits queued requests by priority
+///        until the encoded size of the frame reaches the number of bytes the
+///        serial link can send within the frame period. Requests which do not
+///        fit are deferred to the following frame with their priority raised
+///        by one, so deferred requests are not starved by newer requests.
+/// @note Requests are admitted in their original order within a frame, but a
+///       deferred request may be sent after a later, higher priority request
+///       for the same channels. Use a single priority for each channel.
+typedef struct lor_sched {
+  /// @brief The queued requests, in the order they were added.
+  lor_sched_entry_s* e;
+  /// @brief The capacity of \p e.
+  size_t es;
+  /// @brief The number of queued requests.
+  size_t n;
+  /// @brief The number of encoded bytes which may be sent per frame.
+  size_t budget;
+  /// @brief The number of bytes of the next frame's budget reserved for other
+  ///        data (e.g. heartbeats), reset to zero by lor_sched_next.
+  size_t reserved;
+} lor_sched_s;
+
+/// @brief Initializes a scheduler using the provided queue storage \p e, with
+///        a per-frame budget of lor_wire_bytes(baud, ms) bytes.
+/// @param s The scheduler to initialize.
+/// @param e The queue storage buffer.
+/// @param es The number of entries in \p e.
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+/// @param ms The frame period in milliseconds.
+/// @note A budget smaller than the largest encoded request (11 bytes) may
+///       prevent some requests from ever being admitted.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_sched_init(lor_sched_s* s, lor_sched_entry_s* e, size_t es,
+                   unsigned long baud, unsigned long ms);
+
+/// @brief Queues a request to be admitted by a later call to lor_sched_next.
+/// @param s The scheduler to add the request to.
+/// @param req The request to queue, copied into the scheduler.
+/// @param priority The priority of the request, higher values first.
+/// @return 0 on success, -1 if the queue is full.
+int lor_sched_add(lor_sched_s* s, const lor_req_s* req, unsigned char priority);
+
+/// @brief Admits queued requests into the next frame, highest priority first,
+///        until the frame budget (less any reserved bytes) or \p rs requests
+///        is reached. Admitted requests are removed from the queue and written
+///        to \p r in the order they were added. The remaining requests are
+///        deferred.
+/// @param s The scheduler to admit requests from.
+/// @param r The request buffer to write the admitted requests to.
+/// @param rs The maximum number of requests to admit.
+/// @return The number of requests written to \p r.
+size_t lor_sched_next(lor_sched_s* s, lor_req_s* r, size_t rs);
+
+/// @struct lor_queue_entry
+/// @brief Represents a request waiting in an output queue.
+typedef struct lor_queue_entry {
+  /// @brief The request to send.
+  lor_req_s req;
+  /// @brief The packed unit, channel set and effect class of the request.
+  unsigned long long key;
+  /// @brief Non-zero if the request is still to be sent, zero if superseded.
+  int live;
+} lor_queue_entry_s;
+
+/// @struct lor_queue
+/// @brief Represents a first in, first out queue of requests in which a newer
+///        request replaces a queued request for the same unit, channel set
+///        and effect class (DMX intensity, or any other effect), so only the
+///        newest state of a channel set is sent when the link falls behind.
+///        The replacement keeps the queue position of the older request,
+///        unless a request queued after it overlaps the same channels, in
+///        which case the older request is dropped and the newer one appended.
+/// @note Matching requests are found in constant time through a direct-mapped
+///       table of the most recent request per key hash, so colliding keys are
+///       not always coalesced. A table of at least twice the queue capacity is
+///       suggested. Replacing a match in place first scans the requests queued
+///       after it for overlapping channels, so a push costs up to the number
+///       of requests queued after its match, and at most the queue capacity.
+typedef struct lor_queue {
+  /// @brief The queued requests, a ring buffer indexed by sequence number.
+  lor_queue_entry_s* e;
+  /// @brief The capacity of \p e, a power of two.
+  size_t es;
+  /// @brief The sequence number of the most recent request per key hash.
+  size_t* slots;
+  /// @brief The number of elements in \p slots, a power of two.
+  size_t ss;
+  /// @brief The sequence number of the oldest queued request.
+  size_t head;
+  /// @brief The sequence number of the next queued request.
+  size_t tail;
+  /// @brief The number of queued requests still to be sent.
+  size_t depth;
+  /// @brief The number of requests dropped because a newer request replaced
+  ///        them before they were sent.
+  unsigned long superseded;
+  /// @brief The number of requests rejected because the queue was full.
+  unsigned long rejected;
+} lor_queue_s;
+
+/// @brief Initializes an empty queue using the provided storage.
+/// @param q The queue to initialize.
+/// @param e The queue storage buffer.
+/// @param es The number of entries in \p e, a power of two.
+/// @param slots The key hash table storage.
+/// @param ss The number of elements in \p slots, a power of two.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_queue_init(lor_queue_s* q, lor_queue_entry_s* e, size_t es,
+                   size_t* slots, size_t ss);
+
+/// @brief Queues a request, replacing a queued request with the same key. See
+///        lor_queue_s for the cost of a replacement.
+/// @param q The queue to add the request to.
+/// @param req The request to queue, copied into the queue.
+/// @return 0 on success, -1 if the queue is full and the request was rejected
+///         (the caller should drain the queue or drop the request).
+int lor_queue_push(lor_queue_s* q, const lor_req_s* req);
+
+/// @brief Encodes and removes queued requests, oldest first, until the next
+///        request does not fit within the remaining space of \p b.
+/// @param q The queue to drain.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer, at least LOR_REQ_MAX_SIZE bytes to ensure
+///           progress.
+/// @return The number of bytes written to the buffer.
+size_t lor_queue_write(lor_queue_s* q, unsigned char* b, size_t bs);
+
+/// @struct lor_stream
+/// @brief Represents a serial output stream which inserts heartbeat messages
+///        between requests at the cadence of \p LOR_HEARTBEAT_DELAY_NS. The
+///        stream estimates when each request boundary is sent from the baud
+///        rate, so a heartbeat is inserted at the right point of a large frame
+///        rather than only before or after it.
+/// @note Times are monotonic nanosecond timestamps supplied by the caller.
+typedef struct lor_stream {
+  /// @brief The baud rate of the serial link.
+  unsigned long baud;
+  /// @brief The time at which the next heartbeat is due.
+  unsigned long long next_heartbeat;
+  /// @brief The estimated time at which previously written bytes finish
+  ///        sending.
+  unsigned long long busy_until;
+} lor_stream_s;
+
+/// @brief Initializes a stream for a serial link of \p baud baud. The first
+///        heartbeat is due immediately.
+/// @param s The stream to initialize.
+/// @param baud The baud rate of the serial link, e.g. 57600 or 115200.
+void lor_stream_init(lor_stream_s* s, unsigned long baud);
+
+/// @brief Returns the number of heartbeat bytes the stream will insert within
+///        \p ms milliseconds of \p now, which may be reserved from a frame
+///        budget (see lor_sched_s reserved).
+/// @param s The stream to query.
+/// @param now The current time in nanoseconds.
+/// @param ms The frame period in milliseconds.
+/// @return The number of heartbeat bytes due within the frame period.
+size_t lor_stream_heartbeat_size(const lor_stream_s* s, unsigned long long now,
+                                 unsigned long ms);
+
+/// @brief Encodes and writes as many of the \p rs requests to \p b as fit,
+///        inserting a heartbeat at the first request boundary sent at or after
+///        the time the heartbeat is due. A due heartbeat is written even if
+///        \p rs is zero. The written bytes are assumed to be sent immediately.
+/// @param s The stream to write to.
+/// @param now The current time in nanoseconds.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @param r The requests to write.
+/// @param rs The number of requests in \p r.
+/// @param n Optional, set to the number of requests written.
+/// @return The number of bytes written to the buffer.
+size_t lor_stream_write(lor_stream_s* s, unsigned long long now,
+                        unsigned char* b, size_t bs, const lor_req_s* r,
+                        size_t rs, size_t* n);
+
+/// @def LOR_HIST_SUB_BITS
+/// @brief The log2 of the number of linear sub-buckets per power of two of a
+///        lor_hist_s, bounding the width of a bucket to 1/8 of its start.
+#define LOR_HIST_SUB_BITS 3
+
+/// @def LOR_HIST_BUCKETS
+/// @brief The number of buckets of a lor_hist_s, covering durations of up to
+///        2^32 nanoseconds (~4.3 seconds).
+#define LOR_HIST_BUCKETS ((32 - LOR_HIST_SUB_BITS + 1) << LOR_HIST_SUB_BITS)
+
+/// @struct lor_hist
+/// @brief Represents a histogram of durations in log-linear buckets. Durations
+///        below 2^LOR_HIST_SUB_BITS nanoseconds are counted exactly, and each
+///        longer power of two range is split into 2^LOR_HIST_SUB_BITS equal
+///        buckets (e.g. [589824, 655360) nanoseconds), so percentiles resolve
+///        to within 12.5%. Durations past the last bucket are counted by it.
+typedef struct lor_hist {
+  /// @brief The number of durations counted per bucket.
+  unsigned long count[LOR_HIST_BUCKETS];
+  /// @brief The number of durations counted.
+  unsigned long n;
+  /// @brief The longest duration counted, in nanoseconds.
+  unsigned long long max;
+} lor_hist_s;
+
+/// @brief Counts a duration.
+/// @param h The histogram to add to.
+/// @param ns The duration in nanoseconds.
+void lor_hist_add(lor_hist_s* h, unsigned long long ns);
+
+/// @brief Returns an upper bound of the \p pct percentile duration, the end of
+///        the bucket containing the percentile (or the longest duration, if
+///        shorter).
+/// @param h The histogram to query.
+/// @param pct The percentile, in the range of [0, 100].
+/// @return The upper bound in nanoseconds, or zero if the histogram is empty.
+unsigned long long lor_hist_percentile(const lor_hist_s* h, unsigned pct);
+
+/// @struct lor_clock
+/// @brief Represents a fixed rate frame clock with absolute deadlines, so the
+///        tick rate does not drift with the time spent per tick. Each tick
+///        records its start jitter (the time past its deadline) and, once
+///        the frame is written, its encode-to-write duration. A tick which
+///        starts a whole period late skips the missed deadlines, keeping the
+///        original phase, rather than sending a burst of late frames.
+/// @note Times are monotonic nanosecond timestamps supplied by the caller, see
+///       lor_clock_wait for a POSIX implementation of the wait. A frame loop
+///       waits for a tick, encodes (e.g. lor_frame_diff then lor_stream_write)
+///       and writes the frame, then calls lor_clock_done.
+typedef struct lor_clock {
+  /// @brief The period of the clock in nanoseconds.
+  unsigned long long period;
+  /// @brief The deadline of the next tick.
+  unsigned long long next;
+  /// @brief The start time of the current tick.
+  unsigned long long start;
+  /// @brief The number of ticks.
+  unsigned long ticks;
+  /// @brief The number of deadlines skipped because a tick started late.
+  unsigned long missed;
+  /// @brief The time past its deadline each tick started, including any
+  ///        skipped periods.
+  lor_hist_s jitter;
+  /// @brief The duration from tick start to lor_clock_done.
+  lor_hist_s encode;
+} lor_clock_s;
+
+/// @brief Initializes a clock whose first tick is due at \p now.
+/// @param c The clock to initialize.
+/// @param now The current time in nanoseconds.
+/// @param period The period in nanoseconds, e.g. 25000000 for 40 Hz.
+/// @return 0 on success, -1 for a zero period.
+int lor_clock_init(lor_clock_s* c, unsigned long long now,
+                   unsigned long long period);
+
+/// @brief Starts the due tick, recording its jitter and advancing the next
+///        deadline past \p now.
+/// @param c The clock to tick.
+/// @param now The current time in nanoseconds.
+/// @return The number of deadlines skipped, or -1 if the tick is not yet due.
+long lor_clock_tick(lor_clock_s* c, unsigned long long now);
+
+/// @brief Records the duration of the current tick, called once its frame is
+///        written.
+/// @param c The clock to update.
+/// @param now The current time in nanoseconds.
+void lor_clock_done(lor_clock_s* c, unsigned long long now);
+
+/// @def LOR_SHOW_HEADER_SIZE
+/// @brief The size of the header preceding the frame index of a compiled show.
+#define LOR_SHOW_HEADER_SIZE 12
+
+/// @struct lor_show
+/// @brief Represents a compiled show, a sequence of frames of pre-encoded
+///        requests with a per-frame offset index. A compiled show is portable
+///        between hosts and may be stored as a file and played back directly
+///        from memory (e.g. a file mapped with mmap, see lor_show_map and
+///        lor_show_play) without encoding.
+/// @note The compiled layout is a 12 byte header ("LORS", version, reserved
+///       byte, 16-bit frame period in milliseconds, 32-bit frame count), an
+///       index of frame count + 1 32-bit offsets relative to the end of the
+///       index, then the encoded frame data. Integers are little endian.
+typedef struct lor_show {
+  /// @brief The compiled show data.
+  const unsigned char* b;
+  /// @brief The size of the compiled show data.
+  size_t bs;
+  /// @brief The number of frames in the show.
+  unsigned long frames;
+  /// @brief The period of each frame in milliseconds.
+  unsigned short period_ms;
+} lor_show_s;
+
+/// @brief Compiles a show of \p frames frames into \p b. Frame \p i consists
+///        of the next \p rc[i] requests of \p r.
+/// @param b The buffer to write the compiled show to.
+/// @param bs The size of the buffer, may be zero to only measure the show.
+/// @param r The requests of every frame, in order.
+/// @param rc The number of requests in each frame.
+/// @param frames The number of frames in the show.
+/// @param period_ms The period of each frame in milliseconds.
+/// @return The size of the compiled show. If greater than \p bs, nothing was
+///         written and the caller should retry with a buffer of this size.
+size_t lor_show_compile(unsigned char* b, size_t bs, const lor_req_s* r,
+                        const size_t* rc, unsigned long frames,
+                        unsigned short period_ms);
+
+/// @brief Opens a compiled show for playback, validating its header and
+///        index. The show data is not copied and must outlive \p s.
+/// @param s The show to initialize.
+/// @param b The compiled show data.
+/// @param bs The size of the compiled show data.
+/// @return 0 on success, -1 if the data is not a valid compiled show.
+int lor_show_open(lor_show_s* s, const unsigned char* b, size_t bs);
+
+/// @brief Returns the encoded bytes of a frame of an opened show.
+/// @param s The show to read from.
+/// @param i The index of the frame, less than the show's frame count.
+/// @param n Set to the number of encoded bytes in the frame.
+/// @return A pointer to the encoded frame within the show data.
+const unsigned char* lor_show_frame(const lor_show_s* s, unsigned long i,
+                                    size_t* n);
+
+/// @struct lor_cache_entry
+/// @brief Represents a previously encoded request held by a cache.
+typedef struct lor_cache_entry {
+  /// @brief The packed unit, effect and channel set of the request.
+  unsigned long long key;
+  /// @brief The packed effect arguments of the request.
+  unsigned long args;
+  /// @brief The encoded size of the request, or zero if the entry is unused.
+  unsigned char size;
+  /// @brief The encoded request.
+  unsigned char b[LOR_REQ_MAX_SIZE];
+} lor_cache_entry_s;
+
+/// @struct lor_cache
+/// @brief Represents a direct-mapped cache of encoded requests, keyed on the
+///        packed request fields, which is useful when the same requests are
+///        repeatedly encoded (e.g. chases). A request mapping to an occupied
+///        entry evicts the request previously held by the entry.
+typedef struct lor_cache {
+  /// @brief The cache entries.
+  lor_cache_entry_s* e;
+  /// @brief The number of cache entries, a power of two.
+  size_t es;
+  /// @brief The number of requests found in the cache.
+  unsigned long hits;
+  /// @brief The number of requests encoded and added to the cache.
+  unsigned long misses;
+  /// @brief The number of misses which replaced a different request.
+  unsigned long evictions;
+} lor_cache_s;
+
+/// @brief Initializes a cache using the provided entry storage \p e.
+/// @param c The cache to initialize.
+/// @param e The entry storage buffer.
+/// @param es The number of entries in \p e, a power of two.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_cache_init(lor_cache_s* c, lor_cache_entry_s* e, size_t es);
+
+/// @brief Equivalent to lor_write, but copies previously encoded requests from
+///        the cache and adds any other requests to the cache.
+/// @param c The cache to use.
+/// @param b The buffer to write to.
+/// @param bs The size of the buffer.
+/// @param r The requests to write.
+/// @param rs The number of requests in \p r.
+/// @return See lor_write.
+size_t lor_cache_write(lor_cache_s* c, unsigned char* b, size_t bs,
+                       const lor_req_s* r, size_t rs);
+
+/// @struct lor_ring
+/// @brief Represents a lock-free, single producer single consumer ring buffer
+///        of encoded requests. This allows each network (serial port) to be
+///        encoded by its own thread and written by another, e.g. one encoding
+///        thread and one ring per network, without locks or blocking the other
+///        networks. lor_net_s (with TINYLOR_THREADS) provides these threads.
+/// @note Only one thread may call lor_ring_write and only one (possibly
+///       different) thread may call lor_ring_read and lor_ring_release.
+typedef struct lor_ring {
+  /// @brief The ring storage.
+  unsigned char* b;
+  /// @brief The size of \p b, a power of two.
+  size_t bs;
+  /// @brief The total number of bytes written, modified by the producer.
+  size_t head;
+  /// @brief The total number of bytes released, modified by the consumer.
+  size_t tail;
+} lor_ring_s;
+
+/// @brief Initializes an empty ring using the provided storage \p b.
+/// @param ring The ring to initialize.
+/// @param b The ring storage buffer.
+/// @param bs The size of \p b, a power of two.
+/// @return 0 on success, -1 for invalid arguments.
+int lor_ring_init(lor_ring_s* ring, unsigned char* b, size_t bs);
+
+/// @brief Encodes as many of the \p rs requests into the ring as fit in its
+///        free space, then publishes them to the consumer at once. Requests
+///        are never split.
+/// @param ring The ring to write to, from the producer thread.
+/// @param r The requests to write.
+/// @param rs The number of requests in \p r.
+/// @return The number of requests written.
+size_t lor_ring_write(lor_ring_s* ring, const lor_req_s* r, size_t rs);
+
+/// @brief Returns the longest contiguous run of published bytes available to
+///        read, which remain valid until released by lor_ring_release.
+/// @param ring The ring to read from, from the consumer thread.
+/// @param n Set to the number of bytes available at the returned pointer.
+/// @return A pointer to the bytes available to read.
+const unsigned char* lor_ring_read(lor_ring_s* ring, size_t* n);
+
+/// @brief Releases \p n bytes returned by lor_ring_read (e.g. once written to
+///        the serial port), making their space available to the producer.
+/// @param ring The ring to release bytes from, from the consumer thread.
+/// @param n The number of bytes to release.
+void lor_ring_release(lor_ring_s* ring, size_t n);
+
+/// @brief Partitions requests by network, keeping their order within each
+///        network, e.g. to encode each network with lor_net_submit. Requests
+///        for the broadcast unit (0xFF) are copied to every network.
+/// @param r The requests to partition.
+/// @param rs The number of requests in \p r.
+/// @param net The network of each unit, indexed by unit. Requests for units
+///            mapped to a network of \p ns or greater are dropped.
+/// @param ns The number of networks.
+/// @param out The buffer to write the partitioned requests to.
+/// @param os The maximum number of requests to write to \p out.
+/// @param first Set to the index within \p out of the first request of each
+///              network, \p ns + 1 elements, so network i's requests are
+///              [first[i], first[i + 1]).
+/// @return The number of partitioned requests. If greater than \p os,
+///         nothing was written to \p out and the caller should retry with a
+///         buffer of this size.
+size_t lor_shard(const lor_req_s* r, size_t rs, const unsigned char* net,
+                 size_t ns, lor_req_s* out, size_t os, size_t* first);
+
+#ifdef TINYLOR_STATS
+
+/// @struct lor_stats
+/// @brief Represents statistics collected by the encoder when TINYLOR_STATS is
+///        defined. Requests are counted each time they are encoded by any
+///        function (requests copied from a lor_cache_s are not re-encoded),
+///        except lor_batch_write which is not instrumented.
+/// @note Statistics are global and not synchronized between threads. Batch
+///       encoding time is only measured if TINYLOR_STATS_CLOCK is defined as
+///       an expression returning a nanosecond timestamp (unsigned long long).
+typedef struct lor_stats {
+  /// @brief The number of requests encoded per effect, indexed by lor_effect.
+  unsigned long effects[LOR_SET_DMX_INTENSITY + 1];
+  /// @brief The number of requests encoded per channel set format, indexed by
+  ///        the lor_channel_format value shifted right by 4 bits.
+  unsigned long formats[(LOR_FMT_MULTIPART >> 4) + 1];
+  /// @brief The number of requests encoded.
+  unsigned long requests;
+  /// @brief The number of bytes encoded.
+  unsigned long long bytes;
+  /// @brief The number of lor_write calls.
+  unsigned long batches;
+  /// @brief The number of requests lor_write could not write for lack of
+  ///        buffer space.
+  unsigned long overflows;
+  /// @brief The total time spent in lor_write calls in nanoseconds.
+  unsigned long long batch_ns;
+} lor_stats_s;
+
+/// @typedef lor_stats_fn
+/// @brief Represents a function called after each request is encoded.
+typedef void (*lor_stats_fn)(const lor_req_s* req, size_t size, void* ctx);
+
+/// @brief Copies a snapshot of the statistics collected so far into \p s.
+/// @param s The statistics to write to.
+void lor_stats_get(lor_stats_s* s);
+
+/// @brief Resets every statistic to zero.
+void lor_stats_reset(void);
+
+/// @brief Sets (or clears, if \p fn is NULL) a function to be called after
+///        each request is encoded with the request, its encoded size and \p ctx.
+/// @param fn The function to call.
+/// @param ctx The context passed to \p fn.
+void lor_stats_hook(lor_stats_fn fn, void* ctx);
+
+#endif// TINYLOR_STATS
+
+#ifdef TINYLOR_POSIX
+
+/// @brief Configures an open serial port (or pseudo terminal) for the LOR
+///        protocol: raw 8N1 mode at \p baud baud, non-blocking, and where
+///        supported by the driver, low latency mode.
+/// @note Available when TINYLOR_POSIX is defined. The POSIX and X/Open APIs
+///       used require _XOPEN_SOURCE 700 (or an equivalent feature test macro)
+///       to be defined before any system header is included. Hardware flow
+///       control is only disabled if the non-standard CRTSCTS flag is visible,
+///       which requires e.g. _DEFAULT_SOURCE (glibc, the BSDs), _GNU_SOURCE
+///       or _DARWIN_C_SOURCE (macOS) to also be defined.
+/// @param fd The file descriptor of the serial port.
+/// @param baud The baud rate, e.g. 57600 or 115200.
+/// @return 0 on success, -1 on error (see errno).
+int lor_serial_configure(int fd, unsigned long baud);
+
+/// @brief Opens and configures the serial port at \p path using
+///        lor_serial_configure.
+/// @param path The path of the serial port device, e.g. "/dev/ttyUSB0".
+/// @param baud The baud rate, e.g. 57600 or 115200.
+/// @return The file descriptor of the opened port, or -1 on error.
+int lor_serial_open(const char* path, unsigned long baud);
+
+/// @brief Sends the \p iovcnt buffers of \p iov using as few writev calls as
+///        the port accepts, waiting up to \p timeout_ms milliseconds for the
+///        port to become writable whenever it is full. The buffers of \p iov
+///        are advanced past the bytes sent, so a timed out send may be resumed
+///        by calling the function again with the same arguments.
+/// @param fd The file descriptor of the serial port.
+/// @param iov The buffers to send, modified to exclude the bytes sent.
+/// @param iovcnt The number of buffers in \p iov.
+/// @param timeout_ms The maximum time to wait for the port, or -1 to wait
+///                   indefinitely.
+/// @return The number of bytes sent, less than the total if the send timed
+///         out, or -1 on error (see errno).
+long lor_serial_send(int fd, struct iovec* iov, int iovcnt, int timeout_ms);
+
+/// @brief Encodes \p rs requests into the scratch buffer \p b using lor_write,
+///        then sends the whole frame using lor_serial_send.
+/// @param fd The file descriptor of the serial port.
+/// @param b The scratch buffer to encode into, see lor_write_size.
+/// @param bs The size of \p b.
+/// @param r The requests to send.
+/// @param rs The number of requests in \p r.
+/// @param timeout_ms See lor_serial_send.
+/// @return The number of bytes sent, or -1 on error (see errno), including a
+///         scratch buffer too small to hold every request.
+long lor_serial_write(int fd, unsigned char* b, size_t bs, const lor_req_s* r,
+                      size_t rs, int timeout_ms);
+
+/// @brief Returns the current CLOCK_MONOTONIC time in nanoseconds, suitable
+///        for the stream, scheduler and clock functions.
+unsigned long long lor_clock_now(void);
+
+/// @brief Sleeps until the next deadline of the clock using an absolute
+///        CLOCK_MONOTONIC sleep (which does not accumulate drift), then ticks.
+/// @param c The clock to wait for.
+/// @return The number of deadlines skipped by the tick, or -1 on error.
+long lor_clock_wait(lor_clock_s* c);
+
+/// @brief Maps a compiled show file into memory read-only and opens it with
+///        lor_show_open, so startup time is independent of the show length.
+/// @param s The show to initialize, released with lor_show_unmap.
+/// @param path The path of the compiled show file.
+/// @return 0 on success, -1 on error (see errno, EINVAL if the file is not a
+///         valid compiled show).
+int lor_show_map(lor_show_s* s, const char* path);
+
+/// @brief Unmaps a show mapped by lor_show_map.
+/// @param s The show to unmap.
+void lor_show_unmap(lor_show_s* s);
+
+/// @brief Plays a show from frame \p i to its end at the show's frame period,
+///        sending each pre-encoded frame as-is with lor_serial_send, so
+///        playback neither encodes nor allocates. Heartbeats are sent ahead of
+///        frames at the cadence of \p LOR_HEARTBEAT_DELAY_NS. Frames whose
+///        deadline passed while a previous frame was sent are skipped, keeping
+///        the show in time.
+/// @param fd The file descriptor of the serial port.
+/// @param s The show to play.
+/// @param i The index of the first frame to play.
+/// @return The number of frames skipped, or -1 on error (see errno).
+long lor_show_play(int fd, const lor_show_s* s, unsigned long i);
+
+#ifdef TINYLOR_THREADS
+
+/// @struct lor_net
+/// @brief Represents the output of a network (serial port) driven by its own
+///        encoder and writer threads, connected by a lor_ring_s. Frames are
+///        handed to the encoder with lor_net_submit, so each network is
+///        encoded on its own core, and a slow port only stalls its own
+///        encoder once its ring is full rather than every network.
+/// @note Available when TINYLOR_POSIX and TINYLOR_THREADS are defined, which
+///       requires linking with POSIX threads. The fields are private.
+typedef struct lor_net {
+  /// @brief The encoded bytes waiting to be written to the port.
+  lor_ring_s ring;
+  /// @brief The file descriptor of the port.
+  int fd;
+  /// @brief The requests of the submitted frame.
+  const lor_req_s* r;
+  /// @brief The number of requests in \p r.
+  size_t rs;
+  /// @brief Non-zero while the submitted frame is being encoded.
+  int pending;
+  /// @brief Non-zero once the threads are asked to exit.
+  int stop;
+  /// @brief The errno of the first failed write, or zero.
+  int err;
+  /// @brief Guards \p pending, \p stop and \p err, and the waits for ring
+  ///        space and data (the ring itself is lock-free).
+  pthread_mutex_t lock;
+  /// @brief Signalled whenever a frame is submitted or encoded, and whenever
+  ///        bytes are published to or released from the ring.
+  pthread_cond_t cond;
+  /// @brief The encoder thread.
+  pthread_t encoder;
+  /// @brief The writer thread.
+  pthread_t writer;
+} lor_net_s;
+
+/// @brief Starts the encoder and writer threads of a network.
+/// @param n The network to start.
+/// @param fd The file descriptor of the port, e.g. from lor_serial_open.
+/// @param b The ring storage buffer.
+/// @param bs The size of \p b, a power of two of at least LOR_REQ_MAX_SIZE.
+/// @return 0 on success, -1 on error.
+int lor_net_start(lor_net_s* n, int fd, unsigned char* b, size_t bs);
+
+/// @brief Hands a frame to the encoder of a network, first waiting for the
+///        previous frame to be encoded. The requests must not be modified
+///        until the frame is encoded (see lor_net_sync).
+/// @param n The network to write to.
+/// @param r The requests of the frame.
+/// @param rs The number of requests in \p r.
+/// @return 0 on success, -1 if a previous write to the port failed (the
+///         frame is not submitted, see lor_net_stop).
+int lor_net_submit(lor_net_s* n, const lor_req_s* r, size_t rs);
+
+/// @brief Waits for the submitted frame of a network to be encoded, after
+///        which its requests may be reused.
+/// @param n The network to wait for.
+void lor_net_sync(lor_net_s* n);
+
+/// @brief Waits for the submitted frame to be encoded and written, then stops
+///        the threads of a network. The port is not closed.
+/// @param n The network to stop.
+/// @return 0 on success, -1 if a write to the port failed (errno is set to
+///         its error).
+int lor_net_stop(lor_net_s* n);
+
+#endif// TINYLOR_THREADS
+
+#endif// TINYLOR_POSIX
+
 #endif// TINYLOR_H
 
 #ifdef TINYLOR_IMPL
@@ -361,7 +1736,7 @@ static int lor_encode_effect(unsigned char* const b, const lor_effect e,
     case LOR_FADE:
       b[w++] = d->fade.start_intensity;
       b[w++] = d->fade.end_intensity;
-      w += lor_encode_decis(b, d->fade.deciseconds);
+      w += lor_encode_decis(&b[w], d->fade.deciseconds);
       break;
     case LOR_PULSE:
       b[w++] = d->pulse.deciseconds;
@@ -375,32 +1750,1896 @@ static int lor_encode_effect(unsigned char* const b, const lor_effect e,
   return w;
 }
 
+/// @brief Returns the number of bytes used by the arguments of an effect.
+/// @param e The effect to measure.
+/// @return The encoded size of the effect arguments in bytes.
+static int lor_effect_size(const lor_effect e) {
+  switch (e) {
+    case LOR_SET_INTENSITY:
+    case LOR_PULSE:
+    case LOR_SET_DMX_INTENSITY:
+      return 1;
+    case LOR_FADE:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+size_t lor_req_size(const lor_req_s* const req) {
+  // header (0, unit, effect|format), offset byte, and trailing 0
+  return 5 + lor_effect_size(req->effect) + !!(req->cset.cbits & 0xFF) +
+         !!(req->cset.cbits >> 8);
+}
+
+size_t lor_write_size(const lor_req_s* r, const size_t rs) {
+  size_t n = 0;
+  for (size_t i = 0; i < rs; i++) n += lor_req_size(&r[i]);
+  return n;
+}
+
+#ifdef TINYLOR_STATS
+/// @brief The statistics collected since the last lor_stats_reset.
+static lor_stats_s lor_stats;
+/// @brief The optional hook called for each encoded request.
+static lor_stats_fn lor_stats_hook_fn;
+/// @brief The context passed to \p lor_stats_hook_fn.
+static void* lor_stats_hook_ctx;
+
+void lor_stats_get(lor_stats_s* s) { *s = lor_stats; }
+
+void lor_stats_reset(void) { lor_stats = (lor_stats_s){0}; }
+
+void lor_stats_hook(const lor_stats_fn fn, void* ctx) {
+  lor_stats_hook_fn = fn;
+  lor_stats_hook_ctx = ctx;
+}
+
+/// @brief Records an encoded request and calls the hook, if any.
+/// @param req The encoded request.
+/// @param fmt The channel set format used to encode the request.
+/// @param w The encoded size of the request.
+static void lor_stats_encode(const lor_req_s* const req,
+                             const lor_channel_format fmt, const int w) {
+  lor_stats.requests++;
+  lor_stats.bytes += w;
+  if (req->effect < sizeof(lor_stats.effects) / sizeof(lor_stats.effects[0]))
+    lor_stats.effects[req->effect]++;
+  lor_stats.formats[fmt >> 4]++;
+  if (lor_stats_hook_fn != NULL)
+    lor_stats_hook_fn(req, (size_t) w, lor_stats_hook_ctx);
+}
+
+#ifdef TINYLOR_STATS_CLOCK
+#define LOR_STATS_START()                                                      \
+  const unsigned long long stats_start = TINYLOR_STATS_CLOCK()
+#define LOR_STATS_BATCH()                                                      \
+  lor_stats.batch_ns += TINYLOR_STATS_CLOCK() - stats_start
+#else
+#define LOR_STATS_START() (void) 0
+#define LOR_STATS_BATCH() (void) 0
+#endif
+#define LOR_STATS_ENCODE(req, fmt, w) lor_stats_encode(req, fmt, w)
+#define LOR_STATS_OVERFLOW(n) (lor_stats.overflows += (n), lor_stats.batches++)
+#define LOR_STATS_WRITE() lor_stats.batches++
+#else
+#define LOR_STATS_START() (void) 0
+#define LOR_STATS_BATCH() (void) 0
+#define LOR_STATS_ENCODE(req, fmt, w) (void) 0
+#define LOR_STATS_OVERFLOW(n) (void) 0
+#define LOR_STATS_WRITE() (void) 0
+#endif// TINYLOR_STATS
+
+/// @brief Encodes a request into a buffer.
+/// @param b The buffer to write the request to.
+/// @param req The request to encode.
+/// @return The number of bytes written to the buffer.
+/// @note Caller is responsible for ensuring buffer is at least
+///       lor_req_size(req) bytes in size.
+static int lor_encode_req(unsigned char* const b, const lor_req_s* const req) {
+  int w = 0;
+  const lor_channel_format fmt = lor_get_cset_format(&req->cset);
+  b[w++] = 0;
+  b[w++] = req->unit;
+  b[w++] = req->effect | fmt;
+  w += lor_encode_effect(&b[w], req->effect, &req->args);
+  w += lor_encode_cset(&b[w], &req->cset);
+  b[w++] = 0;
+  LOR_STATS_ENCODE(req, fmt, w);
+  return w;
+}
+
 size_t lor_write(unsigned char* b, const size_t bs, const lor_req_s* r,
                  const size_t rs) {
+  LOR_STATS_START();
   size_t h = 0;
   for (size_t i = 0; i < rs; i++) {
-    size_t w = 0;
-    unsigned char t[16] = {0};
-    const lor_req_s* const req = &r[i];
-    t[w++] = 0;
-    t[w++] = req->unit;
-    t[w++] = req->effect | lor_get_cset_format(&req->cset);
-    w += lor_encode_effect(&t[w], req->effect, &req->args);
-    w += lor_encode_cset(&t[w], &req->cset);
-    t[w++] = 0;
-    if (w > bs) return w;
-    __builtin_memcpy(&b[h], t, w);
+    const size_t w = lor_req_size(&r[i]);
+    if (w > bs - h) {
+      LOR_STATS_BATCH();
+      LOR_STATS_OVERFLOW(rs - i);
+      return w;
+    }
+    h += lor_encode_req(&b[h], &r[i]);
+  }
+  LOR_STATS_BATCH();
+  LOR_STATS_WRITE();
+  return h;
+}
+
+void lor_encoder_init(lor_encoder_s* enc, const lor_req_s* r,
+                      const size_t rs) {
+  *enc = (lor_encoder_s){.r = r, .rs = rs};
+  enc->pending = lor_write_size(r, rs);
+}
+
+size_t lor_encoder_write(lor_encoder_s* enc, unsigned char* b,
+                         const size_t bs) {
+  size_t h = 0;
+  while (h < bs && enc->pending) {
+    if (!enc->partial_size) {
+      const lor_req_s* const req = &enc->r[enc->consumed];
+      if (lor_req_size(req) <= bs - h) {
+        const size_t w = lor_encode_req(&b[h], req);
+        h += w;
+        enc->produced += w;
+        enc->pending -= w;
+        enc->consumed++;
+        continue;
+      }
+      // split the request, writing the remainder on the following calls
+      enc->partial_size = lor_encode_req(enc->partial, req);
+      enc->partial_off = 0;
+    }
+    size_t w = enc->partial_size - enc->partial_off;
+    if (w > bs - h) w = bs - h;
+    __builtin_memcpy(&b[h], &enc->partial[enc->partial_off], w);
     h += w;
+    enc->produced += w;
+    enc->pending -= w;
+    enc->partial_off += w;
+    if (enc->partial_off == enc->partial_size) {
+      enc->partial_size = 0;
+      enc->consumed++;
+    }
   }
   return h;
 }
 
-lor_intensity lor_get_intensity(const unsigned char b) {
-  // scale b from (0,255) to (240,1) which is the LOR intensity range
-  static const lor_intensity ceiling = 240;
-  return ceiling - (lor_intensity) ((1.0f - ((float) b / 255.0f)) * 239);
+void lor_chunk_split(lor_chunk_s* c, const size_t cs, const size_t rs) {
+  size_t first = 0;
+  for (size_t i = 0; i < cs; i++) {
+    // spread the remainder over the first chunks
+    const size_t count = rs / cs + (i < rs % cs);
+    c[i] = (lor_chunk_s){.first = first, .count = count};
+    first += count;
+  }
+}
+
+void lor_chunk_measure(lor_chunk_s* c, const lor_req_s* r) {
+  c->size = lor_write_size(&r[c->first], c->count);
+}
+
+size_t lor_chunk_offsets(lor_chunk_s* c, const size_t cs) {
+  size_t h = 0;
+  for (size_t i = 0; i < cs; i++) {
+    c[i].offset = h;
+    h += c[i].size;
+  }
+  return h;
+}
+
+size_t lor_chunk_write(unsigned char* b, const lor_chunk_s* c,
+                       const lor_req_s* r) {
+  return lor_write(&b[c->offset], c->size, &r[c->first], c->count);
+}
+
+void lor_batch_init(lor_req_batch_s* batch, lor_unit* unit,
+                    unsigned char* effect, unsigned char* offset,
+                    unsigned short* cbits, unsigned char* args,
+                    const size_t cap) {
+  *batch = (lor_req_batch_s){unit, effect, offset, cbits, args, 0, cap};
+}
+
+int lor_batch_add(lor_req_batch_s* batch, const lor_req_s* req) {
+  if (batch->n >= batch->cap || (unsigned) req->effect > 0x0F) return -1;
+  const size_t i = batch->n++;
+  batch->unit[i] = req->unit;
+  batch->effect[i] = (unsigned char) req->effect;
+  batch->offset[i] = req->cset.offset;
+  batch->cbits[i] = req->cset.cbits;
+  unsigned char* const args = &batch->args[i * 4];
+  __builtin_memset(args, 0, 4);
+  lor_encode_effect(args, req->effect, &req->args);
+  return 0;
+}
+
+/// @brief The encoded argument size of each effect, indexed by lor_effect.
+static const unsigned char lor_effect_sizes[16] = {
+        [LOR_SET_INTENSITY] = 1,
+        [LOR_FADE] = 4,
+        [LOR_PULSE] = 1,
+        [LOR_SET_DMX_INTENSITY] = 1,
+};
+
+/// @brief The lor_channel_format of an unaligned channel set, indexed by
+///        (more than one bit set) << 2 | (high byte set) << 1 | (low byte set).
+static const unsigned char lor_cset_formats[8] = {
+        LOR_FMT_UNIT,   LOR_FMT_SINGLE, LOR_FMT_SINGLE, LOR_FMT_16,
+        LOR_FMT_UNIT,   LOR_FMT_8L,     LOR_FMT_8H,     LOR_FMT_16,
+};
+
+/// @brief The multi-part channel set options, indexed by
+///        (high byte set) << 1 | (low byte set).
+static const unsigned char lor_cset_opts[4] = {0x40, 0x80, 0x40, 0};
+
+/// @brief Returns the encoded size of request \p i of a batch.
+static size_t lor_batch_req_size(const lor_req_batch_s* const batch,
+                                 const size_t i) {
+  const unsigned short cbits = batch->cbits[i];
+  return 5 + lor_effect_sizes[batch->effect[i]] + ((cbits & 0xFF) != 0) +
+         ((cbits >> 8) != 0);
+}
+
+size_t lor_batch_size(const lor_req_batch_s* batch) {
+  size_t n = 0;
+  for (size_t i = 0; i < batch->n; i++) n += lor_batch_req_size(batch, i);
+  return n;
+}
+
+/// @brief Encodes request \p i of a batch into a buffer.
+/// @return The number of bytes written to the buffer.
+/// @note Caller is responsible for ensuring the buffer is at least
+///       LOR_REQ_MAX_SIZE bytes in size, trailing bytes may be overwritten.
+static size_t lor_batch_encode_req(unsigned char* const b,
+                                   const lor_req_batch_s* const batch,
+                                   const size_t i) {
+  const unsigned char off = batch->offset[i];
+  const unsigned short cbits = batch->cbits[i];
+  const unsigned char low = cbits & 0xFF;
+  const unsigned char high = cbits >> 8;
+  const int lh = (high != 0) << 1 | (low != 0);
+  const int many = (cbits & (cbits - 1)) != 0;
+  const unsigned char fmt =
+          off ? LOR_FMT_MULTIPART : lor_cset_formats[many << 2 | lh];
+  size_t w = 3 + lor_effect_sizes[batch->effect[i]];
+  b[0] = 0;
+  b[1] = batch->unit[i];
+  b[2] = batch->effect[i] | fmt;
+  __builtin_memcpy(&b[3], &batch->args[i * 4], 4);
+  b[w++] = off | (off ? lor_cset_opts[lh] : 0);
+  b[w] = low;
+  w += low != 0;
+  b[w] = high;
+  w += high != 0;
+  b[w++] = 0;
+  return w;
+}
+
+size_t lor_batch_write(unsigned char* b, const size_t bs,
+                       const lor_req_batch_s* batch) {
+  size_t h = 0, i = 0;
+  // encode directly into the buffer while a full-size request always fits
+  for (; i < batch->n && bs - h >= LOR_REQ_MAX_SIZE; i++)
+    h += lor_batch_encode_req(&b[h], batch, i);
+  for (; i < batch->n; i++) {
+    const size_t w = lor_batch_req_size(batch, i);
+    if (w > bs - h) return w;
+    unsigned char tmp[LOR_REQ_MAX_SIZE];
+    lor_batch_encode_req(tmp, batch, i);
+    __builtin_memcpy(&b[h], tmp, w);
+    h += w;
+  }
+  return h;
+}
+
+/// @brief Decodes a 2-byte decisecond value encoded by lor_encode_decis.
+/// @param b The buffer to read the decisecond value from.
+/// @return The decoded decisecond value.
+static lor_decisec lor_decode_decis(const unsigned char* const b) {
+  if (b[0] & 0x80) return b[1];
+  if (b[0] & 0x40) return (lor_decisec) ((b[0] & 0x3F) << 8);
+  return (lor_decisec) (b[0] << 8 | b[1]);
+}
+
+/// @brief Decodes a single request from a buffer.
+/// @param b The buffer to read the request from, starting with the 0 header.
+/// @param bs The size of the buffer.
+/// @param req The request to decode into.
+/// @return The number of bytes consumed, 0 if the buffer ends before the
+///         request does, or -1 if the bytes are not a valid request.
+static int lor_decode_req(const unsigned char* const b, const size_t bs,
+                          lor_req_s* const req) {
+  if (bs < 3) return 0;
+  const int e = b[2] & 0x0F;
+  const int fmt = b[2] & 0xF0;
+  if (e < LOR_SET_LIGHTS || e > LOR_SET_DMX_INTENSITY) return -1;
+  if (fmt > LOR_FMT_MULTIPART) return -1;
+  size_t w = 3 + lor_effect_size((lor_effect) e);
+  if (bs < w + 1) return 0;
+  const unsigned char* const d = &b[3];
+  lor_effect_args_u args = {0};
+  switch (e) {
+    case LOR_SET_INTENSITY:
+      args.set_intensity.intensity = d[0];
+      break;
+    case LOR_FADE:
+      args.fade.start_intensity = d[0];
+      args.fade.end_intensity = d[1];
+      args.fade.deciseconds = lor_decode_decis(&d[2]);
+      break;
+    case LOR_PULSE:
+      args.pulse.deciseconds = d[0];
+      break;
+    case LOR_SET_DMX_INTENSITY:
+      args.set_dmx_intensity.output = d[0];
+      break;
+    default:
+      break;
+  }
+  // determine which halves of the bitset follow the offset byte
+  const unsigned char off = b[w++];
+  int low = 0, high = 0;
+  switch (fmt) {
+    case LOR_FMT_SINGLE:
+    case LOR_FMT_8L:
+      low = 1;
+      break;
+    case LOR_FMT_16:
+      low = high = 1;
+      break;
+    case LOR_FMT_8H:
+      high = 1;
+      break;
+    case LOR_FMT_MULTIPART:
+      if ((off & 0xC0) == 0xC0) return -1;
+      low = !(off & 0x40);
+      high = !(off & 0x80);
+      break;
+    default:
+      break;
+  }
+  if (fmt != LOR_FMT_MULTIPART && off) return -1;
+  if (fmt == LOR_FMT_MULTIPART && high && !low) {
+    // an empty multipart set is written as an 8H offset byte alone, and a
+    // high byte is never zero, so a zero byte is the terminator
+    if (bs < w + 1) return 0;
+    if (!b[w]) high = 0;
+  }
+  if (bs < w + low + high + 1) return 0;
+  unsigned short cbits = 0;
+  if (low) cbits = b[w++];
+  if (high) cbits |= b[w++] << 8;
+  if (low && !(cbits & 0xFF)) return -1;
+  if (high && !(cbits >> 8)) return -1;
+  if (fmt == LOR_FMT_SINGLE && (cbits & (cbits - 1))) return -1;
+  if (b[w++]) return -1;
+  lor_set_unit(req, b[1]);
+  lor_set_effect(req, (lor_effect) e, &args);
+  req->cset = (lor_channel_set){(unsigned char) (off & 0x3F), cbits};
+  return (int) w;
+}
+
+size_t lor_read(const unsigned char* b, const size_t bs, lor_req_s* r,
+                const size_t rs, size_t* n) {
+  size_t h = 0, i = 0;
+  while (h < bs && i < rs) {
+    if (b[h]) {
+      h++;// resync to the next possible request header
+      continue;
+    }
+    const size_t len = bs - h;
+    const size_t hb = len < LOR_HEARTBEAT_SIZE ? len : LOR_HEARTBEAT_SIZE;
+    if (!__builtin_memcmp(&b[h], LOR_HEARTBEAT_BYTES, hb)) {
+      if (len < LOR_HEARTBEAT_SIZE) break;
+      h += LOR_HEARTBEAT_SIZE;
+      continue;
+    }
+    const int w = lor_decode_req(&b[h], len, &r[i]);
+    if (!w) break;
+    if (w < 0) {
+      h++;
+      continue;
+    }
+    h += w;
+    i++;
+  }
+  if (n != NULL) *n = i;
+  return h;
 }
 
+/// @brief Compares the effect and any effect arguments used by two requests.
+/// @param a The first request to compare.
+/// @param b The second request to compare.
+/// @return Non-zero if the requests apply the same effect, otherwise zero.
+static int lor_effect_equal(const lor_req_s* const a,
+                            const lor_req_s* const b) {
+  if (a->effect != b->effect) return 0;
+  switch (a->effect) {
+    case LOR_SET_INTENSITY:
+      return a->args.set_intensity.intensity == b->args.set_intensity.intensity;
+    case LOR_FADE:
+      return a->args.fade.start_intensity == b->args.fade.start_intensity &&
+             a->args.fade.end_intensity == b->args.fade.end_intensity &&
+             a->args.fade.deciseconds == b->args.fade.deciseconds;
+    case LOR_PULSE:
+      return a->args.pulse.deciseconds == b->args.pulse.deciseconds;
+    case LOR_SET_DMX_INTENSITY:
+      return a->args.set_dmx_intensity.output ==
+             b->args.set_dmx_intensity.output;
+    default:
+      return 1;
+  }
+}
+
+/// @brief Determines whether two requests may apply to any of the same
+///        channels, including via broadcast units and unit-wide channel sets.
+/// @param a The first request to compare.
+/// @param b The second request to compare.
+/// @return Non-zero if the requests overlap, otherwise zero.
+static int lor_req_overlaps(const lor_req_s* const a,
+                            const lor_req_s* const b) {
+  if (a->unit != b->unit && a->unit != 0xFF && b->unit != 0xFF) return 0;
+  if (!a->cset.cbits || !b->cset.cbits) return 1;
+  return a->cset.offset == b->cset.offset && (a->cset.cbits & b->cset.cbits);
+}
+
+size_t lor_coalesce(lor_req_s* r, const size_t rs) {
+  size_t n = 0;
+  for (size_t i = 0; i < rs; i++) {
+    const lor_req_s* const req = &r[i];
+    int merged = 0;
+    for (size_t k = n; req->cset.cbits && k > 0; k--) {
+      lor_req_s* const prior = &r[k - 1];
+      if (prior->unit == req->unit && prior->cset.offset == req->cset.offset &&
+          prior->cset.cbits && lor_effect_equal(prior, req)) {
+        prior->cset.cbits |= req->cset.cbits;
+        merged = 1;
+        break;
+      }
+      if (lor_req_overlaps(prior, req)) break;
+    }
+    if (!merged) r[n++] = *req;
+  }
+  return n;
+}
+
+// Tags of the scratch indices used by lor_fold_broadcast.
+#define LOR_FOLD_MEMBER ((size_t) 1 << (sizeof(size_t) * 8 - 1))
+#define LOR_FOLD_MAJOR (LOR_FOLD_MEMBER >> 1)
+#define LOR_FOLD_FIRST (LOR_FOLD_MEMBER >> 2)
+#define LOR_FOLD_INDEX (LOR_FOLD_FIRST - 1)
+
+/// @brief Returns non-zero if request \p a orders before request \p b, by
+///        channel set then index.
+static int lor_fold_less(const lor_req_s* const r, const size_t a,
+                         const size_t b) {
+  const lor_channel_set* const x = &r[a].cset;
+  const lor_channel_set* const y = &r[b].cset;
+  if (x->offset != y->offset) return x->offset < y->offset;
+  if (x->cbits != y->cbits) return x->cbits < y->cbits;
+  return a < b;
+}
+
+/// @brief Restores the max-heap property of the subtree rooted at \p i.
+static void lor_fold_sift(const lor_req_s* const r, size_t* const idx,
+                          size_t i, const size_t n) {
+  for (size_t c; (c = 2 * i + 1) < n; i = c) {
+    if (c + 1 < n && lor_fold_less(r, idx[c], idx[c + 1])) c++;
+    if (!lor_fold_less(r, idx[i], idx[c])) return;
+    const size_t t = idx[i];
+    idx[i] = idx[c];
+    idx[c] = t;
+  }
+}
+
+/// @brief Determines whether a request may apply to a unit of the network.
+static int lor_fold_reaches(const lor_req_s* const o,
+                            const unsigned char* const mask) {
+  return o->unit == 0xFF || (mask[o->unit / 8] & 1 << o->unit % 8);
+}
+
+/// @brief Checks whether the bucket of requests sharing a channel set, the
+///        sorted indices [a, b), may be folded into a broadcast request and
+///        if so, tags its members.
+/// @param r The requests.
+/// @param idx The sorted request indices.
+/// @param a The first sorted index of the bucket.
+/// @param b The end of the bucket.
+/// @param mask The 256-bit set of units on the network.
+/// @param us The number of units on the network.
+/// @param reach The number of requests per offset and bit which may apply to
+///              a unit of the network.
+/// @param wide The number of unit-wide requests which may apply to a unit of
+///             the network.
+/// @param total The number of requests which may apply to a unit of the
+///              network.
+static void lor_fold_bucket(const lor_req_s* const r, size_t* const idx,
+                            const size_t a, const size_t b,
+                            const unsigned char* const mask, const size_t us,
+                            size_t reach[64][16], const size_t wide,
+                            const size_t total) {
+  // every unit of the network has exactly one request for the channel set
+  unsigned char seen[32] = {0};
+  size_t count = 0;
+  for (size_t p = a; p < b; p++) {
+    const lor_req_s* const o = &r[idx[p]];
+    if (!lor_fold_reaches(o, mask)) continue;
+    if (o->unit == 0xFF || (seen[o->unit / 8] & 1 << o->unit % 8)) return;
+    seen[o->unit / 8] |= 1 << o->unit % 8;
+    count++;
+  }
+  if (count != us) return;
+  // and no other request to the same channels prevents reordering
+  const lor_channel_set* const cset = &r[idx[a]].cset;
+  if (!cset->cbits) {
+    if (total != count) return;
+  } else {
+    if (wide) return;
+    for (int i = 0; i < 16; i++)
+      if ((cset->cbits & 1 << i) && reach[cset->offset % 64][i] != count)
+        return;
+  }
+  // the first request of the most common effect, which must be shared,
+  // counted per distinct effect (at most one per unit) in order of appearance
+  size_t rep[256], reps = 0, major = 0, best = 0;
+  unsigned char votes[256];
+  for (size_t p = a; p < b; p++) {
+    if (!lor_fold_reaches(&r[idx[p]], mask)) continue;
+    size_t k = 0;
+    while (k < reps && !lor_effect_equal(&r[rep[k]], &r[idx[p]])) k++;
+    if (k == reps) rep[reps++] = idx[p], votes[k] = 0;
+    votes[k]++;
+  }
+  for (size_t k = 0; k < reps; k++)
+    if (votes[k] > best) best = votes[k], major = rep[k];
+  if (best < 2) return;
+  int first = 1;
+  for (size_t p = a; p < b; p++) {
+    if (!lor_fold_reaches(&r[idx[p]], mask)) continue;
+    if (lor_effect_equal(&r[idx[p]], &r[major])) idx[p] |= LOR_FOLD_MAJOR;
+    if (first) idx[p] |= LOR_FOLD_FIRST, first = 0;
+    idx[p] |= LOR_FOLD_MEMBER;
+  }
+}
+
+size_t lor_fold_broadcast(const lor_req_s* r, const size_t rs,
+                          const lor_unit* units, const size_t us, size_t* tmp,
+                          lor_req_s* out) {
+  unsigned char mask[32] = {0};
+  size_t unique = 0;
+  for (size_t i = 0; i < us; i++) {
+    if (units[i] == 0xFF || (mask[units[i] / 8] & 1 << units[i] % 8)) continue;
+    mask[units[i] / 8] |= 1 << units[i] % 8;
+    unique++;
+  }
+  // count the requests reaching the network per channel, to detect overlaps
+  size_t reach[64][16] = {{0}};
+  size_t wide = 0, total = 0;
+  for (size_t i = 0; i < rs; i++) {
+    tmp[i] = i;
+    if (!lor_fold_reaches(&r[i], mask)) continue;
+    total++;
+    if (!r[i].cset.cbits) wide++;
+    for (int b = 0; b < 16; b++)
+      if (r[i].cset.cbits & 1 << b) reach[r[i].cset.offset % 64][b]++;
+  }
+  // bucket the requests by channel set with a heapsort, then check each once
+  for (size_t i = rs / 2; i-- > 0;) lor_fold_sift(r, tmp, i, rs);
+  for (size_t i = rs; i-- > 1;) {
+    const size_t t = tmp[0];
+    tmp[0] = tmp[i];
+    tmp[i] = t;
+    lor_fold_sift(r, tmp, 0, i);
+  }
+  for (size_t a = 0, b; a < rs; a = b) {
+    const lor_channel_set* const cset = &r[tmp[a]].cset;
+    for (b = a + 1; b < rs && r[tmp[b]].cset.offset == cset->offset &&
+                    r[tmp[b]].cset.cbits == cset->cbits;
+         b++)
+      continue;
+    lor_fold_bucket(r, tmp, a, b, mask, unique, reach, wide, total);
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < rs; i++) {
+    // find the sorted position of the request
+    size_t lo = 0, hi = rs;
+    while (hi - lo > 1) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (lor_fold_less(r, i, tmp[mid] & LOR_FOLD_INDEX)) hi = mid;
+      else lo = mid;
+    }
+    const size_t t = tmp[lo];
+    if (!(t & LOR_FOLD_MEMBER)) {
+      out[n++] = r[i];
+      continue;
+    }
+    if (!(t & LOR_FOLD_FIRST)) continue;// written with the first request
+    size_t p = lo;
+    while (!(tmp[p] & LOR_FOLD_MAJOR)) p++;
+    out[n] = r[tmp[p] & LOR_FOLD_INDEX];
+    out[n++].unit = 0xFF;
+    // followed by the members of the bucket using a different effect
+    for (p = lo; p < rs; p++) {
+      const lor_req_s* const o = &r[tmp[p] & LOR_FOLD_INDEX];
+      if (o->cset.offset != r[i].cset.offset ||
+          o->cset.cbits != r[i].cset.cbits)
+        break;
+      if ((tmp[p] & LOR_FOLD_MEMBER) && !(tmp[p] & LOR_FOLD_MAJOR))
+        out[n++] = *o;
+    }
+  }
+  return n;
+}
+
+// The intensity tables below are pre-computed from the following formulas,
+// mapping b in (0,255) to the LOR intensity range of (1,240):
+//   linear:  240 - (lor_intensity) ((1.0f - ((float) b / 255.0f)) * 239)
+//   gamma:   1 + round(239 * pow(b / 255.0, 2.2))
+//   CIE:     1 + round(239 * Y), where L* = b / 255.0 * 100 and
+//            Y = L* > 8 ? pow((L* + 16) / 116, 3) : L* / 903.3
+
+/// @brief Linear intensity conversion table used by lor_get_intensity.
+static const lor_intensity lor_intensity_linear[256] = {
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+        13, 14, 15, 16, 16, 17, 18, 19, 20, 21, 22, 23,
+        24, 25, 26, 27, 28, 29, 30, 31, 31, 32, 33, 34,
+        35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46,
+        46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57,
+        58, 59, 60, 61, 61, 62, 63, 64, 65, 66, 67, 68,
+        69, 70, 71, 72, 73, 74, 75, 76, 76, 77, 78, 79,
+        80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91,
+        91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102,
+        103, 104, 105, 106, 106, 107, 108, 109, 110, 111, 112, 113,
+        114, 115, 116, 117, 118, 119, 120, 121, 121, 122, 123, 124,
+        125, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136,
+        136, 137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147,
+        148, 149, 150, 151, 151, 152, 153, 154, 155, 156, 157, 158,
+        159, 160, 161, 162, 163, 164, 165, 166, 166, 167, 168, 169,
+        170, 171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181,
+        181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191, 192,
+        193, 194, 195, 196, 196, 197, 198, 199, 200, 201, 202, 203,
+        204, 205, 206, 207, 208, 209, 210, 211, 211, 212, 213, 214,
+        215, 216, 217, 218, 219, 220, 221, 222, 223, 224, 225, 226,
+        226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237,
+        238, 239, 240, 240};
+
+/// @brief Gamma 2.2 intensity conversion table used by
+///        lor_get_intensity_gamma.
+static const lor_intensity lor_intensity_gamma[256] = {
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4,
+        4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7,
+        7, 7, 8, 8, 8, 9, 9, 9, 10, 10, 10, 11,
+        11, 11, 12, 12, 12, 13, 13, 14, 14, 14, 15, 15,
+        16, 16, 17, 17, 18, 18, 19, 19, 20, 20, 21, 21,
+        22, 22, 23, 23, 24, 25, 25, 26, 26, 27, 28, 28,
+        29, 30, 30, 31, 31, 32, 33, 34, 34, 35, 36, 36,
+        37, 38, 39, 39, 40, 41, 42, 42, 43, 44, 45, 46,
+        47, 47, 48, 49, 50, 51, 52, 53, 53, 54, 55, 56,
+        57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
+        69, 70, 71, 72, 73, 74, 75, 76, 78, 79, 80, 81,
+        82, 83, 84, 86, 87, 88, 89, 90, 92, 93, 94, 95,
+        96, 98, 99, 100, 102, 103, 104, 105, 107, 108, 109, 111,
+        112, 113, 115, 116, 118, 119, 120, 122, 123, 125, 126, 128,
+        129, 130, 132, 133, 135, 136, 138, 140, 141, 143, 144, 146,
+        147, 149, 150, 152, 154, 155, 157, 159, 160, 162, 164, 165,
+        167, 169, 170, 172, 174, 175, 177, 179, 181, 182, 184, 186,
+        188, 190, 191, 193, 195, 197, 199, 201, 203, 204, 206, 208,
+        210, 212, 214, 216, 218, 220, 222, 224, 226, 228, 230, 232,
+        234, 236, 238, 240};
+
+/// @brief CIE 1931 lightness intensity conversion table used by
+///        lor_get_intensity_cie.
+static const lor_intensity lor_intensity_cie[256] = {
+        1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2,
+        2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+        4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5,
+        5, 5, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7,
+        7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10,
+        10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14,
+        14, 15, 15, 15, 16, 16, 16, 17, 17, 18, 18, 19,
+        19, 19, 20, 20, 21, 21, 22, 22, 23, 23, 24, 24,
+        25, 25, 26, 26, 27, 27, 28, 28, 29, 30, 30, 31,
+        31, 32, 33, 33, 34, 35, 35, 36, 37, 37, 38, 39,
+        39, 40, 41, 42, 42, 43, 44, 45, 45, 46, 47, 48,
+        49, 49, 50, 51, 52, 53, 54, 55, 56, 56, 57, 58,
+        59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70,
+        71, 72, 74, 75, 76, 77, 78, 79, 80, 81, 83, 84,
+        85, 86, 87, 89, 90, 91, 93, 94, 95, 96, 98, 99,
+        100, 102, 103, 105, 106, 107, 109, 110, 112, 113, 115, 116,
+        118, 119, 121, 122, 124, 125, 127, 128, 130, 132, 133, 135,
+        136, 138, 140, 142, 143, 145, 147, 148, 150, 152, 154, 156,
+        157, 159, 161, 163, 165, 167, 169, 171, 172, 174, 176, 178,
+        180, 182, 184, 186, 188, 191, 193, 195, 197, 199, 201, 203,
+        205, 208, 210, 212, 214, 217, 219, 221, 223, 226, 228, 230,
+        233, 235, 238, 240};
+
+lor_intensity lor_get_intensity(const unsigned char b) {
+  return lor_intensity_linear[b];
+}
+
+lor_intensity lor_get_intensity_gamma(const unsigned char b) {
+  return lor_intensity_gamma[b];
+}
+
+lor_intensity lor_get_intensity_cie(const unsigned char b) {
+  return lor_intensity_cie[b];
+}
+
+void lor_get_intensities(lor_intensity* dst, const unsigned char* src,
+                         const size_t n, const lor_intensity_fn fn) {
+  const lor_intensity* t = NULL;
+  lor_intensity custom[256];
+  if (fn == NULL || fn == lor_get_intensity) {
+    t = lor_intensity_linear;
+  } else if (fn == lor_get_intensity_gamma) {
+    t = lor_intensity_gamma;
+  } else if (fn == lor_get_intensity_cie) {
+    t = lor_intensity_cie;
+  } else if (n > 256) {
+    // amortize custom conversion functions by tabulating every input value
+    for (int i = 0; i < 256; i++) custom[i] = fn((unsigned char) i);
+    t = custom;
+  } else {
+    for (size_t i = 0; i < n; i++) dst[i] = fn(src[i]);
+    return;
+  }
+  for (size_t i = 0; i < n; i++) dst[i] = t[src[i]];
+}
+
+void lor_dirty_init(lor_dirty_s* d) { __builtin_memset(d, 0, sizeof(*d)); }
+
+void lor_dirty_mark(lor_dirty_s* d, const lor_unit u, const lor_channel c) {
+  if (c >= 1024) return;
+  d->cbits[u][c / 16] |= 1 << (c % 16);
+  d->banks[u] |= 1ULL << (c / 16);
+  d->units[u / 64] |= 1ULL << (u % 64);
+}
+
+void lor_dirty_mark_set(lor_dirty_s* d, const lor_unit u,
+                        const lor_channel_set* cset) {
+  if (!cset->cbits || cset->offset >= 64) return;
+  d->cbits[u][cset->offset] |= cset->cbits;
+  d->banks[u] |= 1ULL << cset->offset;
+  d->units[u / 64] |= 1ULL << (u % 64);
+}
+
+int lor_dirty_next(lor_dirty_s* d, lor_unit* u, lor_channel_set* cset) {
+  for (int w = 0; w < 4; w++) {
+    if (!d->units[w]) continue;
+    const int unit = w * 64 + __builtin_ctzll(d->units[w]);
+    const int bank = __builtin_ctzll(d->banks[unit]);
+    *u = (lor_unit) unit;
+    *cset = (lor_channel_set){(unsigned char) bank, d->cbits[unit][bank]};
+    d->cbits[unit][bank] = 0;
+    d->banks[unit] &= d->banks[unit] - 1;
+    if (!d->banks[unit]) d->units[w] &= d->units[w] - 1;
+    return 1;
+  }
+  return 0;
+}
+
+int lor_frame_init(lor_frame_s* f, lor_intensity* b, const lor_unit first,
+                   const lor_unit units, const lor_channel channels) {
+  if (b == NULL || !units || !channels || channels > 1024) return -1;
+  const size_t n = (size_t) units * channels;
+  __builtin_memset(b, 0, n * 2);
+  f->cur = b;
+  f->prev = &b[n];
+  f->fn = lor_get_intensity;
+  f->channels = channels;
+  f->first = first;
+  f->units = units;
+  f->dirty = NULL;
+  return 0;
+}
+
+void lor_frame_track(lor_frame_s* f, lor_dirty_s* d) {
+  f->dirty = d;
+  if (d == NULL) return;
+  for (int u = 0; u < f->units; u++) {
+    for (int c = 0; c < f->channels; c += 16) {
+      const int len = f->channels - c < 16 ? f->channels - c : 16;
+      const lor_channel_set cset = {(unsigned char) (c / 16),
+                                    (unsigned short) ((1UL << len) - 1)};
+      lor_dirty_mark_set(d, (lor_unit) (f->first + u), &cset);
+    }
+  }
+}
+
+int lor_frame_set(lor_frame_s* f, const lor_unit u, const lor_channel c,
+                  const unsigned char b) {
+  if (u < f->first || u - f->first >= f->units || c >= f->channels) return -1;
+  const size_t i = (size_t) (u - f->first) * f->channels + c;
+  f->cur[i] = f->fn(b);
+  if (f->dirty != NULL && f->cur[i] != f->prev[i])
+    lor_dirty_mark(f->dirty, u, c);
+  return 0;
+}
+
+/// @brief Writes the requests applying the changes of one bank of 16 channels.
+/// @param f The frame to compare.
+/// @param u The unit index of the bank, relative to the first unit.
+/// @param c The first channel of the bank.
+/// @param r The request buffer to write to.
+/// @param rs The maximum number of requests to write.
+/// @param n The number of requests already written, updated.
+/// @return The changed channels of the bank not written due to lack of space.
+static unsigned short lor_frame_diff_bank(lor_frame_s* f, const int u,
+                                          const int c, lor_req_s* r,
+                                          const size_t rs, size_t* n) {
+  const size_t base = (size_t) u * f->channels;
+  const lor_intensity* const cur = &f->cur[base + c];
+  lor_intensity* const prev = &f->prev[base + c];
+  const int len = f->channels - c < 16 ? f->channels - c : 16;
+  unsigned short changed = 0;
+  for (int i = 0; i < len; i++)
+    if (cur[i] != prev[i]) changed |= 1 << i;
+  while (changed) {
+    if (*n == rs) return changed;
+    // group all changed channels in the bank sharing the same intensity
+    const lor_intensity v = cur[__builtin_ctz(changed)];
+    unsigned short cbits = 0;
+    for (int i = __builtin_ctz(changed); i < len; i++) {
+      if (!(changed & (1 << i)) || cur[i] != v) continue;
+      cbits |= 1 << i;
+      prev[i] = v;
+    }
+    changed &= ~cbits;
+    lor_req_s* const req = &r[(*n)++];
+    lor_set_unit(req, (lor_unit) (f->first + u));
+    req->cset = (lor_channel_set){(unsigned char) (c / 16), cbits};
+    lor_set_intensity(req, v);
+  }
+  return 0;
+}
+
+size_t lor_frame_diff(lor_frame_s* f, lor_req_s* r, const size_t rs) {
+  size_t n = 0;
+  if (f->dirty != NULL) {
+    lor_unit u;
+    lor_channel_set cset;
+    while (lor_dirty_next(f->dirty, &u, &cset)) {
+      const int c = cset.offset * 16;
+      if (u < f->first || u - f->first >= f->units || c >= f->channels)
+        continue;
+      cset.cbits = lor_frame_diff_bank(f, u - f->first, c, r, rs, &n);
+      if (cset.cbits) {
+        // leave the unwritten changes pending for the next call
+        lor_dirty_mark_set(f->dirty, u, &cset);
+        return n;
+      }
+    }
+    return n;
+  }
+  for (int u = 0; u < f->units; u++)
+    for (int c = 0; c < f->channels; c += 16)
+      if (lor_frame_diff_bank(f, u, c, r, rs, &n)) return n;
+  return n;
+}
+
+/// @brief Returns the duration of a ramp of \p d frames rounded to the nearest
+///        decisecond, the duration of the fade replacing it.
+static long long lor_fit_decis(const long long d,
+                               const unsigned short period_ms) {
+  return (d * period_ms + 50) / 100;
+}
+
+/// @brief Finds the furthest frame a linear ramp starting at frame \p i may
+///        end at, such that the fade replacing it, whose duration is rounded
+///        to the nearest decisecond, is within \p tol of every intensity it
+///        covers.
+/// @param t The intensity of the channel at each frame.
+/// @param n The number of frames in \p t.
+/// @param i The starting frame of the ramp.
+/// @param period_ms The period of each frame in milliseconds.
+/// @param tol The maximum difference allowed between an intensity and a ramp.
+/// @return The last frame of the ramp, or \p i if no ramp is possible.
+static size_t lor_fit_ramp(const lor_intensity* const t, const size_t n,
+                           const size_t i, const unsigned short period_ms,
+                           const int tol) {
+  // slopes (in intensity per frame) allowed by every frame so far, kept as
+  // fractions to avoid rounding: lo_n / lo_d <= slope <= hi_n / hi_d
+  long long lo_n = -1000, lo_d = 1, hi_n = 1000, hi_d = 1;
+  size_t end = i;
+  for (size_t k = i + 1; k < n; k++) {
+    const long long d = (long long) (k - i);
+    const long long dv = t[k] - t[i];
+    if ((dv - tol) * lo_d > lo_n * d) lo_n = dv - tol, lo_d = d;
+    if ((dv + tol) * hi_d < hi_n * d) hi_n = dv + tol, hi_d = d;
+    if (lo_n * hi_d > hi_n * lo_d) break;
+    const long long ds = lor_fit_decis(d, period_ms);
+    if (d < 2 || !dv || !ds || ds > 0xFFFF) continue;
+    // the ramp may end at k if the slope of the rounded fade, dv * period_ms
+    // per ds * 100 ms, satisfies every frame up to k
+    const long long sn = dv * period_ms, sd = ds * 100;
+    if (sn * lo_d < lo_n * sd || sn * hi_d > hi_n * sd) continue;
+    // a fade rounded down finishes early and holds t[k] for the last frames
+    int held = 1;
+    for (long long j = d; held && j * period_ms > sd; j--) {
+      const long long err = t[i + (size_t) j] - t[k];
+      held = err <= tol && -err <= tol;
+    }
+    if (held) end = k;
+  }
+  return end;
+}
+
+size_t lor_fit_fades(const lor_intensity* t, const size_t n,
+                     const unsigned short period_ms, const unsigned char tol,
+                     const lor_req_s* target, lor_event_s* e,
+                     const size_t es) {
+  size_t w = 0;
+  int state = -1;// the intensity of the channel once the last event is sent
+  for (size_t i = 0; i < n && w < es;) {
+    lor_event_s* const ev = &e[w];
+    ev->frame = i;
+    ev->req = *target;
+    const size_t end = period_ms ? lor_fit_ramp(t, n, i, period_ms, tol) : i;
+    if (end > i) {
+      const lor_decisec ds =
+              (lor_decisec) lor_fit_decis((long long) (end - i), period_ms);
+      lor_set_fade(&ev->req, t[i], t[end], ds);
+      w++;
+      state = t[end];
+      i = end;
+      continue;
+    }
+    if (t[i] != state) {
+      lor_set_intensity(&ev->req, t[i]);
+      w++;
+      state = t[i];
+    }
+    i++;
+  }
+  return w;
+}
+
+void lor_dmx_init(lor_dmx_s* d, const lor_dmx_map_s* map, lor_frame_s* f) {
+  d->map = map;
+  d->frame = f;
+  d->primed = 0;
+}
+
+size_t lor_dmx_update(lor_dmx_s* d, const unsigned char* u, size_t n) {
+  if (n > LOR_DMX_SLOTS) n = LOR_DMX_SLOTS;
+  size_t w = 0;
+  for (size_t i = 0; i < n; i++) {
+    // skip unchanged runs of 8 slots with a single comparison
+    if (d->primed && !(i % 8) && n - i >= 8 &&
+        !__builtin_memcmp(&u[i], &d->prev[i], 8)) {
+      i += 7;
+      continue;
+    }
+    if (d->primed && u[i] == d->prev[i]) continue;
+    d->prev[i] = u[i];
+    const lor_dmx_map_s* const m = &d->map[i];
+    if (m->unit && !lor_frame_set(d->frame, m->unit, m->channel, u[i])) w++;
+  }
+  d->primed = 1;
+  return w;
+}
+
+/// @brief Returns non-zero if patch entry \p a orders before \p b.
+static int lor_patch_less(const lor_patch_entry_s* const a,
+                          const lor_patch_entry_s* const b) {
+  if (a->addr.unit != b->addr.unit) return a->addr.unit < b->addr.unit;
+  if (a->addr.channel != b->addr.channel)
+    return a->addr.channel < b->addr.channel;
+  return a->logical < b->logical;
+}
+
+/// @brief Restores the max-heap property of the subtree rooted at \p i.
+static void lor_patch_sift(lor_patch_entry_s* const e, size_t i,
+                           const size_t n) {
+  for (size_t c; (c = 2 * i + 1) < n; i = c) {
+    if (c + 1 < n && lor_patch_less(&e[c], &e[c + 1])) c++;
+    if (!lor_patch_less(&e[i], &e[c])) return;
+    const lor_patch_entry_s t = e[i];
+    e[i] = e[c];
+    e[c] = t;
+  }
+}
+
+int lor_patch_init(lor_patch_s* p, lor_addr_s* index, const size_t n,
+                   lor_patch_bank_s* banks, lor_patch_entry_s* e,
+                   const size_t es) {
+  __builtin_memset(index, 0, n * sizeof(*index));
+  for (size_t i = 0; i < es; i++) {
+    const lor_patch_entry_s* const pe = &e[i];
+    if (pe->logical >= n || !pe->addr.unit || pe->addr.channel >= 1024 ||
+        index[pe->logical].unit)
+      return -1;
+    index[pe->logical] = pe->addr;
+  }
+  // heapsort, to order the entries without allocating
+  for (size_t i = es / 2; i-- > 0;) lor_patch_sift(e, i, es);
+  for (size_t i = es; i-- > 1;) {
+    const lor_patch_entry_s t = e[0];
+    e[0] = e[i];
+    e[i] = t;
+    lor_patch_sift(e, 0, i);
+  }
+  size_t bs = 0;
+  for (size_t i = 0; i < es; i++) {
+    const lor_addr_s* const a = &e[i].addr;
+    const unsigned char off = (unsigned char) (a->channel / 16);
+    lor_patch_bank_s* b = bs ? &banks[bs - 1] : NULL;
+    if (b == NULL || b->unit != a->unit || b->cset.offset != off) {
+      b = &banks[bs++];
+      *b = (lor_patch_bank_s){a->unit, {off, 0}, i, 0};
+    }
+    b->cset.cbits |= 1 << (a->channel % 16);
+    b->count++;
+  }
+  *p = (lor_patch_s){index, n, e, es, banks, bs};
+  return 0;
+}
+
+const lor_addr_s* lor_patch_get(const lor_patch_s* p,
+                                const unsigned long logical) {
+  if (logical >= p->n || !p->index[logical].unit) return NULL;
+  return &p->index[logical];
+}
+
+size_t lor_patch_update(const lor_patch_s* p, lor_frame_s* f,
+                        const unsigned char* v) {
+  size_t w = 0;
+  for (size_t i = 0; i < p->es; i++) {
+    const lor_patch_entry_s* const pe = &p->e[i];
+    if (!lor_frame_set(f, pe->addr.unit, pe->addr.channel, v[pe->logical]))
+      w++;
+  }
+  return w;
+}
+
+/// @brief Reads a 16-bit big endian (network order) value.
+/// @param b The buffer to read the value from.
+/// @return The value read.
+static unsigned short lor_get_u16be(const unsigned char* const b) {
+  return (unsigned short) (b[0] << 8 | b[1]);
+}
+
+int lor_e131_parse(lor_e131_s* p, const unsigned char* b, const size_t bs) {
+  static const unsigned char acn_id[12] = "ASC-E1.17\0\0";
+  // root layer, framing layer and DMP layer headers up to the start code
+  if (bs < 126 || bs > 638) return -1;
+  if (lor_get_u16be(b) != 0x0010 || __builtin_memcmp(&b[4], acn_id, 12))
+    return -1;
+  if (lor_get_u16be(&b[18]) || lor_get_u16be(&b[20]) != 0x0004) return -1;
+  if (lor_get_u16be(&b[40]) || lor_get_u16be(&b[42]) != 0x0002) return -1;
+  if (b[117] != 0x02 || b[118] != 0xA1) return -1;
+  const unsigned short count = lor_get_u16be(&b[123]);
+  if (!count || 125 + (size_t) count > bs) return -1;
+  p->slots = &b[126];
+  p->n = count - 1;
+  p->universe = lor_get_u16be(&b[113]);
+  p->priority = b[108];
+  p->sequence = b[111];
+  p->options = b[112];
+  p->start_code = b[125];
+  return 0;
+}
+
+/// @brief Writes a 16-bit big endian (network order) value.
+/// @param b The buffer to write the value to.
+/// @param v The value to write.
+static void lor_put_u16be(unsigned char* const b, const size_t v) {
+  b[0] = (unsigned char) (v >> 8);
+  b[1] = (unsigned char) v;
+}
+
+size_t lor_e131_build(unsigned char* b, const size_t bs,
+                      const unsigned short universe, const unsigned char seq,
+                      const unsigned char* slots, const size_t n) {
+  const size_t size = 126 + n;
+  if (n > LOR_DMX_SLOTS || size > bs) return 0;
+  __builtin_memset(b, 0, 126);
+  // root layer: preamble, ACN packet identifier, flags and length, vector
+  b[1] = 0x10;
+  __builtin_memcpy(&b[4], "ASC-E1.17", 9);
+  lor_put_u16be(&b[16], 0x7000 | (size - 16));
+  b[21] = 0x04;
+  // framing layer: flags and length, vector, source name, priority, sequence
+  lor_put_u16be(&b[38], 0x7000 | (size - 38));
+  b[43] = 0x02;
+  __builtin_memcpy(&b[44], "tinylor", 7);
+  b[108] = 100;
+  b[111] = seq;
+  lor_put_u16be(&b[113], universe);
+  // DMP layer: flags and length, vector, address types, count, start code
+  lor_put_u16be(&b[115], 0x7000 | (size - 115));
+  b[117] = 0x02;
+  b[118] = 0xA1;
+  b[122] = 0x01;
+  lor_put_u16be(&b[123], n + 1);
+  __builtin_memcpy(&b[126], slots, n);
+  return size;
+}
+
+int lor_e131_sequence_ok(const unsigned char last, const unsigned char seq) {
+  const int d = (signed char) (unsigned char) (seq - last);
+  return d > 0 || d <= -20;
+}
+
+size_t lor_wire_bytes(const unsigned long baud, const unsigned long ms) {
+  return (size_t) ((unsigned long long) baud * ms / 10000);
+}
+
+unsigned long lor_wire_us(const unsigned long baud, const size_t n) {
+  if (!baud) return 0;
+  const unsigned long long bits = (unsigned long long) n * 10 * 1000000;
+  return (unsigned long) ((bits + baud - 1) / baud);
+}
+
+int lor_sched_init(lor_sched_s* s, lor_sched_entry_s* e, const size_t es,
+                   const unsigned long baud, const unsigned long ms) {
+  if (e == NULL || !es) return -1;
+  *s = (lor_sched_s){.e = e, .es = es, .budget = lor_wire_bytes(baud, ms)};
+  return 0;
+}
+
+int lor_sched_add(lor_sched_s* s, const lor_req_s* req,
+                  const unsigned char priority) {
+  if (s->n == s->es) return -1;
+  s->e[s->n++] = (lor_sched_entry_s){*req, priority};
+  return 0;
+}
+
+size_t lor_sched_next(lor_sched_s* s, lor_req_s* r, const size_t rs) {
+  // find the lowest priority whose requests (and all above it) fit entirely
+  size_t sizes[256] = {0};
+  for (size_t i = 0; i < s->n; i++)
+    sizes[s->e[i].priority] += lor_req_size(&s->e[i].req);
+  size_t used = s->reserved < s->budget ? s->reserved : s->budget;
+  s->reserved = 0;
+  int p = 255;
+  for (; p >= 0 && used + sizes[p] <= s->budget; p--) used += sizes[p];
+
+  // admit those priorities, plus what fits of priority p in original order
+  size_t n = 0, k = 0;
+  for (size_t i = 0; i < s->n; i++) {
+    lor_sched_entry_s* const e = &s->e[i];
+    if (n < rs && e->priority >= p) {
+      const size_t w = lor_req_size(&e->req);
+      if (e->priority > p) {
+        r[n++] = e->req;
+        continue;
+      }
+      if (w <= s->budget - used) {
+        r[n++] = e->req;
+        used += w;
+        continue;
+      }
+    }
+    if (e->priority < 255) e->priority++;
+    s->e[k++] = *e;
+  }
+  s->n = k;
+  return n;
+}
+
+int lor_queue_init(lor_queue_s* q, lor_queue_entry_s* e, const size_t es,
+                   size_t* slots, const size_t ss) {
+  if (e == NULL || !es || (es & (es - 1))) return -1;
+  if (slots == NULL || !ss || (ss & (ss - 1))) return -1;
+  *q = (lor_queue_s){.e = e, .es = es, .slots = slots, .ss = ss};
+  return 0;
+}
+
+int lor_queue_push(lor_queue_s* q, const lor_req_s* req) {
+  const unsigned long long key =
+          req->unit | (unsigned long long) req->cset.offset << 8 |
+          (unsigned long long) req->cset.cbits << 16 |
+          (unsigned long long) (req->effect == LOR_SET_DMX_INTENSITY) << 32;
+  size_t* const slot = &q->slots[((key * 0x9E3779B97F4A7C15ULL) >> 32) &
+                                 (q->ss - 1)];
+  const size_t seq = *slot;
+  lor_queue_entry_s* old = NULL;
+  if (seq - q->head < q->tail - q->head) {
+    old = &q->e[seq & (q->es - 1)];
+    if (!old->live || old->key != key) old = NULL;
+  }
+  if (old != NULL) {
+    // replace in place unless a later request overlaps the same channels,
+    // a linear scan of the requests queued after the match
+    size_t i = seq + 1;
+    for (; i != q->tail; i++) {
+      const lor_queue_entry_s* const e = &q->e[i & (q->es - 1)];
+      if (e->live && lor_req_overlaps(&e->req, req)) break;
+    }
+    if (i == q->tail) {
+      old->req = *req;
+      q->superseded++;
+      return 0;
+    }
+  }
+  if (q->tail - q->head == q->es) {
+    q->rejected++;
+    return -1;
+  }
+  if (old != NULL) {
+    old->live = 0;
+    q->depth--;
+    q->superseded++;
+  }
+  *slot = q->tail;
+  q->e[q->tail++ & (q->es - 1)] = (lor_queue_entry_s){*req, key, 1};
+  q->depth++;
+  return 0;
+}
+
+size_t lor_queue_write(lor_queue_s* q, unsigned char* b, const size_t bs) {
+  size_t h = 0;
+  for (; q->head != q->tail; q->head++) {
+    const lor_queue_entry_s* const e = &q->e[q->head & (q->es - 1)];
+    if (!e->live) continue;
+    if (lor_req_size(&e->req) > bs - h) break;
+    h += lor_encode_req(&b[h], &e->req);
+    q->depth--;
+  }
+  return h;
+}
+
+void lor_stream_init(lor_stream_s* s, const unsigned long baud) {
+  *s = (lor_stream_s){.baud = baud};
+}
+
+size_t lor_stream_heartbeat_size(const lor_stream_s* s,
+                                 const unsigned long long now,
+                                 const unsigned long ms) {
+  const unsigned long long end = now + ms * 1000000ULL;
+  size_t n = 0;
+  // overdue heartbeats are sent once, not once per missed period
+  unsigned long long t = s->next_heartbeat > now ? s->next_heartbeat : now;
+  for (; t < end; t += LOR_HEARTBEAT_DELAY_NS) n += LOR_HEARTBEAT_SIZE;
+  return n;
+}
+
+size_t lor_stream_write(lor_stream_s* s, const unsigned long long now,
+                        unsigned char* b, const size_t bs, const lor_req_s* r,
+                        const size_t rs, size_t* n) {
+  const unsigned long long start = s->busy_until > now ? s->busy_until : now;
+  size_t h = 0, i = 0;
+  for (;;) {
+    // estimated time the next byte written will be sent
+    const unsigned long long t = start + lor_wire_us(s->baud, h) * 1000ULL;
+    if (t >= s->next_heartbeat) {
+      if (LOR_HEARTBEAT_SIZE > bs - h) break;
+      __builtin_memcpy(&b[h], LOR_HEARTBEAT_BYTES, LOR_HEARTBEAT_SIZE);
+      h += LOR_HEARTBEAT_SIZE;
+      s->next_heartbeat = t + LOR_HEARTBEAT_DELAY_NS;
+      continue;
+    }
+    if (i == rs || lor_req_size(&r[i]) > bs - h) break;
+    h += lor_encode_req(&b[h], &r[i++]);
+  }
+  s->busy_until = start + lor_wire_us(s->baud, h) * 1000ULL;
+  if (n != NULL) *n = i;
+  return h;
+}
+
+/// @brief Writes a 32-bit little endian value into a 4-byte buffer.
+/// @param b The buffer to write the value to.
+/// @param v The value to write.
+static void lor_put_u32(unsigned char* const b, const unsigned long v) {
+  b[0] = v & 0xFF;
+  b[1] = v >> 8 & 0xFF;
+  b[2] = v >> 16 & 0xFF;
+  b[3] = v >> 24 & 0xFF;
+}
+
+/// @brief Reads a 32-bit little endian value from a 4-byte buffer.
+/// @param b The buffer to read the value from.
+/// @return The value read.
+static unsigned long lor_get_u32(const unsigned char* const b) {
+  return (unsigned long) b[0] | (unsigned long) b[1] << 8 |
+         (unsigned long) b[2] << 16 | (unsigned long) b[3] << 24;
+}
+
+size_t lor_show_compile(unsigned char* b, const size_t bs, const lor_req_s* r,
+                        const size_t* rc, const unsigned long frames,
+                        const unsigned short period_ms) {
+  const size_t index = LOR_SHOW_HEADER_SIZE + ((size_t) frames + 1) * 4;
+  size_t data = 0, k = 0;
+  for (unsigned long i = 0; i < frames; k += rc[i++])
+    data += lor_write_size(&r[k], rc[i]);
+  if (index + data > bs) return index + data;
+
+  __builtin_memcpy(b, "LORS", 4);
+  b[4] = 1;// version
+  b[5] = 0;
+  b[6] = period_ms & 0xFF;
+  b[7] = period_ms >> 8;
+  lor_put_u32(&b[8], frames);
+  size_t h = 0;
+  k = 0;
+  for (unsigned long i = 0; i < frames; k += rc[i++]) {
+    lor_put_u32(&b[LOR_SHOW_HEADER_SIZE + i * 4], h);
+    h += lor_write(&b[index + h], data - h, &r[k], rc[i]);
+  }
+  lor_put_u32(&b[LOR_SHOW_HEADER_SIZE + frames * 4], h);
+  return index + data;
+}
+
+int lor_show_open(lor_show_s* s, const unsigned char* b, const size_t bs) {
+  if (bs < LOR_SHOW_HEADER_SIZE || __builtin_memcmp(b, "LORS", 4) || b[4] != 1)
+    return -1;
+  const unsigned long frames = lor_get_u32(&b[8]);
+  if ((bs - LOR_SHOW_HEADER_SIZE) / 4 <= frames) return -1;
+  const size_t index = LOR_SHOW_HEADER_SIZE + ((size_t) frames + 1) * 4;
+  // offsets must be ordered and within the data to be safe to play back
+  unsigned long prev = 0;
+  for (unsigned long i = 0; i <= frames; i++) {
+    const unsigned long off = lor_get_u32(&b[LOR_SHOW_HEADER_SIZE + i * 4]);
+    if (off < prev || off > bs - index) return -1;
+    prev = off;
+  }
+  *s = (lor_show_s){.b = b, .bs = bs, .frames = frames};
+  s->period_ms = (unsigned short) (b[6] | b[7] << 8);
+  return 0;
+}
+
+const unsigned char* lor_show_frame(const lor_show_s* s, const unsigned long i,
+                                    size_t* n) {
+  const unsigned char* const index = &s->b[LOR_SHOW_HEADER_SIZE + i * 4];
+  const unsigned long off = lor_get_u32(index);
+  *n = lor_get_u32(&index[4]) - off;
+  return &s->b[LOR_SHOW_HEADER_SIZE + ((size_t) s->frames + 1) * 4 + off];
+}
+
+int lor_cache_init(lor_cache_s* c, lor_cache_entry_s* e, const size_t es) {
+  if (e == NULL || !es || (es & (es - 1))) return -1;
+  __builtin_memset(e, 0, es * sizeof(*e));
+  *c = (lor_cache_s){.e = e, .es = es};
+  return 0;
+}
+
+/// @brief Packs the effect arguments used by a request into a single value.
+/// @param req The request to pack.
+/// @return The packed effect arguments, zero if the effect has none.
+static unsigned long lor_pack_args(const lor_req_s* const req) {
+  const lor_effect_args_u* const d = &req->args;
+  switch (req->effect) {
+    case LOR_SET_INTENSITY:
+      return d->set_intensity.intensity;
+    case LOR_FADE:
+      return d->fade.start_intensity |
+             (unsigned long) d->fade.end_intensity << 8 |
+             (unsigned long) d->fade.deciseconds << 16;
+    case LOR_PULSE:
+      return d->pulse.deciseconds;
+    case LOR_SET_DMX_INTENSITY:
+      return d->set_dmx_intensity.output;
+    default:
+      return 0;
+  }
+}
+
+size_t lor_cache_write(lor_cache_s* c, unsigned char* b, const size_t bs,
+                       const lor_req_s* r, const size_t rs) {
+  size_t h = 0;
+  for (size_t i = 0; i < rs; i++) {
+    const lor_req_s* const req = &r[i];
+    const unsigned long long key =
+            req->unit | (unsigned long long) req->effect << 8 |
+            (unsigned long long) req->cset.offset << 16 |
+            (unsigned long long) req->cset.cbits << 24;
+    const unsigned long args = lor_pack_args(req);
+    // Fibonacci hashing of the combined key
+    const unsigned long long hash =
+            (key ^ (unsigned long long) args << 40 ^ args) *
+            0x9E3779B97F4A7C15ULL;
+    lor_cache_entry_s* const e = &c->e[(hash >> 32) & (c->es - 1)];
+    if (e->size && e->key == key && e->args == args) {
+      if (e->size > bs - h) return e->size;
+      __builtin_memcpy(&b[h], e->b, e->size);
+      h += e->size;
+      c->hits++;
+      continue;
+    }
+    const size_t w = lor_req_size(req);
+    if (w > bs - h) return w;
+    if (e->size) c->evictions++;
+    c->misses++;
+    e->key = key;
+    e->args = args;
+    e->size = (unsigned char) lor_encode_req(e->b, req);
+    __builtin_memcpy(&b[h], e->b, w);
+    h += w;
+  }
+  return h;
+}
+
+int lor_ring_init(lor_ring_s* ring, unsigned char* b, const size_t bs) {
+  if (b == NULL || !bs || (bs & (bs - 1))) return -1;
+  *ring = (lor_ring_s){.b = b, .bs = bs};
+  return 0;
+}
+
+size_t lor_ring_write(lor_ring_s* ring, const lor_req_s* r, const size_t rs) {
+  const size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  size_t head = ring->head;// only modified by this thread
+  size_t i = 0;
+  for (; i < rs; i++) {
+    const size_t w = lor_req_size(&r[i]);
+    if (w > ring->bs - (head - tail)) break;
+    const size_t off = head & (ring->bs - 1);
+    if (w <= ring->bs - off) {
+      lor_encode_req(&ring->b[off], &r[i]);
+    } else {
+      // wrap the request around the end of the ring storage
+      unsigned char t[LOR_REQ_MAX_SIZE];
+      lor_encode_req(t, &r[i]);
+      __builtin_memcpy(&ring->b[off], t, ring->bs - off);
+      __builtin_memcpy(ring->b, &t[ring->bs - off], w - (ring->bs - off));
+    }
+    head += w;
+  }
+  __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+  return i;
+}
+
+const unsigned char* lor_ring_read(lor_ring_s* ring, size_t* n) {
+  const size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  const size_t off = ring->tail & (ring->bs - 1);
+  const size_t avail = head - ring->tail;
+  *n = avail < ring->bs - off ? avail : ring->bs - off;
+  return &ring->b[off];
+}
+
+void lor_ring_release(lor_ring_s* ring, const size_t n) {
+  __atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+}
+
+size_t lor_shard(const lor_req_s* r, const size_t rs, const unsigned char* net,
+                 const size_t ns, lor_req_s* out, const size_t os,
+                 size_t* first) {
+  // count the requests of each network, then place them by counting sort
+  __builtin_memset(first, 0, (ns + 1) * sizeof(*first));
+  for (size_t i = 0; i < rs; i++) {
+    if (r[i].unit == 0xFF)
+      for (size_t k = 0; k < ns; k++) first[k + 1]++;
+    else if (net[r[i].unit] < ns)
+      first[net[r[i].unit] + 1]++;
+  }
+  for (size_t k = 0; k < ns; k++) first[k + 1] += first[k];
+  const size_t n = first[ns];
+  if (n > os) return n;
+  for (size_t i = 0; i < rs; i++) {
+    if (r[i].unit == 0xFF)
+      for (size_t k = 0; k < ns; k++) out[first[k]++] = r[i];
+    else if (net[r[i].unit] < ns)
+      out[first[net[r[i].unit]]++] = r[i];
+  }
+  // each network's count was advanced past its end, shift them back
+  for (size_t k = ns; k > 0; k--) first[k] = first[k - 1];
+  first[0] = 0;
+  return n;
+}
+
+#define LOR_HIST_SUB (1 << LOR_HIST_SUB_BITS)
+
+void lor_hist_add(lor_hist_s* h, const unsigned long long ns) {
+  int i = (int) ns;
+  if (ns >= LOR_HIST_SUB) {
+    // the power of two range selects the bucket group, the bits following
+    // the leading one select the linear sub-bucket within it
+    const int e = 63 - __builtin_clzll(ns);
+    i = (e - LOR_HIST_SUB_BITS + 1) * LOR_HIST_SUB +
+        (int) (ns >> (e - LOR_HIST_SUB_BITS) & (LOR_HIST_SUB - 1));
+    if (i >= LOR_HIST_BUCKETS) i = LOR_HIST_BUCKETS - 1;
+  }
+  h->count[i]++;
+  h->n++;
+  if (ns > h->max) h->max = ns;
+}
+
+/// @brief Returns the last duration counted by a histogram bucket.
+/// @param i The bucket index.
+/// @return The duration in nanoseconds.
+static unsigned long long lor_hist_end(const int i) {
+  if (i < LOR_HIST_SUB) return (unsigned long long) i;
+  // the start of the next bucket, shifted into the bucket's power of two
+  const unsigned long long next = LOR_HIST_SUB + i % LOR_HIST_SUB + 1;
+  return (next << (i / LOR_HIST_SUB - 1)) - 1;
+}
+
+unsigned long long lor_hist_percentile(const lor_hist_s* h,
+                                       const unsigned pct) {
+  if (!h->n) return 0;
+  // the number of durations at or below the percentile, rounded up
+  const unsigned long long k =
+          ((unsigned long long) h->n * (pct < 100 ? pct : 100) + 99) / 100;
+  unsigned long long seen = 0;
+  for (int i = 0; i < LOR_HIST_BUCKETS - 1; i++) {
+    seen += h->count[i];
+    if (seen >= k) {
+      const unsigned long long end = lor_hist_end(i);
+      return end < h->max ? end : h->max;
+    }
+  }
+  return h->max;
+}
+
+int lor_clock_init(lor_clock_s* c, const unsigned long long now,
+                   const unsigned long long period) {
+  if (!period) return -1;
+  *c = (lor_clock_s){.period = period, .next = now, .start = now};
+  return 0;
+}
+
+long lor_clock_tick(lor_clock_s* c, const unsigned long long now) {
+  if (now < c->next) return -1;
+  const unsigned long long late = now - c->next;
+  const unsigned long long skipped = late / c->period;
+  lor_hist_add(&c->jitter, late);
+  c->next += (skipped + 1) * c->period;
+  c->start = now;
+  c->ticks++;
+  c->missed += (unsigned long) skipped;
+  return (long) skipped;
+}
+
+void lor_clock_done(lor_clock_s* c, const unsigned long long now) {
+  lor_hist_add(&c->encode, now > c->start ? now - c->start : 0);
+}
+
+#ifdef TINYLOR_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#endif
+
+/// @brief Converts a baud rate to its termios speed constant.
+/// @param baud The baud rate.
+/// @param speed Set to the termios speed constant.
+/// @return 0 on success, -1 if the baud rate is not supported.
+static int lor_serial_speed(const unsigned long baud, speed_t* const speed) {
+  switch (baud) {
+    case 9600:
+      *speed = B9600;
+      return 0;
+    case 19200:
+      *speed = B19200;
+      return 0;
+    case 38400:
+      *speed = B38400;
+      return 0;
+    case 57600:
+      *speed = B57600;
+      return 0;
+    case 115200:
+      *speed = B115200;
+      return 0;
+#ifdef B230400
+    case 230400:
+      *speed = B230400;
+      return 0;
+#endif
+#ifdef B460800
+    case 460800:
+      *speed = B460800;
+      return 0;
+#endif
+#ifdef B500000
+    case 500000:
+      *speed = B500000;
+      return 0;
+#endif
+    default:
+      return -1;
+  }
+}
+
+int lor_serial_configure(const int fd, const unsigned long baud) {
+  speed_t speed;
+  if (lor_serial_speed(baud, &speed)) {
+    errno = EINVAL;
+    return -1;
+  }
+  struct termios t;
+  if (tcgetattr(fd, &t)) return -1;
+  t.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL |
+                 IXON | IXOFF | IXANY);
+  t.c_oflag &= ~OPOST;
+  t.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  t.c_cflag &= ~(CSIZE | PARENB | CSTOPB);
+  t.c_cflag |= CS8 | CLOCAL | CREAD;
+  // hardware flow control would block writes to adapters without RTS/CTS
+#ifdef CRTSCTS
+  t.c_cflag &= ~CRTSCTS;
+#endif
+  t.c_cc[VMIN] = 0;
+  t.c_cc[VTIME] = 0;
+  if (cfsetispeed(&t, speed) || cfsetospeed(&t, speed)) return -1;
+  if (tcsetattr(fd, TCSANOW, &t)) return -1;
+  const int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK)) return -1;
+#ifdef __linux__
+  // best effort, not all drivers (or pseudo terminals) support low latency
+  struct serial_struct ss;
+  if (!ioctl(fd, TIOCGSERIAL, &ss)) {
+    ss.flags |= ASYNC_LOW_LATENCY;
+    ioctl(fd, TIOCSSERIAL, &ss);
+  }
+#endif
+  return 0;
+}
+
+int lor_serial_open(const char* path, const unsigned long baud) {
+  const int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) return -1;
+  if (lor_serial_configure(fd, baud)) {
+    const int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+long lor_serial_send(const int fd, struct iovec* iov, int iovcnt,
+                     const int timeout_ms) {
+  long h = 0;
+  for (;;) {
+    while (iovcnt > 0 && !iov->iov_len) iov++, iovcnt--;
+    if (!iovcnt) return h;
+    const ssize_t w = writev(fd, iov, iovcnt);
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+      // wait for the port to drain before retrying
+      struct pollfd p = {.fd = fd, .events = POLLOUT};
+      const int ready = poll(&p, 1, timeout_ms);
+      if (ready < 0 && errno != EINTR) return -1;
+      if (!ready) return h;
+      continue;
+    }
+    h += w;
+    for (size_t n = (size_t) w; n > 0; iov++, iovcnt--) {
+      if (n < iov->iov_len) {
+        iov->iov_base = (unsigned char*) iov->iov_base + n;
+        iov->iov_len -= n;
+        break;
+      }
+      n -= iov->iov_len;
+      iov->iov_len = 0;
+    }
+  }
+}
+
+long lor_serial_write(const int fd, unsigned char* b, const size_t bs,
+                      const lor_req_s* r, const size_t rs,
+                      const int timeout_ms) {
+  const size_t n = lor_write_size(r, rs);
+  if (n > bs) {
+    errno = ENOBUFS;
+    return -1;
+  }
+  struct iovec iov = {.iov_base = b, .iov_len = lor_write(b, bs, r, rs)};
+  return lor_serial_send(fd, &iov, 1, timeout_ms);
+}
+
+unsigned long long lor_clock_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL +
+         (unsigned long long) ts.tv_nsec;
+}
+
+long lor_clock_wait(lor_clock_s* c) {
+  const struct timespec ts = {(time_t) (c->next / 1000000000ULL),
+                              (long) (c->next % 1000000000ULL)};
+  int err;
+  while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) ==
+         EINTR)
+    continue;
+  if (err) return -1;
+  return lor_clock_tick(c, lor_clock_now());
+}
+
+int lor_show_map(lor_show_s* s, const char* path) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  struct stat st;
+  void* m = MAP_FAILED;
+  if (!fstat(fd, &st)) {
+    if (st.st_size > 0)
+      m = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    else
+      errno = EINVAL;
+  }
+  close(fd);
+  if (m == MAP_FAILED) return -1;
+  if (lor_show_open(s, m, (size_t) st.st_size)) {
+    munmap(m, (size_t) st.st_size);
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+void lor_show_unmap(lor_show_s* s) {
+  munmap((void*) s->b, s->bs);
+}
+
+long lor_show_play(const int fd, const lor_show_s* s, unsigned long i) {
+  lor_clock_s c;
+  const unsigned long long now = lor_clock_now();
+  if (lor_clock_init(&c, now, s->period_ms * 1000000ULL)) {
+    errno = EINVAL;
+    return -1;
+  }
+  unsigned char* const heartbeat = LOR_HEARTBEAT_BYTES;
+  unsigned long long next_heartbeat = now;
+  long skipped = 0;
+  while (i < s->frames) {
+    const long k = lor_clock_wait(&c);
+    if (k < 0) return -1;
+    skipped += k;
+    if ((i += (unsigned long) k) >= s->frames) break;
+    struct iovec iov[2];
+    int iovcnt = 0;
+    if (c.start >= next_heartbeat) {
+      iov[iovcnt++] = (struct iovec){heartbeat, LOR_HEARTBEAT_SIZE};
+      next_heartbeat = c.start + LOR_HEARTBEAT_DELAY_NS;
+    }
+    size_t n;
+    const unsigned char* const f = lor_show_frame(s, i++, &n);
+    if (n) iov[iovcnt++] = (struct iovec){(void*) f, n};
+    if (iovcnt && lor_serial_send(fd, iov, iovcnt, -1) < 0) return -1;
+    lor_clock_done(&c, lor_clock_now());
+  }
+  return skipped;
+}
+
+#ifdef TINYLOR_THREADS
+/// @brief Wakes every thread waiting on a network.
+static void lor_net_signal(lor_net_s* n) {
+  pthread_mutex_lock(&n->lock);
+  pthread_cond_broadcast(&n->cond);
+  pthread_mutex_unlock(&n->lock);
+}
+
+/// @brief Encodes each submitted frame into the ring of a network, waiting for
+///        the writer to release space whenever the ring is full.
+/// @param arg The network.
+/// @return NULL.
+static void* lor_net_encoder(void* arg) {
+  lor_net_s* const n = arg;
+  pthread_mutex_lock(&n->lock);
+  for (;;) {
+    while (!n->pending && !n->stop) pthread_cond_wait(&n->cond, &n->lock);
+    if (!n->pending) break;
+    pthread_mutex_unlock(&n->lock);
+    for (size_t i = 0; i < n->rs;) {
+      const size_t tail = __atomic_load_n(&n->ring.tail, __ATOMIC_ACQUIRE);
+      const size_t w = lor_ring_write(&n->ring, &n->r[i], n->rs - i);
+      i += w;
+      pthread_mutex_lock(&n->lock);
+      if (w) pthread_cond_broadcast(&n->cond);
+      // the ring is full, wait for the writer to release bytes
+      else
+        while (__atomic_load_n(&n->ring.tail, __ATOMIC_ACQUIRE) == tail)
+          pthread_cond_wait(&n->cond, &n->lock);
+      pthread_mutex_unlock(&n->lock);
+    }
+    pthread_mutex_lock(&n->lock);
+    n->pending = 0;
+    pthread_cond_broadcast(&n->cond);
+  }
+  pthread_mutex_unlock(&n->lock);
+  return NULL;
+}
+
+/// @brief Writes the bytes published to the ring of a network to its port
+///        until stopped. After a failed write, bytes are released unwritten so
+///        the encoder never blocks.
+/// @param arg The network.
+/// @return NULL.
+static void* lor_net_writer(void* arg) {
+  lor_net_s* const n = arg;
+  for (;;) {
+    const unsigned char* p;
+    size_t len;
+    int err;
+    pthread_mutex_lock(&n->lock);
+    // stop is set once every frame is published, so it is read first
+    for (;;) {
+      const int stop = n->stop;
+      p = lor_ring_read(&n->ring, &len);
+      if (len || stop) break;
+      pthread_cond_wait(&n->cond, &n->lock);
+    }
+    err = n->err;
+    pthread_mutex_unlock(&n->lock);
+    if (!len) break;
+    struct iovec iov = {.iov_base = (void*) p, .iov_len = len};
+    if (!err && lor_serial_send(n->fd, &iov, 1, -1) < 0) {
+      pthread_mutex_lock(&n->lock);
+      n->err = errno;
+      pthread_mutex_unlock(&n->lock);
+    }
+    lor_ring_release(&n->ring, len);
+    lor_net_signal(n);
+  }
+  return NULL;
+}
+
+int lor_net_start(lor_net_s* n, const int fd, unsigned char* b,
+                  const size_t bs) {
+  if (bs < LOR_REQ_MAX_SIZE || lor_ring_init(&n->ring, b, bs)) return -1;
+  n->fd = fd;
+  n->r = NULL;
+  n->rs = 0;
+  n->pending = n->stop = n->err = 0;
+  if (pthread_mutex_init(&n->lock, NULL)) return -1;
+  if (!pthread_cond_init(&n->cond, NULL)) {
+    if (!pthread_create(&n->encoder, NULL, lor_net_encoder, n)) {
+      if (!pthread_create(&n->writer, NULL, lor_net_writer, n)) return 0;
+      // stop the encoder, which is waiting for a frame
+      pthread_mutex_lock(&n->lock);
+      n->stop = 1;
+      pthread_cond_broadcast(&n->cond);
+      pthread_mutex_unlock(&n->lock);
+      pthread_join(n->encoder, NULL);
+    }
+    pthread_cond_destroy(&n->cond);
+  }
+  pthread_mutex_destroy(&n->lock);
+  return -1;
+}
+
+int lor_net_submit(lor_net_s* n, const lor_req_s* r, const size_t rs) {
+  pthread_mutex_lock(&n->lock);
+  while (n->pending) pthread_cond_wait(&n->cond, &n->lock);
+  const int err = n->err;
+  if (!err) {
+    n->r = r;
+    n->rs = rs;
+    n->pending = 1;
+    pthread_cond_broadcast(&n->cond);
+  }
+  pthread_mutex_unlock(&n->lock);
+  return err ? -1 : 0;
+}
+
+void lor_net_sync(lor_net_s* n) {
+  pthread_mutex_lock(&n->lock);
+  while (n->pending) pthread_cond_wait(&n->cond, &n->lock);
+  pthread_mutex_unlock(&n->lock);
+}
+
+int lor_net_stop(lor_net_s* n) {
+  pthread_mutex_lock(&n->lock);
+  while (n->pending) pthread_cond_wait(&n->cond, &n->lock);
+  n->stop = 1;
+  pthread_cond_broadcast(&n->cond);
+  pthread_mutex_unlock(&n->lock);
+  pthread_join(n->encoder, NULL);
+  pthread_join(n->writer, NULL);
+  pthread_cond_destroy(&n->cond);
+  pthread_mutex_destroy(&n->lock);
+  if (!n->err) return 0;
+  errno = n->err;
+  return -1;
+}
+#endif// TINYLOR_THREADS
+
+#endif// TINYLOR_POSIX
+
 #endif// TINYLOR_IMPL_ONCE
 #endif// TINYLOR_IMPL
 #endif// TINYLOR_SINGLEFILE_H